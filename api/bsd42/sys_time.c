@@ -42,20 +42,30 @@
 #include "../../src/shared/random.h"
 #include "../../src/shared/log.h"
 
-int
-gettimeofday(struct timeval * restrict tp, void * restrict tzp)
+GREAT_WRAP_EXPORT int
+GREAT_BSD42_WRAP(gettimeofday)(struct timeval * restrict tp, void * restrict tzp)
 {
-	if (!great_subset("sys:time:gettimeofday")) {
-		return great_bsd42.gettimeofday(tp, tzp);
+	struct timeval * volatile p;
+	const void *caller;
+
+	caller = GREAT_WRAP_CALLER();
+
+	if (!GREAT_BSD42_SUBSET(gettimeofday)) {
+		return GREAT_BSD42(gettimeofday)(tp, tzp);
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "sys:time:gettimeofday", NULL);
-		return great_bsd42.gettimeofday(tp, tzp);
+	if (!GREAT_BSD42_INJECT(gettimeofday, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_BSD42_PATH(gettimeofday), NULL);
+		return GREAT_BSD42(gettimeofday)(tp, tzp);
 	}
 
-	if (!tp) {
-		great_ib("sys:time:gettimeofday", "gettimeofday(3)", "Returning success");
+	/*
+	 * Some systems declare tp as nonnull, which would otherwise permit the
+	 * compiler to discard this test; gettimeofday(3) makes no such demand.
+	 */
+	p = tp;
+	if (!p) {
+		great_ib(GREAT_BSD42_PATH(gettimeofday), "gettimeofday(3)", "Returning success");
 
 		return 0;
 	}
@@ -68,7 +78,7 @@ gettimeofday(struct timeval * restrict tp, void * restrict tzp)
 	tp->tv_sec = great_random_long(NULL);
 	tp->tv_usec = great_random_long(NULL);
 
-	great_ib("sys:time:gettimeofday", "gettimeofday(3)", "Returning random time");
+	great_ib(GREAT_BSD42_PATH(gettimeofday), "gettimeofday(3)", "Returning random time");
 
 	return 0;
 }
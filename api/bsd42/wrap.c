@@ -39,23 +39,39 @@
 #include "../../src/wrap.h"
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
 #include "../../src/shared/log.h"
 
 struct great_bsd42 great_bsd42;
 
-void
-_init(void) {
-	/* sys_time.c */
-	great_bsd42.gettimeofday =
-		(int (*)(struct timeval * restrict, void * restrict))
-		great_wrap_resolve("gettimeofday");
+#define GREAT_BSD42_PATH_ENTRY(name, ret, params, path, section) path,
+const char *const great_bsd42_path[GREAT_BSD42_COUNT] = {
+	GREAT_BSD42_FUNCTIONS(GREAT_BSD42_PATH_ENTRY)
+};
+#undef GREAT_BSD42_PATH_ENTRY
+
+#define GREAT_BSD42_SECTION_ENTRY(name, ret, params, path, section) section,
+const char *const great_bsd42_section[GREAT_BSD42_COUNT] = {
+	GREAT_BSD42_FUNCTIONS(GREAT_BSD42_SECTION_ENTRY)
+};
+#undef GREAT_BSD42_SECTION_ENTRY
+
+signed char great_bsd42_memo[GREAT_BSD42_COUNT];
+struct great_schedule great_bsd42_schedule[GREAT_BSD42_COUNT];
+
+#ifndef GREAT_WRAP_UNIFIED
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_INIT(bsd42)(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
 
 	great_subset_disable();
 
 	great_log_init("libgreat_bsd42", "BSD42");
 	great_random_init(NULL);
 	great_subset_init();
+	great_schedule_init(great_bsd42_schedule, great_bsd42_path,
+		GREAT_BSD42_COUNT);
 
 	great_subset_enable();
 }
-
+#endif
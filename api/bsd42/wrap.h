@@ -37,15 +37,112 @@
 
 #include <sys/time.h>
 
+#include "../../src/wrap.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+
+/*
+ * The functions wrapped, one per line: the function's name, return type and
+ * parameter list, its subset path (see GREAT_SUBSETS), and the section of
+ * 4.2BSD which specifies it. See api/c99/wrap.h.
+ */
+#define GREAT_BSD42_FUNCTIONS(X) \
+	/* sys_time.c */ \
+	X(gettimeofday, int, (struct timeval * restrict tp, void * restrict tzp), "sys:time:gettimeofday", "gettimeofday(2)")
+
+enum great_bsd42_function {
+#define GREAT_BSD42_ID(name, ret, params, path, section) GREAT_BSD42_ID_##name,
+	GREAT_BSD42_FUNCTIONS(GREAT_BSD42_ID)
+#undef GREAT_BSD42_ID
+	GREAT_BSD42_COUNT
+};
+
 struct great_bsd42 {
-	/* sys_time.c */
-	int (*gettimeofday)(struct timeval * restrict tp, void * restrict tzp);
+	/* The real functions, resolved on first use */
+#define GREAT_BSD42_MEMBER(name, ret, params, path, section) ret (*name) params;
+	GREAT_BSD42_FUNCTIONS(GREAT_BSD42_MEMBER)
+#undef GREAT_BSD42_MEMBER
 };
 
 extern struct great_bsd42 great_bsd42;
 
+/*
+ * Subset paths and sections, by function ID, and subset matches; see
+ * great_subset_memo().
+ */
+extern const char *const great_bsd42_path[GREAT_BSD42_COUNT];
+extern const char *const great_bsd42_section[GREAT_BSD42_COUNT];
+extern signed char great_bsd42_memo[GREAT_BSD42_COUNT];
+
+/*
+ * Injection schedules by function ID; see great_schedule().
+ */
+extern struct great_schedule great_bsd42_schedule[GREAT_BSD42_COUNT];
+
+#ifdef GREAT_WRAP_STATIC
+/*
+ * The wrappers, and the real functions which ld --wrap binds in their place.
+ */
+#define GREAT_BSD42_STATIC(name, ret, params, path, section) \
+	ret __wrap_##name params; \
+	ret __real_##name params;
+GREAT_BSD42_FUNCTIONS(GREAT_BSD42_STATIC)
+#undef GREAT_BSD42_STATIC
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+/*
+ * In the unified library (see api/unified/wrap.h) each wrapper is named for
+ * its API, and is called by way of the function exported for all APIs. The
+ * real functions are shared between APIs, in great_real.
+ */
+#include "../unified/wrap.h"
+
+#define GREAT_BSD42_WRAP(f) great_bsd42_wrap_##f
+#define GREAT_BSD42(f) GREAT_WRAP_REAL(great_real, f)
+
+#define GREAT_BSD42_UNIFIED(name, ret, params, path, section) \
+	ret GREAT_BSD42_WRAP(name) params;
+GREAT_BSD42_FUNCTIONS(GREAT_BSD42_UNIFIED)
+#undef GREAT_BSD42_UNIFIED
+
+/*
+ * There is also just the one log, and so each section names its standard.
+ */
+#include "../../src/shared/log.h"
+#undef great_ib
+#undef great_ub
+#define great_ib(facility, section, ...) \
+	great_ib((facility), "BSD42 " section, __VA_ARGS__)
+#define great_ub(facility, section, ...) \
+	great_ub((facility), "BSD42 " section, __VA_ARGS__)
+#else
+/*
+ * The name of the wrapper for f, and the real function for a member of
+ * great_bsd42; see GREAT_WRAP_NAME() and GREAT_WRAP_REAL().
+ */
+#define GREAT_BSD42_WRAP(f) GREAT_WRAP_NAME(f)
+#define GREAT_BSD42(f) GREAT_WRAP_REAL(great_bsd42, f)
+#endif
+
+/*
+ * The subset path for a function, and whether it is in the current subsets.
+ */
+#define GREAT_BSD42_PATH(f) (great_bsd42_path[GREAT_BSD42_ID_##f])
+#define GREAT_BSD42_SUBSET(f) \
+	GREAT_SUBSET_MEMO(GREAT_BSD42_PATH(f), &great_bsd42_memo[GREAT_BSD42_ID_##f])
+
+/*
+ * Whether to intercept a call to a function found in the current subsets, made
+ * from the call site caller; see GREAT_WRAP_CALLER().
+ */
+#define GREAT_BSD42_INJECT(f, state, caller) \
+	great_schedule(&great_bsd42_schedule[GREAT_BSD42_ID_##f], (state), (caller))
+
+#ifndef GREAT_WRAP_UNIFIED
 extern void
-_init(void);
+GREAT_WRAP_INIT(bsd42)(void);
+#endif
 
 #endif
 
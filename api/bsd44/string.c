@@ -49,19 +49,23 @@
  */
 char *strdup(const char *str);
 
-char *
-strdup(const char *str)
+GREAT_WRAP_EXPORT char *
+GREAT_BSD44_WRAP(strdup)(const char *str)
 {
-	if (!great_subset("string:memory:strdup")) {
-		return great_bsd44.strdup(str);
+	const void *caller;
+
+	caller = GREAT_WRAP_CALLER();
+
+	if (!GREAT_BSD44_SUBSET(strdup)) {
+		return GREAT_BSD44(strdup)(str);
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "string:memory:strdup", NULL);
-		return great_bsd44.strdup(str);
+	if (!GREAT_BSD44_INJECT(strdup, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_BSD44_PATH(strdup), NULL);
+		return GREAT_BSD44(strdup)(str);
 	}
 
-	great_ib("string:memory:strdup", "strdup(3)", "Returning NULL");
+	great_ib(GREAT_BSD44_PATH(strdup), "strdup(3)", "Returning NULL");
 
 	/*
 	 * strdup(3): If insufficient memory is available, NULL is returned.
@@ -38,22 +38,39 @@
 #include "../../src/wrap.h"
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
 #include "../../src/shared/log.h"
 
 struct great_bsd44 great_bsd44;
 
-void
-_init(void) {
-	/* string.c */
-	great_bsd44.strdup =
-		(char *(*)(const char *)) great_wrap_resolve("strdup");
+#define GREAT_BSD44_PATH_ENTRY(name, ret, params, path, section) path,
+const char *const great_bsd44_path[GREAT_BSD44_COUNT] = {
+	GREAT_BSD44_FUNCTIONS(GREAT_BSD44_PATH_ENTRY)
+};
+#undef GREAT_BSD44_PATH_ENTRY
+
+#define GREAT_BSD44_SECTION_ENTRY(name, ret, params, path, section) section,
+const char *const great_bsd44_section[GREAT_BSD44_COUNT] = {
+	GREAT_BSD44_FUNCTIONS(GREAT_BSD44_SECTION_ENTRY)
+};
+#undef GREAT_BSD44_SECTION_ENTRY
+
+signed char great_bsd44_memo[GREAT_BSD44_COUNT];
+struct great_schedule great_bsd44_schedule[GREAT_BSD44_COUNT];
+
+#ifndef GREAT_WRAP_UNIFIED
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_INIT(bsd44)(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
 
 	great_subset_disable();
 
 	great_log_init("libgreat_bsd44", "BSD44");
 	great_random_init(NULL);
 	great_subset_init();
+	great_schedule_init(great_bsd44_schedule, great_bsd44_path,
+		GREAT_BSD44_COUNT);
 
 	great_subset_enable();
 }
-
+#endif
@@ -35,15 +35,112 @@
 #ifndef GREAT_BSD44_WRAP_H
 #define GREAT_BSD44_WRAP_H
 
+#include "../../src/wrap.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+
+/*
+ * The functions wrapped, one per line: the function's name, return type and
+ * parameter list, its subset path (see GREAT_SUBSETS), and the section of
+ * 4.4BSD which specifies it. See api/c99/wrap.h.
+ */
+#define GREAT_BSD44_FUNCTIONS(X) \
+	/* string.c */ \
+	X(strdup, char *, (const char *str), "string:memory:strdup", "strdup(3)")
+
+enum great_bsd44_function {
+#define GREAT_BSD44_ID(name, ret, params, path, section) GREAT_BSD44_ID_##name,
+	GREAT_BSD44_FUNCTIONS(GREAT_BSD44_ID)
+#undef GREAT_BSD44_ID
+	GREAT_BSD44_COUNT
+};
+
 struct great_bsd44 {
-	/* string.c */
-	char *(*strdup)(const char *str);
+	/* The real functions, resolved on first use */
+#define GREAT_BSD44_MEMBER(name, ret, params, path, section) ret (*name) params;
+	GREAT_BSD44_FUNCTIONS(GREAT_BSD44_MEMBER)
+#undef GREAT_BSD44_MEMBER
 };
 
 extern struct great_bsd44 great_bsd44;
 
+/*
+ * Subset paths and sections, by function ID, and subset matches; see
+ * great_subset_memo().
+ */
+extern const char *const great_bsd44_path[GREAT_BSD44_COUNT];
+extern const char *const great_bsd44_section[GREAT_BSD44_COUNT];
+extern signed char great_bsd44_memo[GREAT_BSD44_COUNT];
+
+/*
+ * Injection schedules by function ID; see great_schedule().
+ */
+extern struct great_schedule great_bsd44_schedule[GREAT_BSD44_COUNT];
+
+#ifdef GREAT_WRAP_STATIC
+/*
+ * The wrappers, and the real functions which ld --wrap binds in their place.
+ */
+#define GREAT_BSD44_STATIC(name, ret, params, path, section) \
+	ret __wrap_##name params; \
+	ret __real_##name params;
+GREAT_BSD44_FUNCTIONS(GREAT_BSD44_STATIC)
+#undef GREAT_BSD44_STATIC
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+/*
+ * In the unified library (see api/unified/wrap.h) each wrapper is named for
+ * its API, and is called by way of the function exported for all APIs. The
+ * real functions are shared between APIs, in great_real.
+ */
+#include "../unified/wrap.h"
+
+#define GREAT_BSD44_WRAP(f) great_bsd44_wrap_##f
+#define GREAT_BSD44(f) GREAT_WRAP_REAL(great_real, f)
+
+#define GREAT_BSD44_UNIFIED(name, ret, params, path, section) \
+	ret GREAT_BSD44_WRAP(name) params;
+GREAT_BSD44_FUNCTIONS(GREAT_BSD44_UNIFIED)
+#undef GREAT_BSD44_UNIFIED
+
+/*
+ * There is also just the one log, and so each section names its standard.
+ */
+#include "../../src/shared/log.h"
+#undef great_ib
+#undef great_ub
+#define great_ib(facility, section, ...) \
+	great_ib((facility), "BSD44 " section, __VA_ARGS__)
+#define great_ub(facility, section, ...) \
+	great_ub((facility), "BSD44 " section, __VA_ARGS__)
+#else
+/*
+ * The name of the wrapper for f, and the real function for a member of
+ * great_bsd44; see GREAT_WRAP_NAME() and GREAT_WRAP_REAL().
+ */
+#define GREAT_BSD44_WRAP(f) GREAT_WRAP_NAME(f)
+#define GREAT_BSD44(f) GREAT_WRAP_REAL(great_bsd44, f)
+#endif
+
+/*
+ * The subset path for a function, and whether it is in the current subsets.
+ */
+#define GREAT_BSD44_PATH(f) (great_bsd44_path[GREAT_BSD44_ID_##f])
+#define GREAT_BSD44_SUBSET(f) \
+	GREAT_SUBSET_MEMO(GREAT_BSD44_PATH(f), &great_bsd44_memo[GREAT_BSD44_ID_##f])
+
+/*
+ * Whether to intercept a call to a function found in the current subsets, made
+ * from the call site caller; see GREAT_WRAP_CALLER().
+ */
+#define GREAT_BSD44_INJECT(f, state, caller) \
+	great_schedule(&great_bsd44_schedule[GREAT_BSD44_ID_##f], (state), (caller))
+
+#ifndef GREAT_WRAP_UNIFIED
 extern void
-_init(void);
+GREAT_WRAP_INIT(bsd44)(void);
+#endif
 
 #endif
 
@@ -47,34 +47,83 @@
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
 #include "../../src/shared/log.h"
+#include "../../src/shared/misc.h"
+#include "../../src/shared/alloc.h"
+#include "../../src/shared/memlimit.h"
+#include "../../src/shared/bootstrap.h"
+#include "../../src/map.h"
 
 /* TODO paragraph numbers for P? */
 
 /*
- * Here we're after a valid pointer (that is, one which malloc may return) which
- * points to an address that may not be read from or written to.
- *
- * TODO reference C89
+ * realloc() for a block from the bootstrap arena, or for a null pointer whilst
+ * bootstrapping; see bootstrap.h. The old block is left in the arena.
  */
-char great_nothing[] = "";
+static void *
+brealloc(void *ptr, size_t size)
+{
+	size_t n;
+	void *p;
+
+	if (GREAT_BOOTSTRAPPING()) {
+		p = great_bootstrap_malloc(size);
+	} else {
+		p = GREAT_C89(malloc)(size);
+	}
+
+	if (p == NULL || ptr == NULL) {
+		return p;
+	}
+
+	n = great_bootstrap_size(ptr);
+	memcpy(p, ptr, n < size ? n : size);
+
+	return p;
+}
+
+/* C89 4.10.3.2 The free function */
+static void
+xfree(void *ptr)
+{
+	if (!GREAT_C89_SUBSET(malloc)
+	&& !GREAT_C89_SUBSET(realloc)
+	&& !GREAT_C89_SUBSET(free)) {
+		GREAT_C89(free)(ptr);
+		return;
+	}
+
+	if (ptr == great_nothing + 1) {
+		great_log(GREAT_LOG_INFO, GREAT_C89_PATH(free),
+			"Handling great_nothing");
+		return;
+	}
 
-/* XXX free() is missing */
+	great_log(GREAT_LOG_DEFAULT, GREAT_C89_PATH(free), NULL);
+	GREAT_C89(free)(ptr);
+}
 
 /* C89 4.10.3.3 The malloc function */
-void *
-malloc(size_t size)
+static void *
+xmalloc(size_t size, const void *caller)
 {
-	if (!great_subset("stdlib:memory:malloc")) {
-		return great_c89.malloc(size);
+	if (great_memlimit_enabled && great_memlimit_exceeded(NULL, size)) {
+		/* P? ...either a null pointer */
+		great_ib(GREAT_C89_PATH(malloc), "4.10.3.3 P?",
+			"Returning NULL at the memory limit");
+		return NULL;
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "stdlib:memory:malloc", NULL);
-		return great_c89.malloc(size);
+	if (!GREAT_C89_SUBSET(malloc)) {
+		return GREAT_C89(malloc)(size);
+	}
+
+	if (!GREAT_C89_INJECT(malloc, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C89_PATH(malloc), NULL);
+		return GREAT_C89(malloc)(size);
 	}
 
 	/* P? ...either a null pointer */
-	great_ib("stdlib:memory:malloc", "4.10.3.3 P?", "Returning NULL");
+	great_ib(GREAT_C89_PATH(malloc), "4.10.3.3 P?", "Returning NULL");
 	return NULL;
 
 	/* NOTREACHED */
@@ -82,40 +131,47 @@ malloc(size_t size)
 }
 
 /* C89 4.10.3.4 The realloc function */
-void *
-realloc(void *ptr, size_t size)
+static void *
+xrealloc(void *ptr, size_t size, const void *caller)
 {
-	if (!great_subset("stdlib:memory:realloc")) {
-		return great_c89.realloc(ptr, size);
+	if (great_memlimit_enabled && great_memlimit_exceeded(ptr, size)) {
+		/* P? The realloc function returns either a null pointer... */
+		great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
+			"Returning NULL at the memory limit");
+		return NULL;
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "stdlib:memory:realloc", NULL);
-		return great_c89.realloc(ptr, size);
+	if (!GREAT_C89_SUBSET(realloc)) {
+		return GREAT_C89(realloc)(ptr, size);
+	}
+
+	if (!GREAT_C89_INJECT(realloc, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C89_PATH(realloc), NULL);
+		return GREAT_C89(realloc)(ptr, size);
 	}
 
 	/* P? If ptr is a null pointer, the realloc function
 	 *    behaves like the malloc function for the specified size. */
 	if(ptr == NULL) {
-		great_ib("stdlib:memory:realloc", "4.10.3.4 P?",
+		great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 			"Returning malloc()");
-		return malloc(size);
+		return xmalloc(size, caller);
 	}
 
 	/* P? If size is zero and ptr is not a null pointer, the object
 	 *    it points to is freed. */
 	if(size == 0) {
-		free(ptr);
+		xfree(ptr);
 
 		/* C89 does not enforce that NULL is returned (I think...) */
 		switch(great_random_choice(2)) {
 		case 0:
-			great_ib("stdlib:memory:realloc", "4.10.3.4 P?",
+			great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 				"Returning NULL");
 			return NULL;
 
 		case 1:
-			great_ib("stdlib:memory:realloc", "4.10.3.4 P?",
+			great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 				"Returning great_nothing");
 			return great_nothing + 1;
 
@@ -128,7 +184,7 @@ realloc(void *ptr, size_t size)
 	 *    the possibly moved allocated space. */
 	switch(great_random_choice(2)) {
 	case 0:
-		great_ib("stdlib:memory:realloc", "4.10.3.4 P?",
+		great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 			"Returning NULL");
 		return NULL;
 
@@ -137,11 +193,11 @@ realloc(void *ptr, size_t size)
 		{
 			void *p;
 
-			p = malloc(size);
+			p = xmalloc(size, caller);
 			if(!p) {
-				great_perror("stdlib:memory:realloc", "malloc");
+				great_perror(GREAT_C89_PATH(realloc), "malloc");
 
-				great_ib("stdlib:memory:realloc", "4.10.3.4 P?",
+				great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 					"Returning NULL");
 
 				return NULL;
@@ -150,9 +206,9 @@ realloc(void *ptr, size_t size)
 			/* P? The contents of the object shall be unchanged up to the
 			 *    lesser of the new and old sizes. */
 			memcpy(p, ptr, size);
-			free(ptr);
+			xfree(ptr);
 
-			great_ib("stdlib:memory:realloc", "7.20.3.4 P2",
+			great_ib(GREAT_C89_PATH(realloc), "4.10.3.4 P?",
 				"Returning different address");
 
 			return p;
@@ -166,3 +222,70 @@ realloc(void *ptr, size_t size)
 	return NULL;
 }
 
+/*
+ * The functions exported are thin wrappers around those above, so that each
+ * call made by the application is observed exactly once; see alloc.h.
+ */
+
+GREAT_WRAP_EXPORT void
+GREAT_C89_WRAP(free)(void *ptr)
+{
+	/* blocks from the bootstrap arena are never freed */
+	if (great_bootstrap_owns(ptr)) {
+		return;
+	}
+
+	if (great_alloc_enabled) {
+		great_alloc_free(ptr);
+	}
+
+	xfree(ptr);
+}
+
+GREAT_WRAP_EXPORT void *
+GREAT_C89_WRAP(malloc)(size_t size)
+{
+	const void *caller;
+	void *p;
+
+	if (GREAT_BOOTSTRAPPING()) {
+		return great_bootstrap_malloc(size);
+	}
+
+	caller = GREAT_WRAP_CALLER();
+
+	p = xmalloc(size, caller);
+
+	if (great_alloc_enabled) {
+		great_alloc_malloc(size, p, caller);
+	}
+
+	return p;
+}
+
+GREAT_WRAP_EXPORT void *
+GREAT_C89_WRAP(realloc)(void *ptr, size_t size)
+{
+	const void *caller;
+	size_t oldsize;
+	void *p;
+
+	if (great_bootstrap_owns(ptr) || (ptr == NULL && GREAT_BOOTSTRAPPING())) {
+		return brealloc(ptr, size);
+	}
+
+	caller = GREAT_WRAP_CALLER();
+
+	oldsize = 0;
+	if (great_alloc_enabled && ptr != great_nothing + 1) {
+		oldsize = great_usable_size(ptr);
+	}
+
+	p = xrealloc(ptr, size, caller);
+
+	if (great_alloc_enabled) {
+		great_alloc_realloc(ptr, oldsize, size, p, caller);
+	}
+
+	return p;
+}
@@ -38,25 +38,50 @@
 #include "../../src/wrap.h"
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
 #include "../../src/shared/log.h"
+#include "../../src/shared/alloc.h"
 
 struct great_c89 great_c89;
 
-/* TODO provide static initialisation alternative */
-void
-_init(void) {
-	/* stdlib_memory.c */
-	great_c89.malloc  =
-		(void *(*)(size_t)) great_wrap_resolve("malloc");
-	great_c89.realloc =
-		(void *(*)(void *, size_t)) great_wrap_resolve("realloc");
+#define GREAT_C89_PATH_ENTRY(name, ret, params, path, section) path,
+const char *const great_c89_path[GREAT_C89_COUNT] = {
+	GREAT_C89_FUNCTIONS(GREAT_C89_PATH_ENTRY)
+};
+#undef GREAT_C89_PATH_ENTRY
+
+#define GREAT_C89_SECTION_ENTRY(name, ret, params, path, section) section,
+const char *const great_c89_section[GREAT_C89_COUNT] = {
+	GREAT_C89_FUNCTIONS(GREAT_C89_SECTION_ENTRY)
+};
+#undef GREAT_C89_SECTION_ENTRY
+
+signed char great_c89_memo[GREAT_C89_COUNT];
+struct great_schedule great_c89_schedule[GREAT_C89_COUNT];
+
+#ifndef GREAT_WRAP_UNIFIED
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_INIT(c89)(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
 
 	great_subset_disable();
 
 	great_log_init("libgreat_c89", "C89");
 	great_random_init(NULL);
 	great_subset_init();
+	great_schedule_init(great_c89_schedule, great_c89_path,
+		GREAT_C89_COUNT);
+	great_alloc_init();
 
 	great_subset_enable();
 }
 
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_FINI(c89)(void) {
+	great_subset_disable();
+
+	great_alloc_fini();
+
+	great_subset_enable();
+}
+#endif
@@ -37,16 +37,117 @@
 
 #include <stdlib.h>
 
+#include "../../src/wrap.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+
+/*
+ * The functions wrapped, one per line: the function's name, return type and
+ * parameter list, its subset path (see GREAT_SUBSETS), and the section of
+ * C89 which specifies it. See api/c99/wrap.h.
+ */
+#define GREAT_C89_FUNCTIONS(X) \
+	/* stdlib_memory.c */ \
+	X(free, void, (void *ptr), "stdlib:memory:free", "4.10.3.2") \
+	X(malloc, void *, (size_t size), "stdlib:memory:malloc", "4.10.3.3") \
+	X(realloc, void *, (void *ptr, size_t size), "stdlib:memory:realloc", "4.10.3.4")
+
+enum great_c89_function {
+#define GREAT_C89_ID(name, ret, params, path, section) GREAT_C89_ID_##name,
+	GREAT_C89_FUNCTIONS(GREAT_C89_ID)
+#undef GREAT_C89_ID
+	GREAT_C89_COUNT
+};
+
 struct great_c89 {
-	/* stdlib_memory.c */
-	void *(*malloc)(size_t size);
-	void *(*realloc)(void *ptr, size_t size);
+	/* The real functions, resolved on first use */
+#define GREAT_C89_MEMBER(name, ret, params, path, section) ret (*name) params;
+	GREAT_C89_FUNCTIONS(GREAT_C89_MEMBER)
+#undef GREAT_C89_MEMBER
 };
 
 extern struct great_c89 great_c89;
 
+/*
+ * Subset paths and sections, by function ID, and subset matches; see
+ * great_subset_memo().
+ */
+extern const char *const great_c89_path[GREAT_C89_COUNT];
+extern const char *const great_c89_section[GREAT_C89_COUNT];
+extern signed char great_c89_memo[GREAT_C89_COUNT];
+
+/*
+ * Injection schedules by function ID; see great_schedule().
+ */
+extern struct great_schedule great_c89_schedule[GREAT_C89_COUNT];
+
+#ifdef GREAT_WRAP_STATIC
+/*
+ * The wrappers, and the real functions which ld --wrap binds in their place.
+ */
+#define GREAT_C89_STATIC(name, ret, params, path, section) \
+	ret __wrap_##name params; \
+	ret __real_##name params;
+GREAT_C89_FUNCTIONS(GREAT_C89_STATIC)
+#undef GREAT_C89_STATIC
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+/*
+ * In the unified library (see api/unified/wrap.h) each wrapper is named for
+ * its API, and is called by way of the function exported for all APIs. The
+ * real functions are shared between APIs, in great_real.
+ */
+#include "../unified/wrap.h"
+
+#define GREAT_C89_WRAP(f) great_c89_wrap_##f
+#define GREAT_C89(f) GREAT_WRAP_REAL(great_real, f)
+
+#define GREAT_C89_UNIFIED(name, ret, params, path, section) \
+	ret GREAT_C89_WRAP(name) params;
+GREAT_C89_FUNCTIONS(GREAT_C89_UNIFIED)
+#undef GREAT_C89_UNIFIED
+
+/*
+ * There is also just the one log, and so each section names its standard.
+ */
+#include "../../src/shared/log.h"
+#undef great_ib
+#undef great_ub
+#define great_ib(facility, section, ...) \
+	great_ib((facility), "C89 " section, __VA_ARGS__)
+#define great_ub(facility, section, ...) \
+	great_ub((facility), "C89 " section, __VA_ARGS__)
+#else
+/*
+ * The name of the wrapper for f, and the real function for a member of
+ * great_c89; see GREAT_WRAP_NAME() and GREAT_WRAP_REAL().
+ */
+#define GREAT_C89_WRAP(f) GREAT_WRAP_NAME(f)
+#define GREAT_C89(f) GREAT_WRAP_REAL(great_c89, f)
+#endif
+
+/*
+ * The subset path for a function, and whether it is in the current subsets.
+ */
+#define GREAT_C89_PATH(f) (great_c89_path[GREAT_C89_ID_##f])
+#define GREAT_C89_SUBSET(f) \
+	GREAT_SUBSET_MEMO(GREAT_C89_PATH(f), &great_c89_memo[GREAT_C89_ID_##f])
+
+/*
+ * Whether to intercept a call to a function found in the current subsets, made
+ * from the call site caller; see GREAT_WRAP_CALLER().
+ */
+#define GREAT_C89_INJECT(f, state, caller) \
+	great_schedule(&great_c89_schedule[GREAT_C89_ID_##f], (state), (caller))
+
+#ifndef GREAT_WRAP_UNIFIED
+extern void
+GREAT_WRAP_INIT(c89)(void);
+
 extern void
-_init(void);
+GREAT_WRAP_FINI(c89)(void);
+#endif
 
 #endif
 
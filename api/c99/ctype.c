@@ -62,7 +62,7 @@ int isxdigit(int c);
 #include "../../src/shared/log.h"
 
 static void
-checkrange(int c)
+checkrange(const char *name, int c)
 {
 	/* 7.4 P1 In all cases the argument is an int, the value of which shall be
 	 * representable as an unsigned char ... */
@@ -76,7 +76,7 @@ checkrange(int c)
 	}
 
 	/* ... If the argument has any other value, the behavior is undefined. */
-	great_ub("stdlib:prng:rand", "7.4 P1",
+	great_ub(name, "7.4 P1",
 		"character not representable as an unsigned char or EOF");
 	/* UB */
 	abort();
@@ -86,22 +86,23 @@ checkrange(int c)
  * The guts of the is*() functions, generalised.
  */
 static int
-xis(const char *subset, int (*fp)(int c), int c) {
+xis(enum great_c99_function id, int (*fp)(int c), int c,
+	const void *caller) {
+	const char *subset = great_c99_path[id];
 	int x;
 
-	assert(subset);
 	assert(fp);
 
-	if (!great_subset(subset)) {
+	if (!GREAT_SUBSET_MEMO(subset, &great_c99_memo[id])) {
 		return fp(c);
 	}
 
-	if (!great_random_probability(NULL)) {
+	if (!great_schedule(&great_c99_schedule[id], NULL, caller)) {
 		great_log(GREAT_LOG_DEFAULT, subset, NULL);
 		return fp(c);
 	}
 
-	checkrange(c);
+	checkrange(subset, c);
 
 	x = fp(c);
 	if (0 == x) {
@@ -122,86 +123,98 @@ xis(const char *subset, int (*fp)(int c), int c) {
 }
 
 /* C99 7.4.1.1 The isalnum function */
-int
-isalnum(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isalnum)(int c)
 {
-	return xis("ctype:class:isalnum", great_c99.isalnum, c);
+	return xis(GREAT_C99_ID_isalnum, GREAT_C99(isalnum), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.2 The isalpha function */
-int
-isalpha(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isalpha)(int c)
 {
-	return xis("ctype:class:isalpha", great_c99.isalpha, c);
+	return xis(GREAT_C99_ID_isalpha, GREAT_C99(isalpha), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.3 The isblank function */
-int
-isblank(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isblank)(int c)
 {
-	return xis("ctype:class:isblank", great_c99.isblank, c);
+	return xis(GREAT_C99_ID_isblank, GREAT_C99(isblank), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.4 The iscntrl function */
-int
-iscntrl(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(iscntrl)(int c)
 {
-	return xis("ctype:class:iscntrl", great_c99.iscntrl, c);
+	return xis(GREAT_C99_ID_iscntrl, GREAT_C99(iscntrl), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.5 The isdigit function */
-int
-isdigit(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isdigit)(int c)
 {
-	return xis("ctype:class:isdigit", great_c99.isdigit, c);
+	return xis(GREAT_C99_ID_isdigit, GREAT_C99(isdigit), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.6 The isgraph function */
-int
-isgraph(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isgraph)(int c)
 {
-	return xis("ctype:class:isgraph", great_c99.isgraph, c);
+	return xis(GREAT_C99_ID_isgraph, GREAT_C99(isgraph), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.7 The islower function */
-int
-islower(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(islower)(int c)
 {
-	return xis("ctype:class:islower", great_c99.islower, c);
+	return xis(GREAT_C99_ID_islower, GREAT_C99(islower), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.8 The isprint function */
-int
-isprint(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isprint)(int c)
 {
-	return xis("ctype:class:isprint", great_c99.isprint, c);
+	return xis(GREAT_C99_ID_isprint, GREAT_C99(isprint), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.9 The ispunct function */
-int
-ispunct(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(ispunct)(int c)
 {
-	return xis("ctype:class:ispunct", great_c99.ispunct, c);
+	return xis(GREAT_C99_ID_ispunct, GREAT_C99(ispunct), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.10 The isspace function */
-int
-isspace(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isspace)(int c)
 {
-	return xis("ctype:class:isspace", great_c99.isspace, c);
+	return xis(GREAT_C99_ID_isspace, GREAT_C99(isspace), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.11 The isupper function */
-int
-isupper(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isupper)(int c)
 {
-	return xis("ctype:class:isupper", great_c99.isupper, c);
+	return xis(GREAT_C99_ID_isupper, GREAT_C99(isupper), c,
+		GREAT_WRAP_CALLER());
 }
 
 /* C99 7.4.1.12 The isxdigit function */
-int
-isxdigit(int c)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(isxdigit)(int c)
 {
-	return xis("ctype:class:isxdigit", great_c99.isxdigit, c);
+	return xis(GREAT_C99_ID_isxdigit, GREAT_C99(isxdigit), c,
+		GREAT_WRAP_CALLER());
 }
 
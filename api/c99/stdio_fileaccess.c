@@ -60,16 +60,20 @@ sstrcmp(const void *p1, const void *p2)
 }
 
 /* C99 7.19.5.3 The fopen function */
-FILE *
-fopen(const char * restrict filename, const char * restrict mode)
+GREAT_WRAP_EXPORT FILE *
+GREAT_C99_WRAP(fopen)(const char * restrict filename, const char * restrict mode)
 {
-	if (!great_subset("stdio:fileaccess:fopen")) {
-		return great_c99.fopen(filename, mode);
+	const void *caller;
+
+	caller = GREAT_WRAP_CALLER();
+
+	if (!GREAT_C99_SUBSET(fopen)) {
+		return GREAT_C99(fopen)(filename, mode);
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "stdio:fileaccess:fopen", NULL);
-		return great_c99.fopen(filename, mode);
+	if (!GREAT_C99_INJECT(fopen, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(fopen), NULL);
+		return GREAT_C99(fopen)(filename, mode);
 	}
 
 	/* P3 The argument mode points to a string. If the string is one of the
@@ -84,15 +88,15 @@ fopen(const char * restrict filename, const char * restrict mode)
 
 	if(!bsearch(mode, modes, sizeof modes / sizeof *modes,
 		sizeof *modes, sstrcmp)) {
-		great_ub("stdio:fileaccess:fopen", "7.19.5.3 P3",
+		great_ub(GREAT_C99_PATH(fopen), "7.19.5.3 P3",
 			"Unrecognised mode: \"%s\"", mode);
 
 		/* UB */
 		abort();
 	}
 
-	great_log(GREAT_LOG_DEFAULT, "stdio:fileaccess:fopen", NULL);
+	great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(fopen), NULL);
 
-	return great_c99.fopen(filename, mode);
+	return GREAT_C99(fopen)(filename, mode);
 }
 
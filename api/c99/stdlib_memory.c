@@ -43,61 +43,80 @@
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
 #include "../../src/shared/log.h"
+#include "../../src/shared/misc.h"
+#include "../../src/shared/alloc.h"
+#include "../../src/shared/memlimit.h"
+#include "../../src/shared/bootstrap.h"
+#include "../../src/map.h"
 
 /*
- * Here we're after a valid pointer (that is, one which malloc may return) which
- * points to an address that may not be read from or written to.
- *
- * C99 6.5.5 P8 If both the pointer operand and the result point ... one past
- * the last element of the array object, the evaluation shall not produce an
- * overflow.
+ * The usable size of a block, for GREAT_C99_SIZE().
  */
-char great_nothing[] = "";
+static size_t
+usable(void *ptr)
+{
+	if (ptr == NULL || ptr == great_nothing + 1) {
+		return 0;
+	}
+
+	return great_usable_size(ptr);
+}
 
 /* C99 7.20.3.2 The free function */
-void
-free(void *ptr) {
-	if (!great_subset("stdlib:memory:malloc")
-	&& !great_subset("stdlib:memory:realloc")
-	&& !great_subset("stdlib:memory:free")) {
-		great_c99.free(ptr);
+static void
+xfree(void *ptr) {
+	if (!GREAT_C99_SUBSET(malloc)
+	&& !GREAT_C99_SUBSET(realloc)
+	&& !GREAT_C99_SUBSET(free)) {
+		GREAT_C99(free)(ptr);
 		return;
     }
 
 	if(ptr == great_nothing + 1) {
-		great_log(GREAT_LOG_INFO, "stdlib:memory:free",
+		great_log(GREAT_LOG_INFO, GREAT_C99_PATH(free),
 			"Handling great_nothing");
 		return;
 	}
 
-	great_log(GREAT_LOG_DEFAULT, "stdio:memory:free", NULL);
-	great_c99.free(ptr);
+	great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(free), NULL);
+	GREAT_C99(free)(ptr);
 }
 
 /* C99 7.20.3.3 The malloc function */
-void *
-malloc(size_t size)
+static void *
+xmalloc(size_t size, const void *caller)
 {
-	if (!great_subset("stdlib:memory:malloc")) {
-		return great_c99.malloc(size);
+	if (great_memlimit_enabled && great_memlimit_exceeded(NULL, size)) {
+		/* P3 The malloc function returns either a null pointer... */
+		great_ib(GREAT_C99_PATH(malloc), "7.20.3.3 P3",
+			"Returning NULL at the memory limit");
+		return NULL;
+	}
+
+	if (!GREAT_C99_SUBSET(malloc)) {
+		return GREAT_C99(malloc)(size);
+	}
+
+	if (!GREAT_C99_SIZE(malloc, size, 0)) {
+		return GREAT_C99(malloc)(size);
 	}
 
-	if (!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "stdlib:memory:malloc", NULL);
-		return great_c99.malloc(size);
+	if (!GREAT_C99_INJECT(malloc, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(malloc), NULL);
+		return GREAT_C99(malloc)(size);
 	}
 
 	switch(great_random_choice(1u + (size == 0))) {
 	case 0:
 		/* P3 The malloc function returns either a null pointer... */
-		great_ib("stdio:memory:malloc", "7.20.3.3 P3", "Returning NULL");
+		great_ib(GREAT_C99_PATH(malloc), "7.20.3.3 P3", "Returning NULL");
 		return NULL;
 
 	case 1:
 		/* J.2 IDB: The amount of storage allocated by a successful call to
 		 * malloc when 0 bytes was requested */
 		/* XXX IDB: we could also return an arbitary amount of memory here */
-		great_ib("stdio:memory:malloc", "7.20.3.3 P3",
+		great_ib(GREAT_C99_PATH(malloc), "7.20.3.3 P3",
 			"Returning great_nothing");
 		assert(size == 0);
 		return great_nothing + 1;
@@ -111,31 +130,42 @@ malloc(size_t size)
 }
 
 /* C99 7.20.3.4 The realloc function */
-void *
-realloc(void *ptr, size_t size)
+static void *
+xrealloc(void *ptr, size_t size, const void *caller)
 {
-	if (!great_subset("stdlib:memory:realloc")) {
-		return great_c99.realloc(ptr, size);
+	if (great_memlimit_enabled && great_memlimit_exceeded(ptr, size)) {
+		/* P4 The realloc function returns ... a null pointer */
+		great_ib(GREAT_C99_PATH(realloc), "7.20.3.4 P4",
+			"Returning NULL at the memory limit");
+		return NULL;
+	}
+
+	if (!GREAT_C99_SUBSET(realloc)) {
+		return GREAT_C99(realloc)(ptr, size);
     }
 
-	if(!great_random_probability(NULL)) {
-		great_log(GREAT_LOG_DEFAULT, "stdlib:memory:realloc", NULL);
-		return great_c99.realloc(ptr, size);
+	if (!GREAT_C99_SIZE(realloc, size, usable(ptr))) {
+		return GREAT_C99(realloc)(ptr, size);
+	}
+
+	if(!GREAT_C99_INJECT(realloc, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(realloc), NULL);
+		return GREAT_C99(realloc)(ptr, size);
 	}
 
 	/* P3 If ptr is a null pointer, the realloc function behaves like like
 	 *    malloc function for the specified size. */
 	if(ptr == NULL) {
-		great_ib("stdio:memory:realloc", "7.20.3.4 P3",
+		great_ib(GREAT_C99_PATH(realloc), "7.20.3.4 P3",
 			"Returning malloc()");
-		return malloc(size);
+		return xmalloc(size, caller);
 	}
 
 	/* P4 The realloc function returns a pointer to the new object */
 	switch(great_random_choice(2)) {
 	case 0:
 		/* P4 The realloc function returns ... a null pointer */
-		great_ib("stdio:memory:realloc", "7.20.3.4 P4", "Returning NULL");
+		great_ib(GREAT_C99_PATH(realloc), "7.20.3.4 P4", "Returning NULL");
 		return NULL;
 
 	case 1:
@@ -144,11 +174,11 @@ realloc(void *ptr, size_t size)
 			void *p;
 
 			/* XXX call our callback, here */
-			p = malloc(size);
+			p = xmalloc(size, caller);
 			if(!p) {
-				great_perror("stdlib:memory:realloc", "malloc");
+				great_perror(GREAT_C99_PATH(realloc), "malloc");
 
-				great_ib("stdio:memory:realloc", "7.20.3.4 P4",
+				great_ib(GREAT_C99_PATH(realloc), "7.20.3.4 P4",
 					"Returning NULL");
 
 				return NULL;
@@ -159,9 +189,9 @@ realloc(void *ptr, size_t size)
 			/* P2 The contents of the new object shall be the same as that of
 			 *    the old object, up to the lesser of the new and old sizes. */
 			memcpy(p, ptr, size);
-			free(ptr);
+			xfree(ptr);
 
-			great_ib("stdio:memory:realloc", "7.20.3.4 P2",
+			great_ib(GREAT_C99_PATH(realloc), "7.20.3.4 P2",
 				"Returning different address");
 
 			return p;
@@ -175,3 +205,99 @@ realloc(void *ptr, size_t size)
 	return NULL;
 }
 
+
+/*
+ * realloc() for a block from the bootstrap arena, or for a null pointer whilst
+ * bootstrapping; see bootstrap.h. The old block is left in the arena.
+ */
+static void *
+brealloc(void *ptr, size_t size)
+{
+	size_t n;
+	void *p;
+
+	if (GREAT_BOOTSTRAPPING()) {
+		p = great_bootstrap_malloc(size);
+	} else {
+		p = GREAT_C99(malloc)(size);
+	}
+
+	if (p == NULL || ptr == NULL) {
+		return p;
+	}
+
+	n = great_bootstrap_size(ptr);
+	memcpy(p, ptr, n < size ? n : size);
+
+	return p;
+}
+
+/*
+ * The functions exported are thin wrappers around those above, so that each
+ * call made by the application is observed exactly once; see alloc.h.
+ * Calls made internally between these functions are not observed, and
+ * neither are allocations from the bootstrap arena.
+ */
+
+GREAT_WRAP_EXPORT void
+GREAT_C99_WRAP(free)(void *ptr)
+{
+	if (great_bootstrap_owns(ptr)) {
+		return;
+	}
+
+	if (great_alloc_enabled) {
+		great_alloc_free(ptr);
+	}
+
+	xfree(ptr);
+}
+
+GREAT_WRAP_EXPORT void *
+GREAT_C99_WRAP(malloc)(size_t size)
+{
+	const void *caller;
+	void *p;
+
+	if (GREAT_BOOTSTRAPPING()) {
+		return great_bootstrap_malloc(size);
+	}
+
+	/* Kept, since xmalloc() may log, and so call wrapped functions */
+	caller = GREAT_WRAP_CALLER();
+
+	p = xmalloc(size, caller);
+
+	if (great_alloc_enabled) {
+		great_alloc_malloc(size, p, caller);
+	}
+
+	return p;
+}
+
+GREAT_WRAP_EXPORT void *
+GREAT_C99_WRAP(realloc)(void *ptr, size_t size)
+{
+	const void *caller;
+	size_t oldsize;
+	void *p;
+
+	if (great_bootstrap_owns(ptr) || (ptr == NULL && GREAT_BOOTSTRAPPING())) {
+		return brealloc(ptr, size);
+	}
+
+	caller = GREAT_WRAP_CALLER();
+
+	oldsize = 0;
+	if (great_alloc_enabled && ptr != great_nothing + 1) {
+		oldsize = great_usable_size(ptr);
+	}
+
+	p = xrealloc(ptr, size, caller);
+
+	if (great_alloc_enabled) {
+		great_alloc_realloc(ptr, oldsize, size, p, caller);
+	}
+
+	return p;
+}
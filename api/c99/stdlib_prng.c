@@ -43,12 +43,16 @@
 #include "../../src/shared/log.h"
 
 /* C99 7.20.2.1 The rand function */
-int
-rand(void)
+GREAT_WRAP_EXPORT int
+GREAT_C99_WRAP(rand)(void)
 {
-	if (!great_subset("stdlib:prng:rand")
-	&& !great_subset("stdlib:prng:srand")) {
-		return great_c99.rand();
+	const void *caller;
+
+	caller = GREAT_WRAP_CALLER();
+
+	if (!GREAT_C99_SUBSET(rand)
+	&& !GREAT_C99_SUBSET(srand)) {
+		return GREAT_C99(rand)();
 	}
 
 	/*
@@ -57,9 +61,9 @@ rand(void)
 	 * given the same seed). Hence we make that descision part of the same
 	 * sequence we return, by simply using rand().
 	 */
-	if(!great_random_probability(&great_c99.random_rand)) {
-		great_log(GREAT_LOG_DEFAULT, "stdlib:prng:rand", NULL);
-		return great_c99.rand();
+	if(!GREAT_C99_INJECT(rand, &great_c99.random_rand, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(rand), NULL);
+		return GREAT_C99(rand)();
 	}
 
 	/* P4 The rand function returns a pseudo-random integer */
@@ -68,24 +72,24 @@ rand(void)
 	 * random numbers may repeat one number infinitely. Seven is one of
 	 * my favorite numbers.
 	 */
-	great_ib("stdlib:prng:rand", "7.20.2.1 P4", "Returning constant");
+	great_ib(GREAT_C99_PATH(rand), "7.20.2.1 P4", "Returning constant");
 	return 7;
 }
 
 /* C99 7.20.2.2 The srand function */
-void
-srand(unsigned int seed)
+GREAT_WRAP_EXPORT void
+GREAT_C99_WRAP(srand)(unsigned int seed)
 {
-	if (!great_subset("stdlib:prng:rand")
-	&& !great_subset("stdlib:prng:srand")) {
-		great_c99.srand(seed);
+	if (!GREAT_C99_SUBSET(rand)
+	&& !GREAT_C99_SUBSET(srand)) {
+		GREAT_C99(srand)(seed);
 		return;
 	}
 
 	/* P2 If srand is then called with the same seed value, the
 	 * sequence of pseudo-random numbers shall be repeated. */
-	great_log(GREAT_LOG_DEFAULT, "stdlib:prng:srand", NULL);
-	great_c99.srand(seed);
+	great_log(GREAT_LOG_DEFAULT, GREAT_C99_PATH(srand), NULL);
+	GREAT_C99(srand)(seed);
 
 	/*
 	 * For our wrapper, this additionally means that our failure descisions also
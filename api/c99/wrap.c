@@ -38,70 +38,62 @@
 #include "../../src/wrap.h"
 #include "../../src/shared/random.h"
 #include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
 #include "../../src/shared/log.h"
+#include "../../src/shared/alloc.h"
 
 struct great_c99 great_c99;
 
-/* TODO provide static initialisation alternative */
-void
-_init(void) {
-	/* ctype.c */
-	great_c99.isalnum =
-		(int (*)(int c)) great_wrap_resolve("isalnum");
-	great_c99.isalpha =
-		(int (*)(int c)) great_wrap_resolve("isalpha");
-	great_c99.isblank =
-		(int (*)(int c)) great_wrap_resolve("isblank");
-	great_c99.iscntrl =
-		(int (*)(int c)) great_wrap_resolve("iscntrl");
-	great_c99.isdigit =
-		(int (*)(int c)) great_wrap_resolve("isdigit");
-	great_c99.isgraph =
-		(int (*)(int c)) great_wrap_resolve("isgraph");
-	great_c99.islower =
-		(int (*)(int c)) great_wrap_resolve("islower");
-	great_c99.isprint =
-		(int (*)(int c)) great_wrap_resolve("isprint");
-	great_c99.ispunct =
-		(int (*)(int c)) great_wrap_resolve("ispunct");
-	great_c99.isspace =
-		(int (*)(int c)) great_wrap_resolve("isspace");
-	great_c99.isupper =
-		(int (*)(int c)) great_wrap_resolve("isupper");
-	great_c99.isxdigit =
-		(int (*)(int c)) great_wrap_resolve("isxdigit");
-
-	/* stdio_fileaccess.c */
-	great_c99.fopen =
-		(FILE *(*)(const char * restrict, const char * restrict))
-		great_wrap_resolve("fopen");
-
-	/* stdlib_prng.c */
-	great_c99.rand =
-		(int (*)(void)) great_wrap_resolve("rand");
-	great_c99.srand =
-		(void (*)(unsigned int)) great_wrap_resolve("srand");
-
-	/* stdlib_memory.c */
-	great_c99.free =
-		(void (*)(void *)) great_wrap_resolve("free");
-	great_c99.malloc  =
-		(void *(*)(size_t)) great_wrap_resolve("malloc");
-	great_c99.realloc =
-		(void *(*)(void *, size_t)) great_wrap_resolve("realloc");
+#define GREAT_C99_PATH_ENTRY(name, ret, params, path, section) path,
+const char *const great_c99_path[GREAT_C99_COUNT] = {
+	GREAT_C99_FUNCTIONS(GREAT_C99_PATH_ENTRY)
+};
+#undef GREAT_C99_PATH_ENTRY
 
-	great_subset_disable();
+#define GREAT_C99_SECTION_ENTRY(name, ret, params, path, section) section,
+const char *const great_c99_section[GREAT_C99_COUNT] = {
+	GREAT_C99_FUNCTIONS(GREAT_C99_SECTION_ENTRY)
+};
+#undef GREAT_C99_SECTION_ENTRY
 
+signed char great_c99_memo[GREAT_C99_COUNT];
+struct great_schedule great_c99_schedule[GREAT_C99_COUNT];
+
+void
+great_c99_setup(void)
+{
 	/* C99 7.20.2.2 P2 If rand is called before any calls to srand have been
 	 * made, the same sequence shall be generated as when srand is first called
 	 * with a seed value of 1. */
 	great_random_init(&great_c99.random_rand);
 	great_random_seed(&great_c99.random_rand, 1);
+}
+
+#ifndef GREAT_WRAP_UNIFIED
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_INIT(c99)(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
+
+	great_subset_disable();
+
+	great_c99_setup();
 
 	great_log_init("libgreat_c99", "C99");
 	great_random_init(NULL);
 	great_subset_init();
+	great_schedule_init(great_c99_schedule, great_c99_path,
+		GREAT_C99_COUNT);
+	great_alloc_init();
 
 	great_subset_enable();
 }
 
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_FINI(c99)(void) {
+	great_subset_disable();
+
+	great_alloc_fini();
+
+	great_subset_enable();
+}
+#endif
@@ -39,6 +39,55 @@
 #include <stdio.h>
 
 #include "../../src/shared/random.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+#include "../../src/wrap.h"
+
+/*
+ * The functions wrapped, one per line: the function's name, return type and
+ * parameter list, its subset path (see GREAT_SUBSETS), and the section of
+ * C99 which specifies it. Everything else about the list of wrapped functions
+ * is generated from this table; adding a wrapper means adding a line here and
+ * an implementation.
+ */
+#define GREAT_C99_FUNCTIONS(X) \
+	/* ctype.c */ \
+	X(isalnum,  int, (int c), "ctype:class:isalnum",  "7.4.1.1") \
+	X(isalpha,  int, (int c), "ctype:class:isalpha",  "7.4.1.2") \
+	X(isblank,  int, (int c), "ctype:class:isblank",  "7.4.1.3") \
+	X(iscntrl,  int, (int c), "ctype:class:iscntrl",  "7.4.1.4") \
+	X(isdigit,  int, (int c), "ctype:class:isdigit",  "7.4.1.5") \
+	X(isgraph,  int, (int c), "ctype:class:isgraph",  "7.4.1.6") \
+	X(islower,  int, (int c), "ctype:class:islower",  "7.4.1.7") \
+	X(isprint,  int, (int c), "ctype:class:isprint",  "7.4.1.8") \
+	X(ispunct,  int, (int c), "ctype:class:ispunct",  "7.4.1.9") \
+	X(isspace,  int, (int c), "ctype:class:isspace",  "7.4.1.10") \
+	X(isupper,  int, (int c), "ctype:class:isupper",  "7.4.1.11") \
+	X(isxdigit, int, (int c), "ctype:class:isxdigit", "7.4.1.12") \
+	\
+	/* stdio_fileaccess.c */ \
+	X(fopen, FILE *, (const char * restrict filename, \
+		const char * restrict mode), "stdio:fileaccess:fopen", "7.19.5.3") \
+	\
+	/* stdlib_prng.c */ \
+	X(rand,  int,  (void),              "stdlib:prng:rand",  "7.20.2.1") \
+	X(srand, void, (unsigned int seed), "stdlib:prng:srand", "7.20.2.2") \
+	\
+	/* stdlib_memory.c */ \
+	X(free,    void,   (void *ptr),              "stdlib:memory:free",    "7.20.3.2") \
+	X(malloc,  void *, (size_t size),            "stdlib:memory:malloc",  "7.20.3.3") \
+	X(realloc, void *, (void *ptr, size_t size), "stdlib:memory:realloc", "7.20.3.4")
+
+/*
+ * A dense ID for each function, GREAT_C99_ID_<name>, for indexing the tables
+ * below. GREAT_C99_COUNT gives the number of functions.
+ */
+enum great_c99_function {
+#define GREAT_C99_ID(name, ret, params, path, section) GREAT_C99_ID_##name,
+	GREAT_C99_FUNCTIONS(GREAT_C99_ID)
+#undef GREAT_C99_ID
+	GREAT_C99_COUNT
+};
 
 struct great_c99 {
 	/*
@@ -51,37 +100,110 @@ struct great_c99 {
 	 */
 	struct great_random_state random_rand;	/* rand() state */
 
-	/* ctype.c */
-	int (*isalnum)(int c);
-	int (*isalpha)(int c);
-	int (*isblank)(int c);
-	int (*iscntrl)(int c);
-	int (*isdigit)(int c);
-	int (*isgraph)(int c);
-	int (*islower)(int c);
-	int (*isprint)(int c);
-	int (*ispunct)(int c);
-	int (*isspace)(int c);
-	int (*isupper)(int c);
-	int (*isxdigit)(int c);
-
-	/* stdio_fileaccess.c */
-	FILE *(*fopen)(const char * restrict filename, const char * restrict mode);
-
-	/* stdlib_prng.c */
-	int (*rand)(void);
-	void (*srand)(unsigned int seed);
-
-	/* stdlib_memory.c */
-	void (*free)(void *ptr);
-	void *(*malloc)(size_t size);
-	void *(*realloc)(void *ptr, size_t size);
+	/* The real functions, resolved on first use */
+#define GREAT_C99_MEMBER(name, ret, params, path, section) ret (*name) params;
+	GREAT_C99_FUNCTIONS(GREAT_C99_MEMBER)
+#undef GREAT_C99_MEMBER
 };
 
 extern struct great_c99 great_c99;
 
+/*
+ * Subset paths and sections of C99, by function ID.
+ */
+extern const char *const great_c99_path[GREAT_C99_COUNT];
+extern const char *const great_c99_section[GREAT_C99_COUNT];
+
+/*
+ * Subset matches by function ID; see great_subset_memo().
+ */
+extern signed char great_c99_memo[GREAT_C99_COUNT];
+
+/*
+ * Injection schedules by function ID; see great_schedule().
+ */
+extern struct great_schedule great_c99_schedule[GREAT_C99_COUNT];
+
+#ifdef GREAT_WRAP_STATIC
+/*
+ * The wrappers, and the real functions which ld --wrap binds in their place.
+ */
+#define GREAT_C99_STATIC(name, ret, params, path, section) \
+	ret __wrap_##name params; \
+	ret __real_##name params;
+GREAT_C99_FUNCTIONS(GREAT_C99_STATIC)
+#undef GREAT_C99_STATIC
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+/*
+ * In the unified library (see api/unified/wrap.h) each wrapper is named for
+ * its API, and is called by way of the function exported for all APIs. The
+ * real functions are shared between APIs, in great_real.
+ */
+#include "../unified/wrap.h"
+
+#define GREAT_C99_WRAP(f) great_c99_wrap_##f
+#define GREAT_C99(f) GREAT_WRAP_REAL(great_real, f)
+
+#define GREAT_C99_UNIFIED(name, ret, params, path, section) \
+	ret GREAT_C99_WRAP(name) params;
+GREAT_C99_FUNCTIONS(GREAT_C99_UNIFIED)
+#undef GREAT_C99_UNIFIED
+
+/*
+ * There is also just the one log, and so each section names its standard.
+ */
+#include "../../src/shared/log.h"
+#undef great_ib
+#undef great_ub
+#define great_ib(facility, section, ...) \
+	great_ib((facility), "C99 " section, __VA_ARGS__)
+#define great_ub(facility, section, ...) \
+	great_ub((facility), "C99 " section, __VA_ARGS__)
+#else
+/*
+ * The name of the wrapper for f, and the real function for a member of
+ * great_c99; see GREAT_WRAP_NAME() and GREAT_WRAP_REAL().
+ */
+#define GREAT_C99_WRAP(f) GREAT_WRAP_NAME(f)
+#define GREAT_C99(f) GREAT_WRAP_REAL(great_c99, f)
+#endif
+
+/*
+ * The subset path for a function, and whether it is in the current subsets.
+ */
+#define GREAT_C99_PATH(f) (great_c99_path[GREAT_C99_ID_##f])
+#define GREAT_C99_SUBSET(f) \
+	GREAT_SUBSET_MEMO(GREAT_C99_PATH(f), &great_c99_memo[GREAT_C99_ID_##f])
+
+/*
+ * Whether to intercept a call to a function found in the current subsets, made
+ * from the call site caller; see GREAT_WRAP_CALLER().
+ */
+#define GREAT_C99_INJECT(f, state, caller) \
+	great_schedule(&great_c99_schedule[GREAT_C99_ID_##f], (state), (caller))
+
+/*
+ * Whether a request of size bytes, resizing a block of old bytes, is to be
+ * considered for interception; see GREAT_SCHEDULE_SIZE().
+ */
+#define GREAT_C99_SIZE(f, size, old) \
+	GREAT_SCHEDULE_SIZE(&great_c99_schedule[GREAT_C99_ID_##f], (size), (old))
+
+/*
+ * Set up state particular to this API. This is called with subsets disabled.
+ */
+void
+great_c99_setup(void);
+
+#ifndef GREAT_WRAP_UNIFIED
 extern void
-_init(void);
+GREAT_WRAP_INIT(c99)(void);
+
+extern void
+GREAT_WRAP_FINI(c99)(void);
+#endif
 
 #endif
 
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * GNU <pthread.h>
+ *
+ * $Id$
+ */
+
+/* Required for pthread_setname_np() */
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "wrap.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/threadname.h"
+#include "../../src/shared/log.h"
+
+/*
+ * Pass through, and note a thread renamed for great_threadname().
+ */
+static int
+setname(pthread_t thread, const char *name)
+{
+	int r;
+
+	r = GREAT_GNU(pthread_setname_np)(thread, name);
+	if (r == 0) {
+		/* great_thread_id() gives pthread_self() */
+		great_threadname_rename((unsigned long) (uintptr_t) thread);
+	}
+
+	return r;
+}
+
+GREAT_WRAP_EXPORT int
+GREAT_GNU_WRAP(pthread_setname_np)(pthread_t thread, const char *name)
+{
+	const void *caller;
+
+	caller = GREAT_WRAP_CALLER();
+
+	if (!GREAT_GNU_SUBSET(pthread_setname_np)) {
+		return setname(thread, name);
+	}
+
+	if (!GREAT_GNU_INJECT(pthread_setname_np, NULL, caller)) {
+		great_log(GREAT_LOG_DEFAULT, GREAT_GNU_PATH(pthread_setname_np), NULL);
+		return setname(thread, name);
+	}
+
+	great_ib(GREAT_GNU_PATH(pthread_setname_np), "pthread_setname_np(3)",
+		"Returning ERANGE");
+
+	/*
+	 * pthread_setname_np(3): On success, these functions return 0; on error,
+	 * they return a nonzero error number.
+	 *
+	 * pthread_setname_np(3): ERANGE The length of the string specified
+	 * pointed to by name exceeds the allowed limit.
+	 */
+	return ERANGE;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ */
+
+#include <stddef.h>
+
+#include "wrap.h"
+#include "../../src/wrap.h"
+#include "../../src/shared/random.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+#include "../../src/shared/log.h"
+
+struct great_gnu great_gnu;
+
+#define GREAT_GNU_PATH_ENTRY(name, ret, params, path, section) path,
+const char *const great_gnu_path[GREAT_GNU_COUNT] = {
+	GREAT_GNU_FUNCTIONS(GREAT_GNU_PATH_ENTRY)
+};
+#undef GREAT_GNU_PATH_ENTRY
+
+#define GREAT_GNU_SECTION_ENTRY(name, ret, params, path, section) section,
+const char *const great_gnu_section[GREAT_GNU_COUNT] = {
+	GREAT_GNU_FUNCTIONS(GREAT_GNU_SECTION_ENTRY)
+};
+#undef GREAT_GNU_SECTION_ENTRY
+
+signed char great_gnu_memo[GREAT_GNU_COUNT];
+struct great_schedule great_gnu_schedule[GREAT_GNU_COUNT];
+
+#ifndef GREAT_WRAP_UNIFIED
+GREAT_WRAP_VISIBLE void
+GREAT_WRAP_INIT(gnu)(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
+
+	great_subset_disable();
+
+	great_log_init("libgreat_gnu", "GNU");
+	great_random_init(NULL);
+	great_subset_init();
+	great_schedule_init(great_gnu_schedule, great_gnu_path,
+		GREAT_GNU_COUNT);
+
+	great_subset_enable();
+}
+#endif
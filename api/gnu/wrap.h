@@ -0,0 +1,153 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ */
+
+#ifndef GREAT_GNU_WRAP_H
+#define GREAT_GNU_WRAP_H
+
+#include <pthread.h>
+
+#include "../../src/wrap.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+
+/*
+ * The functions wrapped, one per line: the function's name, return type and
+ * parameter list, its subset path (see GREAT_SUBSETS), and the section of
+ * the GNU C library manual which specifies it. See api/c99/wrap.h.
+ *
+ * These are extensions to POSIX by the GNU C library. pthread_setname_np() is
+ * wrapped chiefly so that threads renamed are noticed by $GREAT_THREADS (see
+ * src/shared/threadname.h), which they are whether or not it is in a subset.
+ */
+#define GREAT_GNU_FUNCTIONS(X) \
+	/* pthread.c */ \
+	X(pthread_setname_np, int, (pthread_t thread, const char *name), \
+		"pthread:thread:pthread_setname_np", "pthread_setname_np(3)")
+
+enum great_gnu_function {
+#define GREAT_GNU_ID(name, ret, params, path, section) GREAT_GNU_ID_##name,
+	GREAT_GNU_FUNCTIONS(GREAT_GNU_ID)
+#undef GREAT_GNU_ID
+	GREAT_GNU_COUNT
+};
+
+struct great_gnu {
+	/* The real functions, resolved on first use */
+#define GREAT_GNU_MEMBER(name, ret, params, path, section) ret (*name) params;
+	GREAT_GNU_FUNCTIONS(GREAT_GNU_MEMBER)
+#undef GREAT_GNU_MEMBER
+};
+
+extern struct great_gnu great_gnu;
+
+/*
+ * Subset paths and sections, by function ID, and subset matches; see
+ * great_subset_memo().
+ */
+extern const char *const great_gnu_path[GREAT_GNU_COUNT];
+extern const char *const great_gnu_section[GREAT_GNU_COUNT];
+extern signed char great_gnu_memo[GREAT_GNU_COUNT];
+
+/*
+ * Injection schedules by function ID; see great_schedule().
+ */
+extern struct great_schedule great_gnu_schedule[GREAT_GNU_COUNT];
+
+#ifdef GREAT_WRAP_STATIC
+/*
+ * The wrappers, and the real functions which ld --wrap binds in their place.
+ */
+#define GREAT_GNU_STATIC(name, ret, params, path, section) \
+	ret __wrap_##name params; \
+	ret __real_##name params;
+GREAT_GNU_FUNCTIONS(GREAT_GNU_STATIC)
+#undef GREAT_GNU_STATIC
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+/*
+ * In the unified library (see api/unified/wrap.h) each wrapper is named for
+ * its API, and is called by way of the function exported for all APIs. The
+ * real functions are shared between APIs, in great_real.
+ */
+#include "../unified/wrap.h"
+
+#define GREAT_GNU_WRAP(f) great_gnu_wrap_##f
+#define GREAT_GNU(f) GREAT_WRAP_REAL(great_real, f)
+
+#define GREAT_GNU_UNIFIED(name, ret, params, path, section) \
+	ret GREAT_GNU_WRAP(name) params;
+GREAT_GNU_FUNCTIONS(GREAT_GNU_UNIFIED)
+#undef GREAT_GNU_UNIFIED
+
+/*
+ * There is also just the one log, and so each section names its standard.
+ */
+#include "../../src/shared/log.h"
+#undef great_ib
+#undef great_ub
+#define great_ib(facility, section, ...) \
+	great_ib((facility), "GNU " section, __VA_ARGS__)
+#define great_ub(facility, section, ...) \
+	great_ub((facility), "GNU " section, __VA_ARGS__)
+#else
+/*
+ * The name of the wrapper for f, and the real function for a member of
+ * great_gnu; see GREAT_WRAP_NAME() and GREAT_WRAP_REAL().
+ */
+#define GREAT_GNU_WRAP(f) GREAT_WRAP_NAME(f)
+#define GREAT_GNU(f) GREAT_WRAP_REAL(great_gnu, f)
+#endif
+
+/*
+ * The subset path for a function, and whether it is in the current subsets.
+ */
+#define GREAT_GNU_PATH(f) (great_gnu_path[GREAT_GNU_ID_##f])
+#define GREAT_GNU_SUBSET(f) \
+	GREAT_SUBSET_MEMO(GREAT_GNU_PATH(f), &great_gnu_memo[GREAT_GNU_ID_##f])
+
+/*
+ * Whether to intercept a call to a function found in the current subsets, made
+ * from the call site caller; see GREAT_WRAP_CALLER().
+ */
+#define GREAT_GNU_INJECT(f, state, caller) \
+	great_schedule(&great_gnu_schedule[GREAT_GNU_ID_##f], (state), (caller))
+
+#ifndef GREAT_WRAP_UNIFIED
+extern void
+GREAT_WRAP_INIT(gnu)(void);
+#endif
+
+#endif
+
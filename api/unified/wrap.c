@@ -0,0 +1,363 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/*
+ * These prototypes are given explicitly here in order to avoid macro
+ * equivalents defined in the system's <ctype.h> header, and because strdup()
+ * is not declared by <string.h> for strict C99; see api/c99/ctype.c and
+ * api/bsd44/string.c. Likewise pthread_setname_np() is declared by
+ * <pthread.h> only for _GNU_SOURCE.
+ */
+int isalnum(int c);
+int isalpha(int c);
+int isblank(int c);
+int iscntrl(int c);
+int isdigit(int c);
+int isgraph(int c);
+int islower(int c);
+int isprint(int c);
+int ispunct(int c);
+int isspace(int c);
+int isupper(int c);
+int isxdigit(int c);
+char *strdup(const char *str);
+int pthread_setname_np(pthread_t thread, const char *name);
+
+#include "wrap.h"
+#include "../c89/wrap.h"
+#include "../c99/wrap.h"
+#include "../bsd42/wrap.h"
+#include "../bsd44/wrap.h"
+#include "../gnu/wrap.h"
+#include "../../src/wrap.h"
+#include "../../src/shared/random.h"
+#include "../../src/shared/subset.h"
+#include "../../src/shared/schedule.h"
+#include "../../src/shared/log.h"
+#include "../../src/shared/alloc.h"
+#include "../../src/shared/threadname.h"
+
+struct great_real great_real;
+
+/* See GREAT_WRAP_CALLER() */
+__thread const void *great_wrap_caller;
+
+/*
+ * The wrapper called for each function, by function ID. These start out as
+ * each function's default API, so that calls made before _init (and during it)
+ * are handled by a wrapper which copes with that. Once _init is done, functions
+ * whose wrapper would only pass through are called directly; see bind().
+ */
+static void (*dispatch[GREAT_COUNT])(void) = {
+#define DEFAULT(name, ret, params, args, retkw, api) \
+	[GREAT_ID_##name] = (void (*)(void)) great_##api##_wrap_##name,
+	GREAT_FUNCTIONS(DEFAULT)
+#undef DEFAULT
+};
+
+/*
+ * The functions exported. The name is parenthesised in case of a macro by
+ * the same name. Each passes its caller on to the wrapper explicitly, since
+ * this is a call of its own (see GREAT_WRAP_CALLER()). dispatch[] may be
+ * changed concurrently by bind() or by a stub from direct(), and so is read
+ * and written atomically, so that a thread seeing a new entry sees the real
+ * function it was resolved to as well.
+ */
+#define EXPORT(name, ret, params, args, retkw, api) \
+	GREAT_WRAP_VISIBLE ret \
+	(name) params \
+	{ \
+		great_wrap_caller = GREAT_WRAP_RETURN(); \
+		retkw ((ret (*) params) __atomic_load_n(&dispatch[GREAT_ID_##name], \
+			__ATOMIC_ACQUIRE)) args; \
+	}
+GREAT_FUNCTIONS(EXPORT)
+#undef EXPORT
+
+/*
+ * Set while reading $GREAT_APIS for each function given a wrapper, so that the
+ * first API listed takes precedence. The subset path and memo of the wrapper
+ * claiming each function are kept for bind(); functions claimed by no API
+ * selected are never intercepted.
+ */
+static bool claimed[GREAT_COUNT];
+static const char *paths[GREAT_COUNT];
+static signed char *memos[GREAT_COUNT];
+
+static void
+claim(enum great_function id, void (*f)(void), const char *path,
+	signed char *memo)
+{
+	if (claimed[id]) {
+		return;
+	}
+
+	__atomic_store_n(&dispatch[id], f, __ATOMIC_RELEASE);
+	paths[id] = path;
+	memos[id] = memo;
+	claimed[id] = true;
+}
+
+#define CLAIM(api, API, name) \
+	claim(GREAT_ID_##name, (void (*)(void)) great_##api##_wrap_##name, \
+		great_##api##_path[GREAT_##API##_ID_##name], \
+		&great_##api##_memo[GREAT_##API##_ID_##name]);
+
+#define CLAIM_C89(name, ret, params, path, section) CLAIM(c89, C89, name)
+#define CLAIM_C99(name, ret, params, path, section) CLAIM(c99, C99, name)
+#define CLAIM_BSD42(name, ret, params, path, section) CLAIM(bsd42, BSD42, name)
+#define CLAIM_BSD44(name, ret, params, path, section) CLAIM(bsd44, BSD44, name)
+#define CLAIM_GNU(name, ret, params, path, section) CLAIM(gnu, GNU, name)
+
+static void
+claim_c89(void)
+{
+	GREAT_C89_FUNCTIONS(CLAIM_C89)
+}
+
+static void
+claim_c99(void)
+{
+	GREAT_C99_FUNCTIONS(CLAIM_C99)
+}
+
+static void
+claim_bsd42(void)
+{
+	GREAT_BSD42_FUNCTIONS(CLAIM_BSD42)
+}
+
+static void
+claim_bsd44(void)
+{
+	GREAT_BSD44_FUNCTIONS(CLAIM_BSD44)
+}
+
+static void
+claim_gnu(void)
+{
+	GREAT_GNU_FUNCTIONS(CLAIM_GNU)
+}
+
+static struct api {
+	const char *name;
+	void (*claim)(void);
+	const char *const *path;
+	signed char *memo;
+	struct great_schedule *schedule;
+	size_t count;
+	bool selected;
+} apis[] = {
+	{ "c89",   claim_c89,   great_c89_path,   great_c89_memo,
+		great_c89_schedule,   GREAT_C89_COUNT,   false },
+	{ "c99",   claim_c99,   great_c99_path,   great_c99_memo,
+		great_c99_schedule,   GREAT_C99_COUNT,   false },
+	{ "bsd42", claim_bsd42, great_bsd42_path, great_bsd42_memo,
+		great_bsd42_schedule, GREAT_BSD42_COUNT, false },
+	{ "bsd44", claim_bsd44, great_bsd44_path, great_bsd44_memo,
+		great_bsd44_schedule, GREAT_BSD44_COUNT, false },
+	{ "gnu",   claim_gnu,   great_gnu_path,   great_gnu_memo,
+		great_gnu_schedule,   GREAT_GNU_COUNT,   false }
+};
+
+static void
+select_apis(void)
+{
+	const char *s;
+	size_t i;
+	size_t n;
+
+	s = getenv("GREAT_APIS");
+	if (!s) {
+		s = "c99,bsd42,bsd44";
+	}
+
+	for (;;) {
+		s += strspn(s, " \t,:;|/");
+		if (!*s) {
+			break;
+		}
+
+		n = strcspn(s, " \t,:;|/");
+
+		for (i = 0; i < sizeof apis / sizeof *apis; i++) {
+			if (strlen(apis[i].name) == n && !strncmp(apis[i].name, s, n)) {
+				break;
+			}
+		}
+
+		if (i == sizeof apis / sizeof *apis) {
+			great_log(GREAT_LOG_ERROR, "GREAT_APIS",
+				"Unrecognised API %.*s; disregarding", (int) n, s);
+		} else if (!apis[i].selected) {
+			apis[i].claim();
+			apis[i].selected = true;
+
+			great_log(GREAT_LOG_INFO, "GREAT_APIS",
+				"Selected API: %s", apis[i].name);
+		}
+
+		s += n;
+	}
+
+	/* the others' wrappers behave as if outside of every subset */
+	for (i = 0; i < sizeof apis / sizeof *apis; i++) {
+		if (!apis[i].selected) {
+			memset(apis[i].memo, -1, apis[i].count);
+			continue;
+		}
+
+		great_schedule_init(apis[i].schedule, apis[i].path, apis[i].count);
+	}
+}
+
+static bool
+intercepts(enum great_function id)
+{
+	return claimed[id] && great_subset_memo(paths[id], memos[id]);
+}
+
+/*
+ * Find whether the wrapper for a function would only ever pass through to the
+ * real function, given the configuration read by _init.
+ */
+static bool
+passthrough(enum great_function id)
+{
+	/* These must recognise blocks from the bootstrap arena */
+	if (id == GREAT_ID_free || id == GREAT_ID_realloc) {
+		return false;
+	}
+
+	if (id == GREAT_ID_malloc && great_alloc_enabled) {
+		return false;
+	}
+
+	/* This notes threads renamed, whether or not it intercepts */
+	if (id == GREAT_ID_pthread_setname_np && great_threadname_enabled) {
+		return false;
+	}
+
+	/* Each of these wrappers intercepts if either function is in a subset */
+	if (id == GREAT_ID_rand || id == GREAT_ID_srand) {
+		return !intercepts(GREAT_ID_rand) && !intercepts(GREAT_ID_srand);
+	}
+
+	return !intercepts(id);
+}
+
+/*
+ * For each function, a stub which resolves the real function, points
+ * dispatch[] at it, and calls it. bind() installs these rather than resolving
+ * every function itself, so that functions are still resolved on first use;
+ * see GREAT_WRAP_REAL(). Threads racing through a stub all store the same
+ * address.
+ */
+#define DIRECT(name, ret, params, args, retkw, api) \
+	static ret \
+	direct_##name params \
+	{ \
+		__atomic_store_n(&dispatch[GREAT_ID_##name], \
+			(void (*)(void)) GREAT_WRAP_REAL(great_real, name), \
+			__ATOMIC_RELEASE); \
+		retkw GREAT_WRAP_REAL(great_real, name) args; \
+	}
+GREAT_FUNCTIONS(DIRECT)
+#undef DIRECT
+
+/*
+ * Point dispatch[] at the real function for each function which would only
+ * pass through, by way of its stub above, so that a function outside of
+ * $GREAT_SUBSETS costs one indirect jump (and the store of its caller) more
+ * than it would without this library.
+ *
+ * This is done here, rather than by a GNU indirect function for each export,
+ * because the resolver for an indirect function may be called before this
+ * library has been relocated, and so before the environment may be read.
+ */
+static void
+bind(void)
+{
+	unsigned int n;
+
+	n = 0;
+
+#define BIND(name, ret, params, args, retkw, api) \
+	if (passthrough(GREAT_ID_##name)) { \
+		__atomic_store_n(&dispatch[GREAT_ID_##name], \
+			(void (*)(void)) direct_##name, __ATOMIC_RELEASE); \
+		n++; \
+	}
+	GREAT_FUNCTIONS(BIND)
+#undef BIND
+
+	great_log(GREAT_LOG_INFO, "GREAT_SUBSETS",
+		"%u of %u functions pass through directly", n, (unsigned int) GREAT_COUNT);
+}
+
+GREAT_WRAP_VISIBLE void
+_init(void) {
+	/* Functions are resolved on first use; see GREAT_WRAP_REAL() */
+
+	great_subset_disable();
+
+	great_c99_setup();
+
+	/* Each section names its standard; see api/<api>/wrap.h */
+	great_log_init("libgreat", NULL);
+	great_random_init(NULL);
+	great_subset_init();
+	select_apis();
+	great_alloc_init();
+
+	great_subset_enable();
+
+	bind();
+}
+
+GREAT_WRAP_VISIBLE void
+_fini(void) {
+	great_subset_disable();
+
+	great_alloc_fini();
+
+	great_subset_enable();
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * The unified library.
+ *
+ * $Id$
+ *
+ * libgreat.so provides the wrappers of every API (see api/<api>/wrap.h) with
+ * a single runtime: one reading of the environment, one PRNG, one set of
+ * subsets, one log and one list of real functions. The APIs' sources are each
+ * compiled with GREAT_WRAP_UNIFIED, which names their wrappers
+ * great_<api>_wrap_<name> rather than exporting them.
+ *
+ * Each function here is exported once, and calls the wrapper of whichever API
+ * is selected for it by $GREAT_APIS: a list of API names, delimited by any
+ * punctuation or spaces, defaulting to "c99,bsd42,bsd44". Where more than one
+ * API selected wraps a function (malloc() is in both C89 and C99), the first
+ * listed takes it. The wrappers of APIs which are not selected pass through
+ * to the real functions, as if outside of $GREAT_SUBSETS. (The GNU API is not
+ * selected by default, but its wrapper for pthread_setname_np() still notes
+ * threads renamed for $GREAT_THREADS.)
+ *
+ * Once the environment has been read, each function whose wrapper would only
+ * pass through is bound directly to the real function instead (resolved on
+ * its first call), and so costs no more than one indirect jump and the store
+ * of its caller.
+ */
+
+#ifndef GREAT_UNIFIED_WRAP_H
+#define GREAT_UNIFIED_WRAP_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/*
+ * Every function wrapped by any API, once each, one per line: the function's
+ * name, return type, parameter list and the parameters' names, "return" if
+ * the function returns a value, and the API whose wrapper is called until
+ * $GREAT_APIS has been read.
+ */
+#define GREAT_FUNCTIONS(X) \
+	X(isalnum,  int, (int c), (c), return, c99) \
+	X(isalpha,  int, (int c), (c), return, c99) \
+	X(isblank,  int, (int c), (c), return, c99) \
+	X(iscntrl,  int, (int c), (c), return, c99) \
+	X(isdigit,  int, (int c), (c), return, c99) \
+	X(isgraph,  int, (int c), (c), return, c99) \
+	X(islower,  int, (int c), (c), return, c99) \
+	X(isprint,  int, (int c), (c), return, c99) \
+	X(ispunct,  int, (int c), (c), return, c99) \
+	X(isspace,  int, (int c), (c), return, c99) \
+	X(isupper,  int, (int c), (c), return, c99) \
+	X(isxdigit, int, (int c), (c), return, c99) \
+	\
+	X(fopen, FILE *, (const char * restrict filename, \
+		const char * restrict mode), (filename, mode), return, c99) \
+	\
+	X(rand,  int,  (void),              (),     return, c99) \
+	X(srand, void, (unsigned int seed), (seed),       , c99) \
+	\
+	X(free,    void,   (void *ptr),              (ptr),       , c99) \
+	X(malloc,  void *, (size_t size),            (size),      return, c99) \
+	X(realloc, void *, (void *ptr, size_t size), (ptr, size), return, c99) \
+	\
+	X(gettimeofday, int, (struct timeval * restrict tp, \
+		void * restrict tzp), (tp, tzp), return, bsd42) \
+	\
+	X(strdup, char *, (const char *str), (str), return, bsd44) \
+	\
+	X(pthread_setname_np, int, (pthread_t thread, const char *name), \
+		(thread, name), return, gnu)
+
+/*
+ * A dense ID for each function, GREAT_ID_<name>.
+ */
+enum great_function {
+#define GREAT_ID(name, ret, params, args, retkw, api) GREAT_ID_##name,
+	GREAT_FUNCTIONS(GREAT_ID)
+#undef GREAT_ID
+	GREAT_COUNT
+};
+
+/*
+ * The real functions, shared by every API and resolved on first use; see
+ * GREAT_WRAP_REAL().
+ */
+struct great_real {
+#define GREAT_MEMBER(name, ret, params, args, retkw, api) ret (*name) params;
+	GREAT_FUNCTIONS(GREAT_MEMBER)
+#undef GREAT_MEMBER
+};
+
+extern struct great_real great_real;
+
+extern void
+_init(void);
+
+extern void
+_fini(void);
+
+#endif
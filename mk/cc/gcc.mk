@@ -7,6 +7,28 @@
 CFLAGS +=
 SFLAGS += -fPIC
 
+# Libraries export only the functions they wrap (see mk/lib.mk); everything
+# else is hidden, so that calls within a library bind directly rather than by
+# way of the PLT, and may be inlined across objects by link-time optimisation.
+# Objects carry regular code too, for the static libraries (mk/static.mk) and
+# for linking the tests without LTO. Once a library is large enough to be
+# split into partitions, -flto=auto compiles them in parallel, rather than in
+# series with a warning.
+SFLAGS += -fvisibility=hidden -fno-semantic-interposition
+SFLAGS += -flto=auto -ffat-lto-objects
+
+# The libraries are preloaded, and so their thread-local variables may be
+# reached directly, rather than by way of __tls_get_addr().
+SFLAGS += -ftls-model=initial-exec
+
+# Profile-guided optimisation, for the libraries only; see mk/pgo.mk.
+SFLAGS += $(PGOFLAGS)
+
+# Link libraries by way of the compiler, for link-time optimisation. There
+# are no start files, since each library gives its own _init and _fini.
+LDSHARED = $(CC) $(CFLAGS) $(SFLAGS) -shared -nostartfiles
+LDVERSION = -Wl,--version-script=
+
 # Partial makefile example with majority of gcc warnings
 #
 # Only a few of the code generation, optimization or architecture options
@@ -1,15 +1,31 @@
 # Compile a dynamic library.
 #
+# Only the functions given by the API's table of wrapped functions (named by
+# $(FUNCTIONS); see api/c99/wrap.h) are exported, by way of a version script,
+# together with _init and _fini. libshared is given again after libport, whose
+# great_wrap_resolve() uses the bootstrap arena.
+#
 # $Id$
 
 CFLAGS += -I $(SRC) $(SFLAGS)
 LDFLAGS += -L $(SRC)/shared -L $(SRC)
 
-CLEAN += $(LIB).so
+LDSHARED ?= ld -shared --eh-frame-hdr
+LDVERSION ?= --version-script=
+
+CLEAN += $(LIB).so $(LIB).ver
 
 all: $(LIB).so $(LIB).a
 
-$(LIB).so: $(TARGETS)
-	ld -o $@ -shared $(TARGETS) \
-		$(LDFLAGS) -lshared -lport
+$(LIB).so: $(TARGETS) $(LIB).ver
+	$(LDSHARED) -o $@ $(TARGETS) \
+		$(LDFLAGS) -lshared -lport -lshared $(LDVERSION)$(LIB).ver
 
+$(LIB).ver: wrap.h
+	( echo '{'; echo 'global:'; echo '	_init;'; echo '	_fini;'; \
+	  echo '$(FUNCTIONS)(GREAT_WRAP_SYMBOL)' \
+		| $(CC) $(CFLAGS) -include wrap.h \
+			-D'GREAT_WRAP_SYMBOL(name, ...)=GREAT_WRAP_SYMBOL=name;' \
+			-E -P - \
+		| tr ' ' '\n' | sed -n 's/^GREAT_WRAP_SYMBOL=/	/p'; \
+	  echo 'local:'; echo '	*;'; echo '};' ) > $@
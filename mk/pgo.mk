@@ -0,0 +1,68 @@
+# Profile-guided optimisation.
+#
+# "make pgo" builds the libraries as usual, and measures the overhead per call
+# of the unified library's wrappers by running test/workload both with and
+# without it preloaded. The libraries are then rebuilt instrumented, trained by
+# the workload, and rebuilt again from the profile gathered, and the overhead
+# is measured once more. Profiles are kept in $(PGODIR).
+#
+# Training runs the workload both with every call passing through ($GREAT_SUBSETS
+# empty) and with every call considered for interception but not intercepted
+# ($GREAT_PROBABILITY=0), so that the paths which intercept are laid out as
+# cold. This needs GCC.
+#
+# $Id$
+
+PGODIR = $(CURDIR)/pgo.d
+PGOLIB = $(CURDIR)/api/unified/libgreat.so
+PGOWORK = $(CURDIR)/test/workload
+
+# Iterations for the workload when passing through, and when considering
+# interception (which is far slower, reading the environment and logging)
+PGOPASS = 10000
+PGOMATCH = 100
+
+PGOENV = GREAT_LOG=/dev/null LD_PRELOAD=$(PGOLIB)
+
+pgo:
+	rm -rf $(PGODIR)
+	mkdir -p $(PGODIR)
+	$(MAKE) clean
+	$(MAKE)
+	$(MAKE) pgo-measure PGOSTAGE=before
+	$(MAKE) clean
+	$(MAKE) PGOFLAGS='-fprofile-generate=$(PGODIR)'
+	GREAT_SUBSETS= $(PGOENV) $(PGOWORK) $(PGOPASS) > /dev/null
+	GREAT_PROBABILITY=0 $(PGOENV) $(PGOWORK) $(PGOMATCH) > /dev/null
+	$(MAKE) clean
+	$(MAKE) PGOFLAGS='-fprofile-use=$(PGODIR) -Wno-missing-profile'
+	$(MAKE) pgo-measure PGOSTAGE=after
+	@$(MAKE) -s pgo-report
+
+pgo-measure:
+	$(PGOWORK) $(PGOPASS) > $(PGODIR)/$(PGOSTAGE).none
+	GREAT_SUBSETS= $(PGOENV) $(PGOWORK) $(PGOPASS) \
+		> $(PGODIR)/$(PGOSTAGE).pass
+	$(PGOWORK) $(PGOMATCH) > $(PGODIR)/$(PGOSTAGE).nonematch
+	GREAT_PROBABILITY=0 $(PGOENV) $(PGOWORK) $(PGOMATCH) \
+		> $(PGODIR)/$(PGOSTAGE).match
+
+# Overhead is the time per call with the library, less that without
+pgo-report:
+	cd $(PGODIR) && awk ' \
+		{ t[FILENAME, $$1] = $$2 } \
+		FNR == NR { name[NR] = $$1; n = NR } \
+		END { \
+			print "Overhead per call (ns):"; \
+			printf "%-8s %20s %20s\n", "", "passing through", "not intercepting"; \
+			printf "%-8s %10s%10s %10s%10s\n", "", "before", "after", "before", "after"; \
+			for (i = 1; i <= n; i++) { \
+				f = name[i]; \
+				printf "%-8s %10.1f%10.1f %10.1f%10.1f\n", f, \
+					t["before.pass", f] - t["before.none", f], \
+					t["after.pass", f] - t["after.none", f], \
+					t["before.match", f] - t["before.nonematch", f], \
+					t["after.match", f] - t["after.nonematch", f]; \
+			} \
+		}' before.none before.pass before.nonematch before.match \
+			after.none after.pass after.nonematch after.match
@@ -0,0 +1,35 @@
+# Compile a static library for link-time interposition.
+#
+# The API's sources are compiled again with GREAT_WRAP_STATIC (see
+# src/wrap.h), and archived together with libshared and libport, so that a
+# program may be linked against the one library. $(LIB)_static.wrap gives
+# the options for ld to wrap each function, for use along the lines of:
+#
+#	cc -static -o prog prog.o -Wl,@$(LIB)_static.wrap $(LIB)_static.a
+#
+# $Id$
+
+STATIC_TARGETS = $(TARGETS:.o=_static.o)
+
+CLEAN += $(STATIC_TARGETS) $(LIB)_static.a $(LIB)_static.wrap
+
+all: $(LIB)_static.a $(LIB)_static.wrap
+
+%_static.o: %.c
+	$(CC) $(CFLAGS) -DGREAT_WRAP_STATIC -c -o $@ $<
+
+$(LIB)_static.a: $(STATIC_TARGETS)
+	rm -f $@
+	( echo CREATE $@; \
+	  for o in $(STATIC_TARGETS); do echo ADDMOD $$o; done; \
+	  echo ADDLIB $(SRC)/shared/libshared.a; \
+	  echo ADDLIB $(SRC)/libport.a; \
+	  echo SAVE; echo END ) | ar -M
+	ranlib $@
+
+$(LIB)_static.wrap: wrap.h
+	echo '$(FUNCTIONS)(GREAT_WRAP_OPTION)' \
+		| $(CC) $(CFLAGS) -include wrap.h \
+			-D'GREAT_WRAP_OPTION(name, ret, params, path, section)=--wrap=name' \
+			-E -P - \
+		| tr ' ' '\n' | grep '^--wrap=' > $@
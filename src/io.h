@@ -39,6 +39,7 @@
 
 #include <stdio.h>
 #include <stddef.h>
+#include <stdbool.h>
 
 /*
  * Write output to a given file stream. Exactly len bytes of output are read
@@ -47,5 +48,36 @@
 void
 great_write(FILE *fp, const char *s, size_t len);
 
+/*
+ * Open a file for writing, creating it if need be, and truncating it
+ * otherwise. Returns a file descriptor, or -1 on error.
+ *
+ * This is provided so that output may be written without stdio, which may
+ * call the functions we wrap.
+ */
+int
+great_open(const char *path);
+
+/*
+ * Write exactly len bytes from s to the given file descriptor. Returns false
+ * on error.
+ */
+bool
+great_writefd(int fd, const void *s, size_t len);
+
+/*
+ * Close a file descriptor given by great_open().
+ */
+void
+great_close(int fd);
+
+/*
+ * Write a description of the process's memory mappings to the given file
+ * descriptor, in the format of Linux's /proc/self/maps. Nothing is written if
+ * this is not available.
+ */
+void
+great_maps(int fd);
+
 #endif
 
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory mapping interfaces.
+ *
+ * These provide memory for internal use which does not come from malloc(), so
+ * that it may be obtained from within our own wrappers for the memory
+ * management functions without recursing into them.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_PORT_MAP_H
+#define GREAT_PORT_MAP_H
+
+#include <stddef.h>
+
+/*
+ * Map len bytes of zero-filled memory, readable and writable. Returns NULL on
+ * error.
+ */
+void *
+great_map(size_t len);
+
+/*
+ * Map len bytes of the file at path, readable and writable, and shared with
+ * every other process mapping it. The file is created if it does not exist,
+ * and is extended with zeroes to len bytes if it is shorter. Returns NULL on
+ * error.
+ */
+void *
+great_map_file(const char *path, size_t len);
+
+/*
+ * Map the whole of the file at path, read only, giving its length in *len.
+ * Returns NULL on error, including for an empty file.
+ */
+const void *
+great_map_read(const char *path, size_t *len);
+
+/*
+ * Unmap memory previously given by great_map() or great_map_file(). The length must be as given
+ * when it was mapped.
+ */
+void
+great_unmap(void *p, size_t len);
+
+/*
+ * Return the number of bytes usable in a block given by the system's malloc(),
+ * which may exceed the size requested. If this is not known, 0 is returned.
+ */
+size_t
+great_usable_size(void *p);
+
+#endif
+
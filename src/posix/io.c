@@ -38,8 +38,11 @@
 #define _POSIX_C_SOURCE 199506L
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <errno.h>
 #include <assert.h>
 
 #include "../io.h"
@@ -55,3 +58,69 @@ great_write(FILE *fp, const char *s, size_t len)
 	/* TODO disable subsets? */
 }
 
+
+int
+great_open(const char *path)
+{
+	assert(path);
+
+	return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+}
+
+bool
+great_writefd(int fd, const void *s, size_t len)
+{
+	const char *p = s;
+
+	assert(fd != -1);
+	assert(s);
+
+	while (len > 0) {
+		ssize_t n;
+
+		n = write(fd, p, len);
+		if (-1 == n && EINTR == errno) {
+			continue;
+		}
+
+		if (n <= 0) {
+			return false;
+		}
+
+		p   += n;
+		len -= n;
+	}
+
+	return true;
+}
+
+void
+great_close(int fd)
+{
+	assert(fd != -1);
+
+	close(fd);
+}
+
+void
+great_maps(int fd)
+{
+	char buf[4096];
+	ssize_t n;
+	int mfd;
+
+	assert(fd != -1);
+
+	mfd = open("/proc/self/maps", O_RDONLY);
+	if (-1 == mfd) {
+		return;
+	}
+
+	while ((n = read(mfd, buf, sizeof buf)) > 0) {
+		if (!great_writefd(fd, buf, n)) {
+			break;
+		}
+	}
+
+	close(mfd);
+}
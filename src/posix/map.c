@@ -0,0 +1,162 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory mapping interfaces.
+ *
+ * $Id$
+ */
+
+/* Required for MAP_ANONYMOUS and malloc_usable_size() on GNU systems */
+#define _GNU_SOURCE
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../map.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+void *
+great_map(size_t len)
+{
+	void *p;
+
+	assert(len > 0);
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (MAP_FAILED == p) {
+		return NULL;
+	}
+
+	return p;
+}
+
+void *
+great_map_file(const char *path, size_t len)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	assert(path);
+	assert(len > 0);
+
+	fd = open(path, O_RDWR | O_CREAT, 0600);
+	if (-1 == fd) {
+		return NULL;
+	}
+
+	/* Whoever finds the file short extends it; they all agree on len */
+	if (-1 == fstat(fd, &st)
+	|| ((size_t) st.st_size < len && -1 == ftruncate(fd, (off_t) len))) {
+		close(fd);
+		return NULL;
+	}
+
+	p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+	/* The mapping keeps the file open */
+	close(fd);
+
+	if (MAP_FAILED == p) {
+		return NULL;
+	}
+
+	return p;
+}
+
+const void *
+great_map_read(const char *path, size_t *len)
+{
+	struct stat st;
+	void *p;
+	int fd;
+
+	assert(path);
+	assert(len);
+
+	fd = open(path, O_RDONLY);
+	if (-1 == fd) {
+		return NULL;
+	}
+
+	if (-1 == fstat(fd, &st) || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+
+	if (MAP_FAILED == p) {
+		return NULL;
+	}
+
+	*len = (size_t) st.st_size;
+
+	return p;
+}
+
+void
+great_unmap(void *p, size_t len)
+{
+	assert(p);
+
+	munmap(p, len);
+}
+
+size_t
+great_usable_size(void *p)
+{
+	if (!p) {
+		return 0;
+	}
+
+#ifdef __GLIBC__
+	return malloc_usable_size(p);
+#else
+	return 0;
+#endif
+}
+
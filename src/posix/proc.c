@@ -0,0 +1,274 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Process interfaces.
+ *
+ * $Id$
+ */
+
+/* Required for sigaction(), SA_RESTART and dladdr() on GNU systems */
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <assert.h>
+
+#ifdef __GLIBC__
+#include <execinfo.h>
+#include <link.h>
+#endif
+
+#include "../proc.h"
+
+unsigned long
+great_pid(void)
+{
+	pid_t pid;
+
+	pid = getpid();
+
+	return (unsigned long) pid;
+}
+
+bool
+great_signal(int sig, void (*f)(int sig))
+{
+	struct sigaction sa;
+
+	assert(f);
+
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = f;
+	sa.sa_flags = SA_RESTART;
+	sigemptyset(&sa.sa_mask);
+
+	return 0 == sigaction(sig, &sa, NULL);
+}
+
+/*
+ * pthread_atfork() identifies its caller's object by __dso_handle, which is
+ * defined by the C runtime's start files. The libraries are linked without
+ * them (see mk/lib.mk), so a definition is given here for that case; where the
+ * start files are present, theirs takes precedence.
+ */
+#ifdef __GNUC__
+__attribute__((weak, visibility("hidden"))) void *__dso_handle = &__dso_handle;
+#endif
+
+bool
+great_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void))
+{
+	return 0 == pthread_atfork(prepare, parent, child);
+}
+
+size_t
+great_backtrace(void **pc, size_t n, size_t skip)
+{
+#ifdef __GLIBC__
+	void *buf[64 + 8];
+	int depth;
+	size_t i;
+
+	assert(pc);
+
+	/* +1 for our own frame */
+	skip++;
+
+	if (n + skip > sizeof buf / sizeof *buf) {
+		n = sizeof buf / sizeof *buf - skip;
+	}
+
+	depth = backtrace(buf, n + skip);
+	if (depth < 0 || (size_t) depth <= skip) {
+		return 0;
+	}
+
+	for (i = 0; i + skip < (size_t) depth; i++) {
+		pc[i] = buf[i + skip];
+	}
+
+	return i;
+#else
+	(void) pc;
+	(void) n;
+	(void) skip;
+
+	return 0;
+#endif
+}
+
+
+bool
+great_symbol(const void *pc, const char **object, const char **symbol,
+	unsigned long *offset)
+{
+	Dl_info info;
+
+	assert(object);
+	assert(symbol);
+	assert(offset);
+
+	if (0 == dladdr(pc, &info) || !info.dli_fname) {
+		return false;
+	}
+
+	*object = info.dli_fname;
+
+	if (info.dli_sname && info.dli_saddr) {
+		*symbol = info.dli_sname;
+		*offset = (unsigned long) ((const char *) pc
+			- (const char *) info.dli_saddr);
+	} else {
+		*symbol = NULL;
+		*offset = (unsigned long) ((const char *) pc
+			- (const char *) info.dli_fbase);
+	}
+
+	return true;
+}
+
+bool
+great_object(const void *pc, const char **object, unsigned long *offset)
+{
+	Dl_info info;
+
+	assert(object);
+	assert(offset);
+
+	if (0 == dladdr(pc, &info) || !info.dli_fname) {
+		return false;
+	}
+
+	*object = info.dli_fname;
+	*offset = (unsigned long) ((const char *) pc
+		- (const char *) info.dli_fbase);
+
+	return true;
+}
+
+
+#ifdef __GLIBC__
+struct segments {
+	void (*f)(void *opaque, const char *object, uintptr_t lo, uintptr_t hi);
+	void *opaque;
+	unsigned long count;
+};
+
+/*
+ * The path of the main program's executable, which dl_iterate_phdr() gives
+ * as "". This is found once, since the program does not change.
+ */
+static const char *
+self(void)
+{
+	static char path[4096];
+	ssize_t n;
+
+	if (path[0] != '\0') {
+		return path;
+	}
+
+	n = readlink("/proc/self/exe", path, sizeof path - 1);
+	if (n <= 0) {
+		return "";
+	}
+
+	path[n] = '\0';
+
+	return path;
+}
+
+static int
+segment(struct dl_phdr_info *info, size_t size, void *p)
+{
+	struct segments *s = p;
+	const char *object;
+	ElfW(Half) i;
+
+	assert(info);
+	assert(s);
+
+	s->count = info->dlpi_adds + info->dlpi_subs;
+
+	if (!s->f) {
+		return 1;
+	}
+
+	(void) size;
+
+	object = info->dlpi_name && info->dlpi_name[0] != '\0'
+		? info->dlpi_name : self();
+
+	for (i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *ph = &info->dlpi_phdr[i];
+		uintptr_t lo;
+
+		if (ph->p_type != PT_LOAD || !(ph->p_flags & PF_X)) {
+			continue;
+		}
+
+		lo = (uintptr_t) (info->dlpi_addr + ph->p_vaddr);
+		s->f(s->opaque, object, lo, lo + ph->p_memsz);
+	}
+
+	return 0;
+}
+#endif
+
+unsigned long
+great_segments(void (*f)(void *opaque, const char *object, uintptr_t lo,
+	uintptr_t hi), void *opaque)
+{
+#ifdef __GLIBC__
+	struct segments s;
+
+	s.f      = f;
+	s.opaque = opaque;
+	s.count  = 0;
+
+	(void) dl_iterate_phdr(segment, &s);
+
+	/* Never 0, which is kept for unsupported */
+	return s.count + 1;
+#else
+	(void) f;
+	(void) opaque;
+
+	return 0;
+#endif
+}
@@ -70,15 +70,20 @@ great_re_comp(const char *rs, int *err)
 
 	new = malloc(sizeof *new);
 	if (!new) {
-		return NULL;
+		e = REG_ESPACE;
+	} else {
+		e = regcomp(&new->preg, rs, REG_EXTENDED | REG_NOSUB);
 	}
 
-	e = regcomp(&new->preg, rs, REG_EXTENDED | REG_NOSUB);
-
 	if (err) {
 		*err = e;
 	}
 
+	if (e != 0) {
+		free(new);
+		return NULL;
+	}
+
 	return new;
 }
 
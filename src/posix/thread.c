@@ -0,0 +1,108 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Thread interfaces.
+ *
+ * $Id$
+ */
+
+/* Required for pthread_key_create() and pthread_getname_np() on GNU systems */
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "../thread.h"
+
+static pthread_key_t key;
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static bool haskey;
+
+static void (*atexitf)(void *p);
+
+static void
+destructor(void *p)
+{
+	assert(atexitf);
+
+	atexitf(p);
+}
+
+static void
+makekey(void)
+{
+	haskey = 0 == pthread_key_create(&key, destructor);
+}
+
+unsigned long
+great_thread_id(void)
+{
+	pthread_t t;
+
+	/* pthread_t is opaque; this is only used for display */
+	t = pthread_self();
+
+	return (unsigned long) (uintptr_t) t;
+}
+
+bool
+great_thread_name(char *buf, size_t len)
+{
+	assert(buf);
+	assert(len > 0);
+
+#ifdef __GLIBC__
+	return 0 == pthread_getname_np(pthread_self(), buf, len);
+#else
+	buf[0] = '\0';
+	return false;
+#endif
+}
+
+bool
+great_thread_atexit(void (*f)(void *p), void *p)
+{
+	assert(f);
+	assert(!atexitf || atexitf == f);
+
+	atexitf = f;
+
+	pthread_once(&once, makekey);
+	if (!haskey) {
+		return false;
+	}
+
+	return 0 == pthread_setspecific(key, p);
+}
+
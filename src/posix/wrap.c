@@ -38,38 +38,47 @@
 #define _GNU_SOURCE
 
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 #include <assert.h>
 
 #include "../wrap.h"
 #include "../shared/log.h"
+#include "../shared/bootstrap.h"
 
 void (*
 great_wrap_resolve(const char *functionname))(void)
 {
-	void (**f)(void);
+	void (*f)(void);
+	void *p;
 
 	assert(functionname);
 
 	/*
 	 * POSIX guarantees that a function pointer is expressible by void *.
-	 * Rather than conform to this assumption (which makes GCC unhappy, and
-	 * understandably so), this is avoided by resolving a pointer to a pointer
-	 * to a function, and then dereferencing that.
+	 * Rather than conform to this assumption by way of a cast (which makes
+	 * GCC unhappy, and understandably so), the representation of the pointer
+	 * returned by dlsym() is copied into a function pointer object.
 	 *
-	 * This works because the value of a function is its address (hence
-	 * dereferencing a pointer to a function gives the address of the function
-	 * again). C defines that any function pointer may express the address of
-	 * any other function pointer, hence for void (**f)(void), *f becomes our
-	 * equivalent to void *.
+	 * Note that dlsym() gives the address of the function itself, and not the
+	 * address of a pointer to it; that must not be dereferenced.
 	 */
 
-	f = dlsym(RTLD_NEXT, functionname);
-	if(!f) {
+	/*
+	 * dlsym() may itself allocate, possibly by way of the very function being
+	 * resolved; such allocations are served from the bootstrap arena instead.
+	 */
+	great_bootstrap_begin();
+	p = dlsym(RTLD_NEXT, functionname);
+	great_bootstrap_end();
+
+	if(!p) {
 		great_log(GREAT_LOG_ERROR, "wrap", "dlsym: %s", dlerror());
 		abort();
 	}
 
-	return *f;
-}
+	assert(sizeof f == sizeof p);
+	memcpy(&f, &p, sizeof f);
 
+	return f;
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Process interfaces.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_PORT_PROC_H
+#define GREAT_PORT_PROC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Return the process ID of the calling process.
+ */
+unsigned long
+great_pid(void);
+
+/*
+ * Install f as the handler for the given signal number. The handler is called
+ * asynchronously, and so may only do that which is async-signal-safe.
+ *
+ * Returns false on error.
+ */
+bool
+great_signal(int sig, void (*f)(int sig));
+
+/*
+ * Arrange for prepare() to be called in the calling thread before each
+ * fork(), and for parent() and child() to be called after it in the parent
+ * and child respectively. Any of these may be NULL. Handlers registered later
+ * are prepared first, and are called last after fork().
+ *
+ * Only the thread which called fork() exists in the child, and so child()
+ * may not wait for anything held by other threads at the time of the fork.
+ *
+ * Returns false on error.
+ */
+bool
+great_atfork(void (*prepare)(void), void (*parent)(void), void (*child)(void));
+
+/*
+ * Fill pc[] with up to n return addresses for the calling thread's stack,
+ * innermost first, omitting the first skip frames (not including the frame
+ * for great_backtrace() itself). Returns the number of addresses given, which
+ * may be 0 if this is not supported.
+ *
+ * The first call may allocate memory; callers wrapping malloc() are expected
+ * to make a call during initialisation for that reason.
+ */
+size_t
+great_backtrace(void **pc, size_t n, size_t skip);
+
+/*
+ * Find the object containing the code address pc, and the nearest symbol at
+ * or before it. The object's path is given by *object, and *symbol gives the
+ * symbol name, or NULL if there is none, in which case *offset is from the
+ * start of the object rather than from the symbol. Strings given remain valid
+ * until the object is unloaded.
+ *
+ * Returns false if no object is known to contain pc.
+ */
+bool
+great_symbol(const void *pc, const char **object, const char **symbol,
+	unsigned long *offset);
+
+/*
+ * Find the object containing the code address pc. The object's path is given
+ * by *object, and *offset gives pc's offset from the start of the object. This
+ * needs no symbols, and so serves for static functions and for programs linked
+ * without -rdynamic. The string given remains valid until the object is
+ * unloaded.
+ *
+ * Returns false if no object is known to contain pc.
+ */
+bool
+great_object(const void *pc, const char **object, unsigned long *offset);
+
+/*
+ * Call f(opaque, object, lo, hi) once for each executable segment of each
+ * object loaded, giving the object's path and the segment's address range from
+ * lo up to but excluding hi. The main program is given by the path of its
+ * executable, where that may be found. f may be NULL, in which case no
+ * segments are given.
+ *
+ * Returns a count which changes whenever objects are loaded or unloaded, for
+ * finding cheaply whether segments previously given are current, or 0 if this
+ * is not supported. This may take a lock within the dynamic linker, and so is
+ * not to be called for every call made to a wrapper.
+ */
+unsigned long
+great_segments(void (*f)(void *opaque, const char *object, uintptr_t lo,
+	uintptr_t hi), void *opaque);
+
+#endif
+
@@ -0,0 +1,238 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation observation.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "alloc.h"
+#include "allocstats.h"
+#include "heapprof.h"
+#include "live.h"
+#include "lifetime.h"
+#include "memlimit.h"
+#include "trace.h"
+#include "context.h"
+
+bool great_alloc_enabled;
+
+void
+great_alloc_init(void)
+{
+	great_context_init();
+
+	great_allocstats_init();
+	great_heapprof_init();
+	great_live_init();
+	great_lifetime_init();
+	great_memlimit_init();
+	great_trace_init();
+
+	/* memlimit.c must know which blocks it has counted */
+	if (great_memlimit_enabled) {
+		great_live_track();
+	}
+
+	great_alloc_enabled = great_allocstats_enabled
+		|| great_heapprof_enabled
+		|| great_live_enabled
+		|| great_lifetime_enabled
+		|| great_memlimit_enabled
+		|| great_trace_enabled;
+}
+
+void
+great_alloc_fini(void)
+{
+	if (great_allocstats_enabled) {
+		great_allocstats_report();
+	}
+
+	if (great_heapprof_enabled) {
+		great_heapprof_report();
+	}
+
+	if (great_live_enabled) {
+		great_live_report();
+	}
+
+	if (great_lifetime_enabled) {
+		great_lifetime_report();
+	}
+
+	if (great_trace_enabled) {
+		great_trace_fini();
+	}
+}
+
+void
+great_alloc_malloc(size_t size, void *p, const void *caller)
+{
+	struct great_context *ctx;
+	bool added;
+
+	ctx = great_context();
+
+	/* These must not miss a block, and so do without a context */
+	added = false;
+	if (great_live_enabled) {
+		added = great_live_malloc(ctx, size, p, caller);
+	}
+
+	if (great_memlimit_enabled && added) {
+		great_memlimit_malloc(ctx, p);
+	}
+
+	if (!ctx) {
+		return;
+	}
+
+	if (great_allocstats_enabled) {
+		great_allocstats_malloc(ctx, size, p);
+	}
+
+	if (great_heapprof_enabled) {
+		great_heapprof_malloc(ctx, size, p, caller);
+	}
+
+	if (great_lifetime_enabled) {
+		great_lifetime_malloc(ctx, size, p);
+	}
+
+	if (great_trace_enabled) {
+		great_trace_malloc(ctx, size, p);
+	}
+}
+
+void
+great_alloc_realloc(void *ptr, size_t oldsize, size_t size, void *p,
+	const void *caller)
+{
+	struct great_context *ctx;
+	bool freed, added;
+
+	ctx = great_context();
+
+	/*
+	 * A successful realloc() frees ptr, as does realloc(ptr, 0); on failure,
+	 * ptr is left as it was. Frees need no context, and must not be missed.
+	 */
+	freed = false;
+	if (ptr && (p || size == 0)) {
+		if (great_live_enabled) {
+			freed = great_live_free(ctx, ptr);
+		}
+
+		if (great_heapprof_enabled) {
+			great_heapprof_free(ptr);
+		}
+
+		if (great_lifetime_enabled) {
+			great_lifetime_free(ctx, ptr);
+		}
+	}
+
+	added = false;
+	if (great_live_enabled) {
+		added = great_live_malloc(ctx, size, p, caller);
+	}
+
+	if (great_memlimit_enabled) {
+		great_memlimit_realloc(ctx, freed ? oldsize : 0, added ? p : NULL);
+	}
+
+	if (!ctx) {
+		return;
+	}
+
+	if (great_allocstats_enabled) {
+		great_allocstats_realloc(ctx, ptr ? oldsize : 0, size, p);
+	}
+
+	if (great_heapprof_enabled) {
+		great_heapprof_malloc(ctx, size, p, caller);
+	}
+
+	if (great_lifetime_enabled) {
+		great_lifetime_malloc(ctx, size, p);
+	}
+
+	if (great_trace_enabled) {
+		great_trace_realloc(ctx, ptr, size, p);
+	}
+}
+
+void
+great_alloc_free(void *ptr)
+{
+	struct great_context *ctx;
+	bool known;
+
+	if (!ptr) {
+		return;
+	}
+
+	/* This needs no context, and must not miss a free */
+	if (great_heapprof_enabled) {
+		great_heapprof_free(ptr);
+	}
+
+	ctx = great_context();
+
+	known = false;
+	if (great_live_enabled) {
+		known = great_live_free(ctx, ptr);
+	}
+
+	if (great_lifetime_enabled) {
+		great_lifetime_free(ctx, ptr);
+	}
+
+	if (great_memlimit_enabled && known) {
+		great_memlimit_free(ctx, ptr);
+	}
+
+	if (!ctx) {
+		return;
+	}
+
+	if (great_allocstats_enabled) {
+		great_allocstats_free(ctx);
+	}
+
+	if (great_trace_enabled) {
+		great_trace_free(ctx, ptr);
+	}
+}
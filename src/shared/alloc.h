@@ -0,0 +1,94 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation observation.
+ *
+ * The memory management wrappers report each call to this interface once the
+ * call has completed, regardless of whether the call was intercepted or not.
+ * These reports are passed on to each facility which has been enabled for
+ * observing allocations (see allocstats.h, heapprof.h, live.h, lifetime.h,
+ * memlimit.h and trace.h).
+ *
+ * Observation is independent of $GREAT_SUBSETS, so that an application may be
+ * profiled with all interception disabled.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_ALLOC_H
+#define GREAT_SHARED_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * True if any facility observing allocations is enabled. The wrappers are
+ * expected to test this before calling the functions below, so that there is
+ * no cost for observation when it is not in use.
+ */
+extern bool great_alloc_enabled;
+
+/*
+ * Initialise each facility from the environment. This must be called before
+ * use, and ought to be called with subsets disabled.
+ */
+void
+great_alloc_init(void);
+
+/*
+ * Give reports for each facility. This is intended to be called at exit.
+ */
+void
+great_alloc_fini(void);
+
+/*
+ * A call to malloc() for size bytes from caller returned p.
+ */
+void
+great_alloc_malloc(size_t size, void *p, const void *caller);
+
+/*
+ * A call to realloc() for ptr and size bytes returned p. The usable size of
+ * the block at ptr before the call is given by oldsize, or 0 if this is not
+ * known. See great_usable_size().
+ */
+void
+great_alloc_realloc(void *ptr, size_t oldsize, size_t size, void *p,
+	const void *caller);
+
+/*
+ * A call to free() was made for ptr.
+ */
+void
+great_alloc_free(void *ptr);
+
+#endif
+
@@ -0,0 +1,322 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation workload characterisation.
+ *
+ * Counters are kept per thread in struct great_context, and so are updated
+ * without locking. They are only summed when reporting. Reports taken whilst
+ * other threads are still running may therefore be slightly inconsistent,
+ * which is of no consequence for a summary.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "allocstats.h"
+#include "context.h"
+#include "log.h"
+#include "../proc.h"
+
+bool great_allocstats_enabled;
+
+static bool perthread;
+
+static const char *growthnames[GREAT_ALLOCSTATS_GROWTHS] = {
+	"<= 1/4", "<= 1/2", "< 1", "= 1", "<= 5/4",
+	"<= 3/2", "<= 2", "<= 4", "<= 8", "> 8"
+};
+
+/*
+ * Return the power-of-two size class for a given size; see
+ * GREAT_ALLOCSTATS_SIZES.
+ */
+static unsigned int
+sizeclass(size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; size > 0; size >>= 1) {
+		n++;
+	}
+
+	assert(n < GREAT_ALLOCSTATS_SIZES);
+
+	return n;
+}
+
+/*
+ * Return the class of the ratio of new to old sizes, as named by growthnames[].
+ * Neither size may be zero.
+ */
+static unsigned int
+growthclass(uint64_t old, uint64_t new)
+{
+	assert(old > 0);
+	assert(new > 0);
+
+	if (new * 4 <= old) return 0;
+	if (new * 2 <= old) return 1;
+	if (new < old)      return 2;
+	if (new == old)     return 3;
+	if (new * 4 <= old * 5) return 4;
+	if (new * 2 <= old * 3) return 5;
+	if (new <= old * 2) return 6;
+	if (new <= old * 4) return 7;
+	if (new <= old * 8) return 8;
+
+	return 9;
+}
+
+/* The parent reports for what it did before the fork */
+static void
+child(void)
+{
+	struct great_context *ctx;
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		memset(&ctx->allocstats, 0, sizeof ctx->allocstats);
+	}
+}
+
+void
+great_allocstats_init(void)
+{
+	const char *s;
+
+	s = getenv("GREAT_ALLOC_STATS");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	great_allocstats_enabled = true;
+	perthread = 0 == strcmp(s, "thread");
+
+	(void) great_atfork(NULL, NULL, child);
+
+	great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+		"Counting allocations%s", perthread ? " per thread" : "");
+}
+
+void
+great_allocstats_malloc(struct great_context *ctx, size_t size, void *p)
+{
+	struct great_allocstats *st;
+
+	assert(ctx);
+
+	st = &ctx->allocstats;
+
+	st->malloc++;
+	st->size[sizeclass(size)]++;
+
+	if (!p && size > 0) {
+		st->failed++;
+	}
+}
+
+void
+great_allocstats_realloc(struct great_context *ctx, size_t oldsize,
+	size_t size, void *p)
+{
+	struct great_allocstats *st;
+
+	assert(ctx);
+
+	st = &ctx->allocstats;
+
+	st->realloc++;
+	st->size[sizeclass(size)]++;
+
+	if (!p && size > 0) {
+		st->failed++;
+		return;
+	}
+
+	if (oldsize > 0 && size > 0) {
+		st->growth[growthclass(oldsize, size)]++;
+	}
+}
+
+void
+great_allocstats_free(struct great_context *ctx)
+{
+	assert(ctx);
+
+	ctx->allocstats.free++;
+}
+
+static void
+sum(struct great_allocstats *total, const struct great_allocstats *st)
+{
+	size_t i;
+
+	assert(total);
+	assert(st);
+
+	total->malloc  += st->malloc;
+	total->realloc += st->realloc;
+	total->free    += st->free;
+	total->failed  += st->failed;
+
+	for (i = 0; i < GREAT_ALLOCSTATS_SIZES; i++) {
+		total->size[i] += st->size[i];
+	}
+
+	for (i = 0; i < GREAT_ALLOCSTATS_GROWTHS; i++) {
+		total->growth[i] += st->growth[i];
+	}
+}
+
+/*
+ * Log a summary for one set of counters. The elapsed time is in nanoseconds.
+ */
+static void
+summary(const char *who, const struct great_allocstats *st, uint64_t elapsed)
+{
+	uint64_t calls;
+	size_t i;
+
+	assert(who);
+	assert(st);
+
+	calls = st->malloc + st->realloc + st->free;
+
+	great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+		"%s: %lu malloc, %lu realloc, %lu free, %lu failed",
+		who, (unsigned long) st->malloc, (unsigned long) st->realloc,
+		(unsigned long) st->free, (unsigned long) st->failed);
+
+	if (st->malloc > 0) {
+		great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+			"%s: %lu%% free/malloc", who,
+			(unsigned long) (st->free * 100 / st->malloc));
+	}
+
+	if (elapsed > 0) {
+		great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+			"%s: %lu calls/s over %lu ms", who,
+			(unsigned long) (calls * 1000000000.0 / elapsed),
+			(unsigned long) (elapsed / 1000000));
+	}
+
+	for (i = 0; i < GREAT_ALLOCSTATS_SIZES; i++) {
+		if (0 == st->size[i]) {
+			continue;
+		}
+
+		if (0 == i) {
+			great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+				"%s: size 0: %lu", who, (unsigned long) st->size[i]);
+			continue;
+		}
+
+		great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+			"%s: size %lu-%lu: %lu", who,
+			(unsigned long) ((uint64_t) 1 << (i - 1)),
+			(unsigned long) (((uint64_t) 1 << (i - 1)) * 2 - 1),
+			(unsigned long) st->size[i]);
+	}
+
+	for (i = 0; i < GREAT_ALLOCSTATS_GROWTHS; i++) {
+		if (0 == st->growth[i]) {
+			continue;
+		}
+
+		great_log(GREAT_LOG_INFO, "GREAT_ALLOC_STATS",
+			"%s: realloc growth %s: %lu", who,
+			growthnames[i], (unsigned long) st->growth[i]);
+	}
+}
+
+/*
+ * great_log() provides no widths, so names including numbers are built here.
+ * The buffer given must have space for the hexadecimal digits of an unsigned
+ * long, and a terminating null.
+ */
+static void
+hex(char *buf, unsigned long u)
+{
+	char tmp[sizeof u * 2];
+	size_t n;
+
+	assert(buf);
+
+	n = 0;
+	do {
+		tmp[n++] = "0123456789abcdef"[u % 16];
+		u /= 16;
+	} while (u > 0);
+
+	while (n > 0) {
+		*buf++ = tmp[--n];
+	}
+
+	*buf = '\0';
+}
+
+void
+great_allocstats_report(void)
+{
+	struct great_allocstats total;
+	struct great_context *ctx;
+	uint64_t elapsed;
+
+	memset(&total, 0, sizeof total);
+	elapsed = 0;
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		uint64_t e;
+
+		e = great_context_elapsed(ctx);
+
+		sum(&total, &ctx->allocstats);
+		if (e > elapsed) {
+			elapsed = e;
+		}
+
+		if (perthread) {
+			char who[32] = "thread ";
+
+			hex(who + strlen(who), ctx->id);
+			summary(who, &ctx->allocstats, e);
+		}
+	}
+
+	/* the total rate is taken over the longest-running thread */
+	summary("total", &total, elapsed);
+}
+
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation workload characterisation.
+ *
+ * When $GREAT_ALLOC_STATS is set non-empty, calls to the memory management
+ * wrappers are counted per thread, and a summary is logged at exit. This is
+ * intended to inform the choice of pool and arena sizes without the need for
+ * a separate profiling run.
+ *
+ * The summary gives:
+ *
+ *  - Counts of calls to malloc(), realloc() and free(), and of requests which
+ *    returned a null pointer;
+ *  - The ratio of calls to free() against calls to malloc();
+ *  - The rate of calls per second for the time the threads were running;
+ *  - A histogram of requested sizes, by power of two;
+ *  - A histogram of the ratio of new to old sizes given to realloc().
+ *
+ * The old size for realloc() is as given by great_usable_size(), and so may
+ * exceed the size originally requested. Where this is not known, the growth
+ * ratio is not recorded.
+ *
+ * If $GREAT_ALLOC_STATS is "thread", the summary is also given per thread.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_ALLOCSTATS_H
+#define GREAT_SHARED_ALLOCSTATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Size classes are by power of two. Class 0 is for requests of 0 bytes, and
+ * class n is for requests from 2^(n-1) to 2^n - 1 bytes inclusive.
+ */
+#define GREAT_ALLOCSTATS_SIZES 65
+
+/*
+ * Growth classes for realloc(); see allocstats.c:growthclass() for their
+ * bounds.
+ */
+#define GREAT_ALLOCSTATS_GROWTHS 10
+
+struct great_context;
+
+/*
+ * Per-thread counters, kept in struct great_context. Consider these private.
+ */
+struct great_allocstats {
+	uint64_t malloc;
+	uint64_t realloc;
+	uint64_t free;
+	uint64_t failed;
+
+	uint64_t size[GREAT_ALLOCSTATS_SIZES];
+	uint64_t growth[GREAT_ALLOCSTATS_GROWTHS];
+};
+
+extern bool great_allocstats_enabled;
+
+/*
+ * Initialise from $GREAT_ALLOC_STATS. This must be called before use.
+ */
+void
+great_allocstats_init(void);
+
+/*
+ * Record a call to malloc() for size bytes, which returned p.
+ */
+void
+great_allocstats_malloc(struct great_context *ctx, size_t size, void *p);
+
+/*
+ * Record a call to realloc() for size bytes, which returned p. The previous
+ * usable size of the block is given by oldsize, or 0 if this is not known.
+ */
+void
+great_allocstats_realloc(struct great_context *ctx, size_t oldsize,
+	size_t size, void *p);
+
+/*
+ * Record a call to free() for a non-null pointer.
+ */
+void
+great_allocstats_free(struct great_context *ctx);
+
+/*
+ * Log a summary of all counts gathered so far.
+ */
+void
+great_allocstats_report(void);
+
+#endif
+
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation workload characterisation. This sets $GREAT_ALLOC_STATS and
+ * $GREAT_LOG itself, and reads back the summary.
+ *
+ * Each of several threads makes requests of its own size, so that every
+ * size class in the summary is to be exact. Calls are reported as the
+ * wrappers would report them (see alloc.h), without allocating.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() and pthread_barrier_wait() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "allocstats.h"
+#include "context.h"
+#include "log.h"
+
+#define LOGFILE "allocstats_test.log"
+#define THREADS 4
+#define CALLS   1000
+#define SIZE    16	/* for the first thread; doubled for each after */
+
+static pthread_barrier_t barrier;
+
+/*
+ * Report CALLS blocks of size bytes allocated, each doubled and freed, and one
+ * request which failed.
+ *
+ * Every thread waits for the others before exiting, so that each keeps a
+ * context of its own.
+ */
+static void *
+allocate(void *arg)
+{
+	struct great_context *ctx;
+	size_t size = *(size_t *) arg;
+	char block;
+	size_t i;
+
+	ctx = great_context();
+	assert(ctx);
+
+	for (i = 0; i < CALLS; i++) {
+		great_allocstats_malloc(ctx, size, &block);
+		great_allocstats_realloc(ctx, size, size * 2, &block);
+		great_allocstats_free(ctx);
+	}
+
+	great_allocstats_malloc(ctx, SIZE_MAX, NULL);
+
+	(void) pthread_barrier_wait(&barrier);
+
+	return NULL;
+}
+
+int
+main(void)
+{
+	pthread_t tid[THREADS];
+	size_t size[THREADS];
+	unsigned long mallocs, reallocs, frees, failed;
+	unsigned long lo, hi, n;
+	unsigned long threads, classes, growth;
+	char line[512];
+	const char *s;
+	FILE *f;
+	size_t i;
+
+	(void) remove(LOGFILE);
+
+	if (-1 == setenv("GREAT_LOG", LOGFILE, 1)
+	|| -1 == setenv("GREAT_ALLOC_STATS", "thread", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("allocstats_test", NULL);
+	great_context_init();
+	great_allocstats_init();
+	assert(great_allocstats_enabled);
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		size[i] = (size_t) SIZE << i;
+
+		if (0 != pthread_create(&tid[i], NULL, allocate, &size[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	great_allocstats_report();
+
+	f = fopen(LOGFILE, "r");
+	assert(f);
+
+	threads = classes = growth = 0;
+	while (fgets(line, sizeof line, f)) {
+		int k;
+
+		s = strstr(line, " GREAT_ALLOC_STATS INFO: ");
+		if (!s) {
+			continue;
+		}
+
+		s += strlen(" GREAT_ALLOC_STATS INFO: ");
+
+		if (0 == strncmp(s, "thread ", 7)) {
+			s = strchr(s, ':');
+			assert(s);
+
+			k = sscanf(s, ": %lu malloc, %lu realloc, %lu free, "
+				"%lu failed",
+				&mallocs, &reallocs, &frees, &failed);
+			if (k == 4) {
+				assert(mallocs == CALLS + 1 && failed == 1);
+				assert(reallocs == CALLS && frees == CALLS);
+				threads++;
+			}
+
+			continue;
+		}
+
+		if (0 != strncmp(s, "total: ", 7)) {
+			continue;
+		}
+
+		s += 7;
+
+		if (strstr(s, " malloc, ")) {
+			k = sscanf(s, "%lu malloc, %lu realloc, %lu free, "
+				"%lu failed",
+				&mallocs, &reallocs, &frees, &failed);
+			assert(k == 4);
+			assert(mallocs  == THREADS * (CALLS + 1));
+			assert(reallocs == THREADS * CALLS);
+			assert(frees    == THREADS * CALLS);
+			assert(failed   == THREADS);
+		} else if (0 == strncmp(s, "size ", 5)) {
+			k = sscanf(s, "size %lu-%lu: %lu", &lo, &hi, &n);
+			assert(k == 3);
+
+			if (lo == SIZE || lo == SIZE << THREADS) {
+				/* The first thread's, or the last's doubled */
+				assert(n == CALLS);
+			} else if (lo > SIZE && lo < SIZE << THREADS) {
+				/* One thread's first, and another's doubled */
+				assert(n == 2 * CALLS);
+			} else {
+				/* The requests which failed */
+				assert(hi == (unsigned long) SIZE_MAX);
+				assert(n == THREADS);
+			}
+
+			classes++;
+		} else if (strstr(s, "realloc growth ")) {
+			k = sscanf(s, "realloc growth <= 2: %lu", &n);
+			assert(k == 1);
+			assert(n == THREADS * CALLS);
+			growth++;
+		}
+	}
+
+	fclose(f);
+	(void) remove(LOGFILE);
+
+	assert(threads == THREADS);
+	assert(classes == THREADS + 2);
+	assert(growth == 1);
+
+	printf("allocstats_test: %lu threads, %lu size classes\n",
+		threads, classes);
+
+	return EXIT_SUCCESS;
+}
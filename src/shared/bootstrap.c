@@ -0,0 +1,123 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Bootstrap allocation.
+ *
+ * Each block is preceded by its size, padded out to the alignment of the
+ * arena, so that realloc() may know how much to copy from it.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "bootstrap.h"
+
+/*
+ * Alignment suitable for any object; C99 has no max_align_t.
+ */
+#define ALIGN 16
+
+/* Padding for the size recorded before each block */
+#define HEADER ALIGN
+
+__thread unsigned int great_bootstrapping;
+
+static union {
+	long double ld;
+	void *p;
+	long long ll;
+	unsigned char c[GREAT_BOOTSTRAP_SIZE];
+} arena __attribute__((aligned(ALIGN)));
+
+/* Offset of the next free byte in the arena */
+static size_t next;
+
+void
+great_bootstrap_begin(void)
+{
+	great_bootstrapping++;
+
+	assert(great_bootstrapping > 0);
+}
+
+void
+great_bootstrap_end(void)
+{
+	assert(great_bootstrapping > 0);
+
+	great_bootstrapping--;
+}
+
+void *
+great_bootstrap_malloc(size_t size)
+{
+	size_t n;
+	size_t off;
+	unsigned char *p;
+
+	if (size > GREAT_BOOTSTRAP_SIZE) {
+		return NULL;
+	}
+
+	n = HEADER + ((size + ALIGN - 1) & ~(size_t) (ALIGN - 1));
+
+	off = __atomic_fetch_add(&next, n, __ATOMIC_RELAXED);
+	if (off > GREAT_BOOTSTRAP_SIZE - n) {
+		/* leave next past the end, so that every later call fails too */
+		return NULL;
+	}
+
+	p = arena.c + off;
+	*(size_t *) (void *) p = size;
+
+	return p + HEADER;
+}
+
+bool
+great_bootstrap_owns(const void *p)
+{
+	/* a single unsigned comparison; p below the arena wraps around */
+	return (uintptr_t) p - (uintptr_t) arena.c < sizeof arena.c;
+}
+
+size_t
+great_bootstrap_size(const void *p)
+{
+	const unsigned char *c = p;
+
+	assert(great_bootstrap_owns(p));
+
+	return *(const size_t *) (const void *) (c - HEADER);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Bootstrap allocation.
+ *
+ * Whilst a wrapped function is being resolved, the real allocator may not be
+ * called: it may not yet be resolved itself, and resolving it (by dlsym(),
+ * which may allocate) could recurse. Allocations made by the wrappers during
+ * resolution are instead served from a small static arena, by incrementing a
+ * pointer. This needs neither locking nor any other library, and so is safe at
+ * any point in startup, whichever allocator the process has.
+ *
+ * Only the resolution itself is so served (see great_wrap_resolve()); once
+ * the real allocator is resolved, everything else, including initialisation
+ * (which compiles a regular expression for each subset), is given to it. The
+ * arena therefore holds only what dlsym() allocates, if anything.
+ *
+ * Blocks from the arena are never reused. free() is expected to recognise
+ * them by great_bootstrap_owns() and ignore them, and realloc() to move them
+ * to the real allocator once bootstrapping is over.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_BOOTSTRAP_H
+#define GREAT_SHARED_BOOTSTRAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * The size of the arena, in bytes.
+ */
+#define GREAT_BOOTSTRAP_SIZE 65536
+
+/*
+ * Non-zero whilst the calling thread is bootstrapping; see
+ * great_bootstrap_begin() and great_bootstrap_end(). Consider this private.
+ */
+extern __thread unsigned int great_bootstrapping;
+
+/*
+ * Begin and end a period during which allocations by the calling thread are
+ * served from the arena. These may be nested, as for great_subset_disable().
+ */
+void
+great_bootstrap_begin(void);
+
+void
+great_bootstrap_end(void);
+
+/*
+ * True if allocations ought currently to be served from the arena.
+ */
+#define GREAT_BOOTSTRAPPING() (great_bootstrapping > 0)
+
+/*
+ * Allocate size bytes from the arena, suitably aligned for any object, or
+ * return NULL if the arena is exhausted.
+ */
+void *
+great_bootstrap_malloc(size_t size);
+
+/*
+ * True if p was allocated from the arena.
+ */
+bool
+great_bootstrap_owns(const void *p);
+
+/*
+ * The size requested for a block allocated from the arena.
+ */
+size_t
+great_bootstrap_size(const void *p);
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Bootstrap arena allocation.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "bootstrap.h"
+
+int
+main(void)
+{
+	unsigned char *p;
+	unsigned char *q;
+	size_t total;
+	int local;
+
+	/* Periods nest */
+	assert(!GREAT_BOOTSTRAPPING());
+	great_bootstrap_begin();
+	great_bootstrap_begin();
+	great_bootstrap_end();
+	assert(GREAT_BOOTSTRAPPING());
+	great_bootstrap_end();
+	assert(!GREAT_BOOTSTRAPPING());
+
+	p = great_bootstrap_malloc(1);
+	q = great_bootstrap_malloc(100);
+	assert(p && q);
+	assert((uintptr_t) p % 16 == 0 && (uintptr_t) q % 16 == 0);
+	assert(q >= p + 16);
+
+	assert(great_bootstrap_owns(p) && great_bootstrap_owns(q + 99));
+	assert(!great_bootstrap_owns(NULL));
+	assert(!great_bootstrap_owns(&local));
+
+	assert(great_bootstrap_size(p) == 1);
+	assert(great_bootstrap_size(q) == 100);
+
+	/* Blocks do not overlap their neighbours' sizes */
+	p[0] = 0xff;
+	q[99] = 0xff;
+	assert(great_bootstrap_size(p) == 1);
+
+	assert(!great_bootstrap_malloc(GREAT_BOOTSTRAP_SIZE + 1));
+
+	/* Once exhausted, the arena stays so */
+	total = 0;
+	while (great_bootstrap_malloc(1000)) {
+		total += 1000;
+	}
+
+	assert(total > GREAT_BOOTSTRAP_SIZE / 2 && total < GREAT_BOOTSTRAP_SIZE);
+	assert(!great_bootstrap_malloc(1));
+
+	printf("bootstrap_test: %lu bytes served\n", (unsigned long) total + 101);
+
+	return EXIT_SUCCESS;
+}
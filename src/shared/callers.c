@@ -0,0 +1,317 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Caller object targeting.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "callers.h"
+#include "subset.h"
+#include "log.h"
+#include "../map.h"
+#include "../proc.h"
+#include "../re.h"
+
+/* Spare entries, for objects loaded whilst a table is being built */
+#define SPARE 16
+
+/* Call sites remembered as within no object, per table; a power of two */
+#define MISSES 256
+
+/* The most slots probed for a call site remembered */
+#define PROBES 8
+
+struct range {
+	uintptr_t lo;
+	uintptr_t hi;	/* exclusive */
+	bool match;
+};
+
+struct table {
+	unsigned long generation;	/* as given by great_segments() */
+	uintptr_t miss[MISSES];	/* open addressed, or 0 for empty */
+	size_t n;
+	size_t max;
+	struct range range[];
+};
+
+bool great_callers_enabled;
+
+static struct great_re *re;
+static struct table *table;
+static int lock;	/* held whilst building a table */
+
+static void
+count(void *opaque, const char *object, uintptr_t lo, uintptr_t hi)
+{
+	size_t *n = opaque;
+
+	(void) object;
+	(void) lo;
+	(void) hi;
+
+	(*n)++;
+}
+
+static void
+add(void *opaque, const char *object, uintptr_t lo, uintptr_t hi)
+{
+	struct table *t = opaque;
+	struct range *r;
+	size_t i;
+
+	assert(object);
+
+	if (t->n == t->max) {
+		return;
+	}
+
+	/* Insertion sort; objects are given mostly in order of address */
+	for (i = t->n; i > 0 && t->range[i - 1].lo > lo; i--) {
+		t->range[i] = t->range[i - 1];
+	}
+
+	r = &t->range[i];
+	r->lo    = lo;
+	r->hi    = hi;
+	r->match = great_re_match(re, object);
+
+	t->n++;
+
+	if (r->match) {
+		great_log(GREAT_LOG_INFO, "GREAT_CALLERS",
+			"Targeting calls from %s", object);
+	}
+}
+
+/*
+ * Build a table of the objects currently loaded, and publish it. Returns false
+ * if another thread is building one, or if a table could not be built.
+ */
+static bool
+build(void)
+{
+	struct table *t;
+	size_t n;
+
+	if (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	/* Matching may call functions we wrap; let those default */
+	great_subset_disable();
+
+	n = 0;
+	(void) great_segments(count, &n);
+
+	n += SPARE;
+
+	t = great_map(sizeof *t + n * sizeof *t->range);
+	if (t) {
+		t->max = n;
+		t->generation = great_segments(add, t);
+
+		__atomic_store_n(&table, t, __ATOMIC_RELEASE);
+	}
+
+	great_subset_enable();
+
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+
+	return t != NULL;
+}
+
+static const struct range *
+search(const struct table *t, uintptr_t pc)
+{
+	size_t lo;
+	size_t hi;
+
+	assert(t);
+
+	lo = 0;
+	hi = t->n;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (pc < t->range[mid].lo) {
+			hi = mid;
+		} else if (pc >= t->range[mid].hi) {
+			lo = mid + 1;
+		} else {
+			return &t->range[mid];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Find whether pc has been found within no object whilst t was current,
+ * remembering it if remember is set. Call sites outside every object (in
+ * generated code, say) are thereby looked up from great_segments() once per
+ * table, rather than once per call. A site is forgotten if its slots are full.
+ */
+static bool
+missed(struct table *t, uintptr_t pc, bool remember)
+{
+	uintptr_t v;
+	uint64_t h;
+	size_t i;
+
+	assert(t);
+	assert(pc != 0);
+
+	h = (uint64_t) pc * (uint64_t) 0x9e3779b97f4a7c15ULL;
+
+	for (i = 0; i < PROBES; i++) {
+		uintptr_t *slot = &t->miss[((size_t) (h >> 32) + i)
+			& (MISSES - 1)];
+
+		v = __atomic_load_n(slot, __ATOMIC_RELAXED);
+		if (v == pc) {
+			return true;
+		}
+
+		if (v != 0) {
+			continue;
+		}
+
+		if (!remember) {
+			return false;
+		}
+
+		/* Another thread may have taken the slot meanwhile */
+		if (__atomic_compare_exchange_n(slot, &v, pc, false,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED) || v == pc) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Only the forking thread continues in the child; a table left part built
+ * has not been published, and so is simply disregarded.
+ */
+static void
+child(void)
+{
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+}
+
+void
+great_callers_init(void)
+{
+	const char *s;
+	int e;
+
+	s = getenv("GREAT_CALLERS");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	if (0 == great_segments(NULL, NULL)) {
+		great_log(GREAT_LOG_ERROR, "GREAT_CALLERS",
+			"Objects cannot be listed; targeting disabled");
+		return;
+	}
+
+	re = great_re_comp(s, &e);
+	if (!re) {
+		char buf[128];
+
+		great_re_error(e, buf, sizeof buf);
+		great_log(GREAT_LOG_ERROR, "GREAT_CALLERS",
+			"%s; targeting disabled", buf);
+		return;
+	}
+
+	if (!great_atfork(NULL, NULL, child) || !build()) {
+		great_log(GREAT_LOG_ERROR, "GREAT_CALLERS",
+			"Unable to build the object table; targeting disabled");
+		great_re_free(re);
+		re = NULL;
+		return;
+	}
+
+	great_callers_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_CALLERS",
+		"Targeting calls from objects matching /%s/", s);
+}
+
+bool
+great_callers(const void *pc)
+{
+	const struct range *r;
+	struct table *t;
+
+	if (!pc) {
+		return false;
+	}
+
+	t = __atomic_load_n(&table, __ATOMIC_ACQUIRE);
+	assert(t);
+
+	r = search(t, (uintptr_t) pc);
+	if (r) {
+		return r->match;
+	}
+
+	if (missed(t, (uintptr_t) pc, false)) {
+		return false;
+	}
+
+	/* An object may have been loaded since the table was built */
+	if (great_segments(NULL, NULL) == t->generation) {
+		(void) missed(t, (uintptr_t) pc, true);
+		return false;
+	}
+
+	if (!build()) {
+		return false;
+	}
+
+	r = search(__atomic_load_n(&table, __ATOMIC_ACQUIRE), (uintptr_t) pc);
+
+	return r && r->match;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Caller object targeting.
+ *
+ * When $GREAT_CALLERS is set non-empty, it gives a regular expression which is
+ * matched against the path of the object (the program, or a shared library)
+ * from which each call is made. Calls from objects which do not match are
+ * neither counted nor intercepted; see schedule.h. For example, to intercept
+ * only calls made from within the program's own libraries:
+ *
+ *	$GREAT_CALLERS='/libmine[^/]*\.so'
+ *
+ * The executable segments of every object loaded are kept in a table sorted by
+ * address, with the result of matching each object, so that finding whether a
+ * call is targeted is a binary search on its return address. The table is
+ * built by great_segments(), and is built afresh when a call is found from
+ * outside of it and objects have since been loaded (by dlopen(), say) or
+ * unloaded. A call found from outside of every object is remembered with the
+ * table, so that it is not looked for again until the table is replaced.
+ * Tables replaced are not unmapped, since other threads may still be
+ * searching them. Whilst one thread builds a table, calls found by others from
+ * outside the current table are not targeted, rather than have them wait; the
+ * builder may itself be waiting for the dynamic linker, which they may hold.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_CALLERS_H
+#define GREAT_SHARED_CALLERS_H
+
+#include <stdbool.h>
+
+extern bool great_callers_enabled;
+
+/*
+ * Initialise from $GREAT_CALLERS. This must be called before use, and ought to
+ * be called with subsets disabled.
+ */
+void
+great_callers_init(void);
+
+/*
+ * Return true if the call site pc lies within an object matched by
+ * $GREAT_CALLERS.
+ */
+bool
+great_callers(const void *pc);
+
+#endif
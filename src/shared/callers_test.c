@@ -0,0 +1,206 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Caller object targeting. This sets $GREAT_CALLERS itself, to target calls
+ * from this program and from the maths library, which is not loaded until
+ * part-way through, so that the table of objects must be built afresh.
+ *
+ * Several threads look up call sites whilst the library is loaded. Sites
+ * within objects already in the table are to be found whilst it is replaced.
+ * A site within no object is to be looked for among the objects loaded once,
+ * rather than once per call; dl_iterate_phdr() is interposed to count them.
+ *
+ * $Id$
+ */
+
+/* Required for setenv(), pthread_barrier_wait() and RTLD_NEXT */
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <dlfcn.h>
+#include <link.h>
+#include <assert.h>
+
+#include "callers.h"
+#include "log.h"
+
+#define THREADS 4
+#define CALLS   100000
+
+static const void *self;	/* a call site within this program */
+static const void *libc;	/* a call site within the C library */
+static const void *volatile libm;	/* once the maths library is loaded */
+
+static pthread_barrier_t barrier;
+static unsigned long walks;	/* of the objects loaded */
+
+int
+dl_iterate_phdr(int (*f)(struct dl_phdr_info *, size_t, void *), void *p)
+{
+	static int (*next)(int (*)(struct dl_phdr_info *, size_t, void *),
+		void *);
+
+	if (!next) {
+		*(void **) &next = dlsym(RTLD_NEXT, "dl_iterate_phdr");
+		assert(next);
+	}
+
+	__atomic_add_fetch(&walks, 1, __ATOMIC_RELAXED);
+
+	return next(f, p);
+}
+
+static __attribute__((noinline)) const void *
+here(void)
+{
+	return __builtin_return_address(0);
+}
+
+/*
+ * Called back by qsort(), and so from within the C library.
+ */
+static int
+compare(const void *a, const void *b)
+{
+	libc = __builtin_return_address(0);
+
+	return *(const int *) a - *(const int *) b;
+}
+
+static void *
+lookup(void *arg)
+{
+	unsigned long *found = arg;
+	char local;
+	size_t i;
+
+	(void) pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < CALLS; i++) {
+		const void *m;
+
+		assert(great_callers(self));
+		assert(!great_callers(libc));
+
+		/* Within no object, and so the table may be built afresh */
+		assert(!great_callers(&local));
+
+		/* Untargeted whilst another thread builds the table */
+		m = libm;
+		if (m && great_callers(m)) {
+			(*found)++;
+		}
+	}
+
+	return NULL;
+}
+
+int
+main(void)
+{
+	pthread_t tid[THREADS];
+	unsigned long found[THREADS];
+	int a[2] = { 2, 1 };
+	char local[4];
+	unsigned long w;
+	void *h;
+	size_t i;
+
+	if (-1 == setenv("GREAT_CALLERS", "/callers_test$|/libm\\.so", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("callers_test", NULL);
+	great_callers_init();
+	assert(great_callers_enabled);
+
+	self = here();
+	qsort(a, 2, sizeof *a, compare);
+	assert(libc);
+
+	assert(great_callers(self));
+	assert(!great_callers(libc));
+	assert(!great_callers(NULL));
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS + 1)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		found[i] = 0;
+
+		if (0 != pthread_create(&tid[i], NULL, lookup, &found[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	(void) pthread_barrier_wait(&barrier);
+
+	h = dlopen("libm.so.6", RTLD_NOW);
+	assert(h);
+
+	libm = dlsym(h, "cos");
+	assert(libm);
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	assert(great_callers(libm));
+	assert(great_callers(self));
+	assert(!great_callers(libc));
+
+	/* Each site within no object is looked for once for this table */
+	w = __atomic_load_n(&walks, __ATOMIC_RELAXED);
+	for (i = 0; i < CALLS; i++) {
+		assert(!great_callers(&local[i % sizeof local]));
+	}
+	assert(__atomic_load_n(&walks, __ATOMIC_RELAXED) - w <= sizeof local);
+
+	for (i = 1; i < THREADS; i++) {
+		found[0] += found[i];
+	}
+
+	printf("callers_test: %lu calls found from the maths library\n",
+		found[0]);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Per-thread context.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "context.h"
+#include "../clock.h"
+#include "../map.h"
+#include "../proc.h"
+#include "../thread.h"
+
+/*
+ * The list of all contexts. Contexts are only ever pushed to the head of this
+ * list, and never removed, so it may be walked without locking.
+ */
+static struct great_context *contexts;
+
+static __thread struct great_context *current;
+static __thread bool creating;
+
+/*
+ * Called by way of great_thread_atexit() when a thread owning a context exits.
+ */
+static void
+release(void *p)
+{
+	struct great_context *ctx = p;
+
+	assert(ctx);
+
+	ctx->elapsed += great_clock() - ctx->start;
+	current = NULL;
+
+	__atomic_store_n(&ctx->owned, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ * Attempt to claim a context whose owner has exited.
+ */
+static struct great_context *
+adopt(void)
+{
+	struct great_context *ctx;
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		int dead = 0;
+
+		if (__atomic_load_n(&ctx->owned, __ATOMIC_RELAXED)) {
+			continue;
+		}
+
+		if (__atomic_compare_exchange_n(&ctx->owned, &dead, 1, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+			return ctx;
+		}
+	}
+
+	return NULL;
+}
+
+static struct great_context *
+create(void)
+{
+	struct great_context *ctx;
+
+	ctx = great_map(sizeof *ctx);
+	if (!ctx) {
+		return NULL;
+	}
+
+	ctx->owned = 1;
+
+	ctx->next = __atomic_load_n(&contexts, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&contexts, &ctx->next, ctx, true,
+		__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+
+	return ctx;
+}
+
+/*
+ * Only the forking thread continues in the child; the owners of all other
+ * contexts are gone.
+ */
+static void
+child(void)
+{
+	struct great_context *ctx;
+	uint64_t now;
+
+	now = great_clock();
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		ctx->elapsed = 0;
+
+		if (ctx == current) {
+			ctx->start = now;
+			continue;
+		}
+
+		__atomic_store_n(&ctx->owned, 0, __ATOMIC_RELEASE);
+	}
+}
+
+void
+great_context_init(void)
+{
+	(void) great_atfork(NULL, NULL, child);
+}
+
+struct great_context *
+great_context(void)
+{
+	struct great_context *ctx;
+
+	if (current) {
+		return current;
+	}
+
+	/* great_thread_atexit() may allocate, which may bring us back here */
+	if (creating) {
+		return NULL;
+	}
+
+	creating = true;
+
+	ctx = adopt();
+	if (!ctx) {
+		ctx = create();
+	}
+
+	if (ctx) {
+		ctx->id = great_thread_id();
+		ctx->start = great_clock();
+
+		/* An adopted context's name was its previous owner's */
+		ctx->threadname.scope = 0;
+
+		/* Decisions are recorded and replayed by thread */
+		memset(&ctx->decision, 0, sizeof ctx->decision);
+
+		/* Without a destructor the context simply stays owned */
+		(void) great_thread_atexit(release, ctx);
+	}
+
+	current = ctx;
+	creating = false;
+
+	return ctx;
+}
+
+struct great_context *
+great_context_first(void)
+{
+	return __atomic_load_n(&contexts, __ATOMIC_ACQUIRE);
+}
+
+uint64_t
+great_context_elapsed(const struct great_context *ctx)
+{
+	assert(ctx);
+
+	if (!__atomic_load_n(&ctx->owned, __ATOMIC_ACQUIRE)) {
+		return ctx->elapsed;
+	}
+
+	return ctx->elapsed + (great_clock() - ctx->start);
+}
+
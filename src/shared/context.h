@@ -0,0 +1,144 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Per-thread context.
+ *
+ * Each thread which passes through the wrappers is given a context in which
+ * state private to that thread may be kept, so that it may be updated without
+ * locking. Each facility needing such state adds its own members to
+ * struct great_context, grouped by the file which maintains them.
+ *
+ * Contexts are not obtained by malloc(), so that they may be created from
+ * within our own memory management wrappers. They are never freed; instead a
+ * context belonging to a thread which has exited is adopted by the next thread
+ * to need one. State accumulated in a context (for example, counters) is
+ * therefore kept across threads, and is never lost.
+ *
+ * All contexts, past and present, may be visited by way of
+ * great_context_first() and the next member, which is intended for reporting
+ * at exit.
+ *
+ * In a child forked by the application, only the forking thread continues.
+ * The contexts of all other threads are released for adoption, and every
+ * context's elapsed time starts again from the fork. Facilities which keep
+ * counters reset them likewise, so that each process reports for itself.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_CONTEXT_H
+#define GREAT_SHARED_CONTEXT_H
+
+#include <stdint.h>
+
+#include "allocstats.h"
+#include "decision.h"
+#include "heapprof.h"
+#include "live.h"
+#include "lifetime.h"
+#include "memlimit.h"
+#include "site.h"
+#include "threadname.h"
+#include "trace.h"
+
+struct great_context {
+	unsigned long id;	/* great_thread_id() of the current owner */
+	int owned;	/* non-zero whilst owned by a running thread */
+
+	/*
+	 * The time spent owned by running threads is given by elapsed, plus the
+	 * time since start if the context is currently owned.
+	 */
+	uint64_t start;
+	uint64_t elapsed;
+
+	/* allocstats.c */
+	struct great_allocstats allocstats;
+
+	/* decision.c */
+	struct great_decision decision;
+
+	/* heapprof.c */
+	struct great_heapprof heapprof;
+
+	/* live.c */
+	struct great_live live;
+
+	/* lifetime.c */
+	struct great_lifetime lifetime;
+
+	/* memlimit.c */
+	struct great_memlimit memlimit;
+
+	/* site.c */
+	struct great_site site;
+
+	/* threadname.c */
+	struct great_threadname threadname;
+
+	/* trace.c */
+	struct great_trace trace;
+
+	struct great_context *next;
+};
+
+/*
+ * Prepare for contexts to be carried across fork(). This must be called before
+ * use.
+ */
+void
+great_context_init(void);
+
+/*
+ * Return the calling thread's context, creating one if it does not yet have
+ * one. Returns NULL if a context could not be created, and also if called
+ * (for example, by way of a wrapper) whilst a context is being created for
+ * this thread. Callers are expected to quietly do without.
+ */
+struct great_context *
+great_context(void);
+
+/*
+ * Return the most recently created context, or NULL if there are none.
+ * Subsequent contexts are given by each context's next member.
+ */
+struct great_context *
+great_context_first(void);
+
+/*
+ * Return the time in nanoseconds for which the given context has been owned
+ * by running threads.
+ */
+uint64_t
+great_context_elapsed(const struct great_context *ctx);
+
+#endif
+
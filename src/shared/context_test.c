@@ -0,0 +1,260 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Per-thread contexts, and their carriage across fork(). This sets
+ * $GREAT_ALLOC_STATS and $GREAT_RANDOM_SEED itself.
+ *
+ * A context whose owner has exited is to be adopted by the next thread
+ * needing one. Children are forked whilst several threads hold contexts;
+ * in each child those threads are gone, and so their contexts are to be
+ * adopted, counters are to start afresh, and the failure state is to be
+ * reseeded apart from the parent's and from each sibling's.
+ *
+ * $Id$
+ */
+
+/* Required for fork() and pthread_barrier_wait() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <assert.h>
+
+#include "context.h"
+#include "allocstats.h"
+#include "random.h"
+#include "log.h"
+
+#define THREADS  4
+#define CHILDREN 2
+
+static pthread_barrier_t barrier;
+
+static size_t
+count(void)
+{
+	struct great_context *ctx;
+	size_t n;
+
+	n = 0;
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		n++;
+	}
+
+	return n;
+}
+
+static void *
+get(void *arg)
+{
+	struct great_context **ctx = arg;
+
+	*ctx = great_context();
+	assert(*ctx);
+
+	return NULL;
+}
+
+/*
+ * Hold a context until the main thread has forked its children.
+ */
+static void *
+hold(void *arg)
+{
+	get(arg);
+
+	(void) pthread_barrier_wait(&barrier);
+	(void) pthread_barrier_wait(&barrier);
+
+	return NULL;
+}
+
+static struct great_context *
+spawn(void)
+{
+	struct great_context *ctx;
+	pthread_t tid;
+
+	if (0 != pthread_create(&tid, NULL, get, &ctx)
+	|| 0 != pthread_join(tid, NULL)) {
+		perror("pthread");
+		exit(EXIT_FAILURE);
+	}
+
+	return ctx;
+}
+
+/*
+ * In the child, the context of every thread but this one is free, and so a
+ * new thread takes one rather than creating another. The first number drawn
+ * is written to fd for the parent to compare.
+ */
+static void
+child(int fd, struct great_context *self, size_t n)
+{
+	struct great_context *ctx;
+	int r;
+
+	assert(count() == n);
+	assert(great_context() == self);
+	assert(self->allocstats.malloc == 0);
+
+	ctx = spawn();
+	assert(ctx != self);
+	assert(count() == n);
+
+	r = great_random_int(NULL);
+	if (sizeof r != write(fd, &r, sizeof r)) {
+		_exit(EXIT_FAILURE);
+	}
+
+	_exit(EXIT_SUCCESS);
+}
+
+int
+main(void)
+{
+	struct great_context *self, *a, *b;
+	struct great_context *held[THREADS];
+	pthread_t tid[THREADS];
+	int drawn[CHILDREN + 1];
+	int fd[2];
+	size_t i, j, n;
+	char c;
+
+	if (-1 == setenv("GREAT_ALLOC_STATS", "1", 1)
+	|| -1 == setenv("GREAT_RANDOM_SEED", "42", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("context_test", NULL);
+	great_context_init();
+	great_allocstats_init();
+	great_random_init(NULL);
+
+	self = great_context();
+	assert(self);
+	assert(count() == 1);
+
+	/* A context is released when its owner exits */
+	a = spawn();
+	b = spawn();
+	assert(a == b && a != self);
+	assert(count() == 2);
+
+	great_allocstats_malloc(self, 1, &c);
+	assert(self->allocstats.malloc == 1);
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS + 1)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, hold, &held[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	(void) pthread_barrier_wait(&barrier);
+
+	/* One was adopted, and the rest created */
+	n = count();
+	assert(n == THREADS + 1);
+
+	if (-1 == pipe(fd)) {
+		perror("pipe");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < CHILDREN; i++) {
+		pid_t pid;
+		int status;
+
+		pid = fork();
+		if (-1 == pid) {
+			perror("fork");
+			return EXIT_FAILURE;
+		}
+
+		if (0 == pid) {
+			child(fd[1], self, n);
+		}
+
+		if (-1 == waitpid(pid, &status, 0)) {
+			perror("waitpid");
+			return EXIT_FAILURE;
+		}
+
+		assert(WIFEXITED(status));
+		assert(WEXITSTATUS(status) == EXIT_SUCCESS);
+
+		if (sizeof *drawn != read(fd[0], &drawn[i], sizeof *drawn)) {
+			perror("read");
+			return EXIT_FAILURE;
+		}
+	}
+
+	(void) pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	/* The parent's own state is untouched by its children */
+	assert(self->allocstats.malloc == 1);
+
+	drawn[CHILDREN] = great_random_int(NULL);
+
+	for (i = 0; i <= CHILDREN; i++) {
+		for (j = i + 1; j <= CHILDREN; j++) {
+			assert(drawn[i] != drawn[j]);
+		}
+	}
+
+	great_log_fini();
+
+	printf("context_test: %lu contexts, %d children\n",
+		(unsigned long) n, CHILDREN);
+
+	return EXIT_SUCCESS;
+}
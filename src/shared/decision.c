@@ -0,0 +1,584 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Record and replay of injection decisions.
+ *
+ * Each thread fills a chunk of its own in the mapping without locking; chunks
+ * are handed out by an atomic addition to the offset kept in the header. A
+ * chunk's used count is stored only once its events are written, so that a
+ * recording cut short by a crash is consistent up to its last event.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "decision.h"
+#include "context.h"
+#include "log.h"
+#include "../map.h"
+#include "../io.h"
+#include "../proc.h"
+
+bool great_decision_recording;
+bool great_decision_replaying;
+
+static unsigned long threads;	/* ordinals given so far */
+static unsigned long functions;	/* IDs given so far */
+
+/* Recording */
+static unsigned char *file;
+static size_t names;	/* bytes of the header used */
+
+/* Replay */
+static const unsigned char *replay;
+static size_t replaylen;
+static const char *recorded[GREAT_DECISION_HEADER / 2];	/* paths, by ID */
+static size_t pathlen[GREAT_DECISION_HEADER / 2];
+static unsigned long local[GREAT_DECISION_HEADER / 2];	/* IDs, or ULONG_MAX */
+static unsigned long nrecorded;
+static uint64_t *heads;	/* offset of each thread's first chunk, by ordinal */
+static unsigned long nheads;
+
+static size_t
+varint(unsigned char *p, uint64_t u)
+{
+	size_t n;
+
+	for (n = 0; u >= 0x80; u >>= 7) {
+		p[n++] = (unsigned char) (u | 0x80);
+	}
+
+	p[n++] = (unsigned char) u;
+
+	return n;
+}
+
+/*
+ * Decode a varint from p, before end. Returns the bytes taken, or 0 if it is
+ * cut short.
+ */
+static size_t
+unvarint(const unsigned char *p, const unsigned char *end, uint64_t *u)
+{
+	unsigned int shift;
+	size_t n;
+
+	*u = 0;
+
+	for (n = 0, shift = 0; p + n < end && shift < 64; n++, shift += 7) {
+		*u |= (uint64_t) (p[n] & 0x7f) << shift;
+		if (!(p[n] & 0x80)) {
+			return n + 1;
+		}
+	}
+
+	return 0;
+}
+
+static struct great_decision *
+state(void)
+{
+	struct great_context *ctx;
+
+	ctx = great_context();
+	if (!ctx) {
+		return NULL;
+	}
+
+	if (0 == ctx->decision.thread) {
+		ctx->decision.thread = __atomic_add_fetch(&threads, 1, __ATOMIC_RELAXED);
+	}
+
+	return &ctx->decision;
+}
+
+/*
+ * Begin a new chunk for a thread, linking it from the thread's previous chunk.
+ */
+static bool
+begin(struct great_decision *d)
+{
+	struct great_decision_chunk *c;
+	uint64_t o;
+
+	o = __atomic_fetch_add((uint64_t *) (void *) (file + GREAT_DECISION_END),
+		(uint64_t) GREAT_DECISION_CHUNK, __ATOMIC_RELAXED);
+	if (o + GREAT_DECISION_CHUNK > GREAT_DECISION_FILE) {
+		if (__atomic_exchange_n(&great_decision_recording, false,
+			__ATOMIC_RELAXED)) {
+			great_log(GREAT_LOG_ERROR, "GREAT_RECORD",
+				"The file is full; recording stopped");
+		}
+		return false;
+	}
+
+	c = (struct great_decision_chunk *) (void *) (file + o);
+	c->used = 0;
+	c->next = 0;
+	__atomic_store_n(&c->thread, (uint32_t) d->thread, __ATOMIC_RELEASE);
+
+	if (d->chunk) {
+		c = (struct great_decision_chunk *) (void *) d->chunk;
+		__atomic_store_n(&c->next, o, __ATOMIC_RELEASE);
+	}
+
+	d->chunk = file + o;
+
+	return true;
+}
+
+static void
+put(struct great_decision *d, uint64_t tag, uint64_t arg)
+{
+	unsigned char buf[GREAT_DECISION_EVENT];
+	struct great_decision_chunk *c;
+	size_t n;
+
+	n  = varint(buf, tag);
+	n += varint(buf + n, arg);
+
+	c = (struct great_decision_chunk *) (void *) d->chunk;
+	if (!c || c->used + n > GREAT_DECISION_ROOM) {
+		if (!begin(d)) {
+			return;
+		}
+
+		c = (struct great_decision_chunk *) (void *) d->chunk;
+	}
+
+	memcpy(d->chunk + sizeof *c + c->used, buf, n);
+	__atomic_store_n(&c->used, (uint32_t) (c->used + n), __ATOMIC_RELEASE);
+}
+
+/*
+ * Move on to the thread's next chunk, if there is one. A thread's chunks are
+ * begun in order, so a link which does not lead further on, or leads to some
+ * other thread's chunk, is taken to end the thread's events.
+ */
+static bool
+follow(struct great_decision *d, uint64_t o)
+{
+	struct great_decision_chunk c;
+
+	if (o < GREAT_DECISION_HEADER
+	|| (o - GREAT_DECISION_HEADER) % GREAT_DECISION_CHUNK != 0
+	|| o + GREAT_DECISION_CHUNK > replaylen
+	|| (d->from && replay + o <= d->from)) {
+		d->from = NULL;
+		d->p = d->end = NULL;
+		return false;
+	}
+
+	memcpy(&c, replay + o, sizeof c);
+	if (c.thread != d->thread) {
+		d->from = NULL;
+		d->p = d->end = NULL;
+		return false;
+	}
+
+	d->from = replay + o;
+
+	d->p   = d->from + sizeof c;
+	d->end = d->p + (c.used <= GREAT_DECISION_ROOM ? c.used : GREAT_DECISION_ROOM);
+
+	return true;
+}
+
+/*
+ * Decode the next varint in the thread's events, following chunks.
+ */
+static bool
+get(struct great_decision *d, uint64_t *u)
+{
+	struct great_decision_chunk c;
+	size_t n;
+
+	while (d->p == d->end) {
+		if (!d->from) {
+			return false;
+		}
+
+		memcpy(&c, d->from, sizeof c);
+		if (!follow(d, c.next)) {
+			return false;
+		}
+	}
+
+	n = unvarint(d->p, d->end, u);
+	if (0 == n) {
+		d->p = d->end;
+		d->from = NULL;
+		return false;
+	}
+
+	d->p += n;
+
+	return true;
+}
+
+/*
+ * Read ahead to the thread's next interception, passing over any values
+ * recorded but not since drawn.
+ */
+static void
+load(struct great_decision *d)
+{
+	uint64_t tag;
+	uint64_t arg;
+
+	d->read = true;
+	d->next = 0;
+
+	while (get(d, &tag) && get(d, &arg)) {
+		if (tag == 1) {
+			continue;
+		}
+
+		d->next = d->last + tag / 2;
+		d->last = d->next;
+		d->id   = (unsigned long) arg;
+
+		return;
+	}
+}
+
+static void
+start(struct great_decision *d)
+{
+	if (d->thread < nheads) {
+		(void) follow(d, heads[d->thread]);
+	}
+}
+
+/*
+ * Decisions are made afresh in a child; see decision.h.
+ */
+static void
+child(void)
+{
+	great_decision_recording = false;
+	great_decision_replaying = false;
+}
+
+static void
+record(const char *path)
+{
+	int fd;
+
+	/* Truncate any previous recording */
+	fd = great_open(path);
+	if (-1 != fd) {
+		great_close(fd);
+	}
+
+	file = great_map_file(path, GREAT_DECISION_FILE);
+	if (!file) {
+		great_log(GREAT_LOG_ERROR, "GREAT_RECORD",
+			"Unable to map %s; recording disabled", path);
+		return;
+	}
+
+	memcpy(file, GREAT_DECISION_MAGIC, strlen(GREAT_DECISION_MAGIC));
+	names = strlen(GREAT_DECISION_MAGIC);
+
+	*(uint64_t *) (void *) (file + GREAT_DECISION_END) = GREAT_DECISION_HEADER;
+
+	great_decision_recording = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_RECORD",
+		"Recording decisions to %s", path);
+}
+
+static void
+load_replay(const char *path)
+{
+	const unsigned char *p;
+	const unsigned char *nl;
+	struct great_decision_chunk c;
+	uint64_t end;
+	uint64_t o;
+
+	replay = great_map_read(path, &replaylen);
+	if (!replay || replaylen < GREAT_DECISION_HEADER
+	|| 0 != memcmp(replay, GREAT_DECISION_MAGIC, strlen(GREAT_DECISION_MAGIC))) {
+		great_log(GREAT_LOG_ERROR, "GREAT_REPLAY",
+			"%s is not a recording; replay disabled", path);
+		return;
+	}
+
+	/* The functions recorded */
+	p = replay + strlen(GREAT_DECISION_MAGIC);
+	while (*p != '\0' && nrecorded < sizeof recorded / sizeof *recorded) {
+		nl = memchr(p, '\n', (size_t) (replay + GREAT_DECISION_END - p));
+		if (!nl) {
+			break;
+		}
+
+		recorded[nrecorded] = (const char *) p;
+		pathlen[nrecorded]  = (size_t) (nl - p);
+		local[nrecorded]    = (unsigned long) -1;
+		nrecorded++;
+
+		p = nl + 1;
+	}
+
+	/* A recording cut short may end part way through a chunk */
+	memcpy(&end, replay + GREAT_DECISION_END, sizeof end);
+	if (end > replaylen) {
+		end = replaylen;
+	}
+
+	end = end < GREAT_DECISION_HEADER ? GREAT_DECISION_HEADER
+		: end - (end - GREAT_DECISION_HEADER) % GREAT_DECISION_CHUNK;
+
+	/*
+	 * The first chunk of each thread; chunks are handed out in order. Each
+	 * thread has a chunk of its own, so no ordinal exceeds the chunks.
+	 */
+	for (o = GREAT_DECISION_HEADER; o < end; o += GREAT_DECISION_CHUNK) {
+		memcpy(&c, replay + o, sizeof c);
+		if (c.thread >= nheads
+		&& c.thread <= (end - GREAT_DECISION_HEADER) / GREAT_DECISION_CHUNK) {
+			nheads = c.thread + 1;
+		}
+	}
+
+	if (nheads > 0) {
+		heads = great_map(nheads * sizeof *heads);
+		if (!heads) {
+			great_log(GREAT_LOG_ERROR, "GREAT_REPLAY",
+				"Unable to index %s; replay disabled", path);
+			return;
+		}
+	}
+
+	for (o = end; o > GREAT_DECISION_HEADER; ) {
+		o -= GREAT_DECISION_CHUNK;
+		memcpy(&c, replay + o, sizeof c);
+		if (c.thread != 0 && c.thread < nheads) {
+			heads[c.thread] = o;
+		}
+	}
+
+	great_decision_replaying = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_REPLAY",
+		"Replaying decisions for %lu threads from %s",
+		nheads > 0 ? nheads - 1 : 0, path);
+}
+
+void
+great_decision_init(void)
+{
+	const char *rec;
+	const char *rep;
+
+	rec = getenv("GREAT_RECORD");
+	rep = getenv("GREAT_REPLAY");
+
+	if (rec && 0 == strlen(rec)) {
+		rec = NULL;
+	}
+
+	if (rep && 0 == strlen(rep)) {
+		rep = NULL;
+	}
+
+	if (rec && rep) {
+		great_log(GREAT_LOG_ERROR, "GREAT_RECORD",
+			"Cannot both record and replay; recording disabled");
+		rec = NULL;
+	}
+
+	if (!rec && !rep) {
+		return;
+	}
+
+	if (!great_atfork(NULL, NULL, child)) {
+		great_log(GREAT_LOG_ERROR, rec ? "GREAT_RECORD" : "GREAT_REPLAY",
+			"Unable to handle fork(); disabled");
+		return;
+	}
+
+	if (rec) {
+		record(rec);
+	} else {
+		load_replay(rep);
+	}
+}
+
+unsigned long
+great_decision_function(const char *path)
+{
+	unsigned long id;
+	unsigned long i;
+	size_t n;
+
+	assert(path);
+
+	id = functions++;
+	n = strlen(path);
+
+	if (great_decision_recording) {
+		if (names + n + 1 >= GREAT_DECISION_END) {
+			great_log(GREAT_LOG_ERROR, "GREAT_RECORD",
+				"Too many functions; recording disabled");
+			great_decision_recording = false;
+			return id;
+		}
+
+		memcpy(file + names, path, n);
+		file[names + n] = '\n';
+		names += n + 1;
+	}
+
+	/* The nth recording of a path is the nth function registered for it */
+	for (i = 0; i < nrecorded; i++) {
+		if (local[i] == (unsigned long) -1 && pathlen[i] == n
+		&& 0 == memcmp(recorded[i], path, n)) {
+			local[i] = id;
+			break;
+		}
+	}
+
+	return id;
+}
+
+void
+great_decision_record(unsigned long id, bool intercept)
+{
+	struct great_decision *d;
+
+	d = state();
+	if (!d) {
+		return;
+	}
+
+	d->calls++;
+
+	if (!intercept) {
+		return;
+	}
+
+	put(d, 2 * (d->calls - d->last), id);
+	d->last = d->calls;
+}
+
+bool
+great_decision_replay(unsigned long id)
+{
+	struct great_decision *d;
+
+	d = state();
+	if (!d) {
+		return false;
+	}
+
+	if (0 == d->calls && !d->from) {
+		start(d);
+	}
+
+	d->calls++;
+
+	if (!d->read) {
+		load(d);
+	}
+
+	if (d->calls != d->next) {
+		return false;
+	}
+
+	d->read = false;
+
+	if (d->id >= nrecorded || local[d->id] != id) {
+		if (!d->diverged) {
+			great_log(GREAT_LOG_ERROR, "GREAT_REPLAY",
+				"Thread %lu diverged from the recording at decision %lu",
+				d->thread, (unsigned long) d->calls);
+			d->diverged = true;
+		}
+
+		return false;
+	}
+
+	return true;
+}
+
+void
+great_decision_note(uint64_t v)
+{
+	struct great_decision *d;
+
+	d = state();
+	if (!d) {
+		return;
+	}
+
+	put(d, 1, v);
+}
+
+bool
+great_decision_value(uint64_t *v)
+{
+	struct great_decision *d;
+	const unsigned char *from;
+	const unsigned char *p;
+	const unsigned char *end;
+	uint64_t tag;
+
+	assert(v);
+
+	d = state();
+	if (!d || d->read) {
+		return false;
+	}
+
+	/* Values follow their interception; anything else is left be */
+	from = d->from;
+	p    = d->p;
+	end  = d->end;
+
+	if (get(d, &tag) && tag == 1 && get(d, v)) {
+		return true;
+	}
+
+	d->from = from;
+	d->p    = p;
+	d->end  = end;
+
+	return false;
+}
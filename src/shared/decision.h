@@ -0,0 +1,183 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Record and replay of injection decisions.
+ *
+ * When $GREAT_RECORD is set to a path, every decision made by great_schedule()
+ * (see schedule.h) is recorded to that file, together with the values drawn
+ * from the PRNG for the kind of failure once a call is intercepted (see
+ * great_random_choice()). When $GREAT_REPLAY is set to a path so recorded,
+ * decisions and values are instead taken from the file, and the PRNG, the
+ * schedules and the targeting facilities are not consulted at all, so that a
+ * long session may be run again quickly, with exactly the same failures.
+ *
+ * Decisions are kept per thread, by the order in which threads first make a
+ * decision, and by the number of decisions each thread has made; only those
+ * intercepted are recorded. A replay therefore reproduces a recording so long
+ * as each thread makes the same calls to the wrappers in the same order, and
+ * threads make their first decisions in the same order as they did when
+ * recorded; after that, the interleaving between threads does not matter.
+ *
+ * Threads which race to their first decision may be given one another's
+ * decisions on replay: every thread's decisions are replayed in full, each by
+ * one thread, but not necessarily by the thread which made them. This is of
+ * no consequence for threads making the same calls, such as a pool of like
+ * workers. Otherwise, a program ought to start its threads one at a time,
+ * each making its first call to the wrappers before the next is started.
+ *
+ * The environment otherwise ought to be as it was, since $GREAT_SUBSETS and
+ * $GREAT_SIZES decide which calls reach great_schedule() at all. Where a
+ * replay finds a decision recorded for some other function, it is logged once
+ * per thread, and the call defaults.
+ *
+ * The file is mapped, and written in place as decisions are made, so that a
+ * recording survives the process crashing. It is GREAT_DECISION_FILE bytes
+ * (sparsely, where the filesystem permits), and starts with a header of
+ * GREAT_DECISION_HEADER bytes:
+ *
+ *	GREAT_DECISION_MAGIC, then the subset path of each function by ID,
+ *	each terminated by a newline, then zeroes
+ *
+ * where the last eight bytes of the header give the offset past the last chunk
+ * (uint64_t), followed by chunks of GREAT_DECISION_CHUNK bytes, each holding
+ * events from one thread:
+ *
+ *	thread (uint32_t, from 1), used (uint32_t, bytes of events),
+ *	next (uint64_t, offset of the thread's next chunk, or 0), events
+ *
+ * in the host's byte order. A chunk with a thread of 0 was never begun.
+ * Events are unsigned LEB128 varints:
+ *
+ *	2 * decisions since the previous interception, function ID
+ *	1, a value drawn once intercepted
+ *
+ * Recording and replay are not continued in children forked by the
+ * application, whose decisions are made afresh. Descendants which exec() with
+ * the same environment record over the same file, and so ought to be given
+ * another.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_DECISION_H
+#define GREAT_SHARED_DECISION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define GREAT_DECISION_MAGIC "GREATDECIDE1\n"
+
+#define GREAT_DECISION_FILE   ((uint64_t) 64 * 1024 * 1024)
+#define GREAT_DECISION_HEADER 8192
+#define GREAT_DECISION_CHUNK  4096
+
+/* The offset within the header of the offset past the last chunk */
+#define GREAT_DECISION_END (GREAT_DECISION_HEADER - sizeof (uint64_t))
+
+/* The start of each chunk, as described above */
+struct great_decision_chunk {
+	uint32_t thread;
+	uint32_t used;
+	uint64_t next;
+};
+
+/* The bytes of events a chunk holds */
+#define GREAT_DECISION_ROOM \
+	(GREAT_DECISION_CHUNK - sizeof (struct great_decision_chunk))
+
+/* The most bytes an event may take: two 64-bit varints */
+#define GREAT_DECISION_EVENT (2 * 10)
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private; a
+ * zeroed state has yet to make a decision.
+ */
+struct great_decision {
+	unsigned long thread;	/* ordinal, or 0 */
+	uint64_t calls;	/* decisions so far */
+	uint64_t last;	/* calls at the last interception */
+
+	/* Recording; the chunk being filled, or NULL */
+	unsigned char *chunk;
+
+	/* Replay; the current chunk, and the events remaining in it */
+	const unsigned char *from;
+	const unsigned char *p;
+	const unsigned char *end;
+	bool read;	/* next and id hold the next interception */
+	uint64_t next;	/* calls at the next interception, or 0 for none */
+	unsigned long id;	/* as recorded */
+	bool diverged;
+};
+
+extern bool great_decision_recording;
+extern bool great_decision_replaying;
+
+/*
+ * Initialise from $GREAT_RECORD or $GREAT_REPLAY. This must be called before
+ * use, and before great_decision_function().
+ */
+void
+great_decision_init(void);
+
+/*
+ * Give an ID for the function with the given subset path. This is to be called
+ * for every function, in the same order for a replay as for its recording.
+ */
+unsigned long
+great_decision_function(const char *path);
+
+/*
+ * Record a decision for the function with the given ID.
+ */
+void
+great_decision_record(unsigned long id, bool intercept);
+
+/*
+ * Return the decision recorded for the function with the given ID.
+ */
+bool
+great_decision_replay(unsigned long id);
+
+/*
+ * Record a value drawn once a call has been intercepted.
+ */
+void
+great_decision_note(uint64_t v);
+
+/*
+ * Give the next value recorded for the calling thread, if there is one.
+ * Returns false where the PRNG is to be drawn from instead.
+ */
+bool
+great_decision_value(uint64_t *v);
+
+#endif
@@ -0,0 +1,256 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Record and replay of decisions. This is run once to record to a file, then
+ * again to replay it, and again to replay a damaged copy:
+ *
+ *	decision_test record <file>
+ *	decision_test replay <file>
+ *	decision_test damage <file> <copy>
+ *	decision_test damaged <copy>
+ *
+ * Given "free" after the file, threads start together in no fixed order, and
+ * so may be given one another's decisions on replay; each is to replay some
+ * thread's decisions in full, and no two the same thread's.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() and pthread_barrier_wait() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "decision.h"
+#include "context.h"
+#include "log.h"
+
+#define THREADS 3
+#define CALLS   5000
+
+static enum { RECORD, REPLAY, DAMAGED } mode;
+
+static unsigned long id[2];
+static unsigned int turn;
+
+static bool free_;	/* threads start in no fixed order */
+static pthread_barrier_t barrier;
+static unsigned long replayed[THREADS];	/* the thread each replays, by value */
+
+static bool
+expected(unsigned long t, unsigned long i)
+{
+	return (i * (t + 1)) % 7 == 0;
+}
+
+static void *
+worker(void *arg)
+{
+	unsigned long t = (unsigned long) (uintptr_t) arg;
+	unsigned long i;
+	unsigned long f;
+	uint64_t v;
+	bool b;
+
+	if (free_) {
+		/* All decide one function, whichever thread they replay */
+		f = id[0];
+		(void) pthread_barrier_wait(&barrier);
+	} else {
+		/* Threads are known by the order of their first decisions */
+		f = id[t % 2];
+		while (__atomic_load_n(&turn, __ATOMIC_ACQUIRE) != t) {
+			continue;
+		}
+	}
+
+	for (i = 0; i < CALLS; i++) {
+		switch (mode) {
+		case RECORD:
+			b = expected(t, i);
+			great_decision_record(f, b);
+			if (b) {
+				great_decision_note(i * 31 + t);
+			}
+			break;
+
+		case REPLAY:
+			b = great_decision_replay(f);
+
+			/* Every thread intercepts its first call */
+			if (i == 0) {
+				assert(b && great_decision_value(&v));
+				assert(v < THREADS);
+				replayed[t] = (unsigned long) v;
+				assert(free_ || replayed[t] == t);
+			} else if (b) {
+				assert(great_decision_value(&v));
+				assert(v == i * 31 + replayed[t]);
+			}
+
+			assert(b == expected(replayed[t], i));
+
+			/* Nothing more was drawn */
+			assert(!great_decision_value(&v));
+			break;
+
+		case DAMAGED:
+			if (great_decision_replay(id[t % 2])) {
+				(void) great_decision_value(&v);
+			}
+			break;
+		}
+
+		if (i == 0) {
+			__atomic_store_n(&turn, t + 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Write a copy of a recording cut short part way through a chunk, claiming to
+ * be longer than it is, with a chunk claiming an impossible thread and a link
+ * leading backwards.
+ */
+static void
+damage(const char *from, const char *to)
+{
+	static unsigned char buf[GREAT_DECISION_HEADER + 4 * GREAT_DECISION_CHUNK];
+	uint64_t end;
+	uint32_t thread;
+	uint64_t next;
+	size_t n;
+	FILE *f;
+
+	f = fopen(from, "rb");
+	assert(f);
+	n = fread(buf, 1, sizeof buf, f);
+	assert(n == sizeof buf);
+	(void) fclose(f);
+
+	end = GREAT_DECISION_FILE;
+	memcpy(buf + GREAT_DECISION_HEADER - sizeof end, &end, sizeof end);
+
+	thread = 0xffffffffu;
+	memcpy(buf + GREAT_DECISION_HEADER + GREAT_DECISION_CHUNK, &thread,
+		sizeof thread);
+
+	next = GREAT_DECISION_HEADER;
+	memcpy(buf + GREAT_DECISION_HEADER + 2 * GREAT_DECISION_CHUNK
+		+ offsetof(struct great_decision_chunk, next), &next,
+		sizeof next);
+
+	f = fopen(to, "wb");
+	assert(f);
+	n = fwrite(buf, 1, sizeof buf - GREAT_DECISION_CHUNK / 2, f);
+	assert(n == sizeof buf - GREAT_DECISION_CHUNK / 2);
+	(void) fclose(f);
+}
+
+int
+main(int argc, char *argv[])
+{
+	pthread_t t[THREADS];
+	unsigned long i;
+
+	if (argc == 4 && 0 == strcmp(argv[1], "damage")) {
+		damage(argv[2], argv[3]);
+		return EXIT_SUCCESS;
+	}
+
+	if (argc == 4 && 0 == strcmp(argv[3], "free")) {
+		free_ = true;
+		argc--;
+	}
+
+	if (argc != 3) {
+		fputs("usage: decision_test record|replay|damaged <file> "
+			"[free]\n", stderr);
+		return EXIT_FAILURE;
+	}
+
+	if (0 == strcmp(argv[1], "record")) {
+		mode = RECORD;
+		setenv("GREAT_RECORD", argv[2], 1);
+	} else {
+		mode = 0 == strcmp(argv[1], "replay") ? REPLAY : DAMAGED;
+		setenv("GREAT_REPLAY", argv[2], 1);
+	}
+
+	great_log_init("decision_test", NULL);
+	great_context_init();
+	great_decision_init();
+
+	assert(mode == RECORD ? great_decision_recording : great_decision_replaying);
+
+	id[0] = great_decision_function("test:decision:a");
+	id[1] = great_decision_function("test:decision:b");
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&t[i], NULL, worker, (void *) (uintptr_t) i)) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		(void) pthread_join(t[i], NULL);
+	}
+
+	/* No two threads replay the same thread's decisions */
+	for (i = 0; mode == REPLAY && i < THREADS; i++) {
+		unsigned long j;
+
+		for (j = i + 1; j < THREADS; j++) {
+			assert(replayed[i] != replayed[j]);
+		}
+	}
+
+	great_log_fini();
+
+	printf("decision_test: %s%s passed\n", argv[1], free_ ? " free" : "");
+
+	return EXIT_SUCCESS;
+}
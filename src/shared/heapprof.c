@@ -0,0 +1,645 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sampling heap profiler.
+ *
+ * Samples are kept in two tables, both mapped rather than malloc()ed, and
+ * both of fixed size:
+ *
+ *  - Buckets, one per unique stack, which hold counts of objects and bytes
+ *    allocated and in use. These are only ever added to.
+ *
+ *  - Live samples, an open-addressing hash of pointers to the bucket and size
+ *    of each sampled allocation which has not yet been freed. Deletion is by
+ *    backward shifting, so there are no tombstones.
+ *
+ * Both are modified only whilst holding a spinlock; contention for this is
+ * rare, since it is taken only when sampling, and when freeing a sample.
+ *
+ * Every call to free() must find whether its pointer was sampled. This is
+ * done without the lock, guarded by a sequence count which is odd whilst the
+ * live table is being modified, and which changes with every modification.
+ * If the sequence count changes during a lookup, the lookup is retried with
+ * the lock held.
+ *
+ * If either table is full, further samples are dropped, and this is logged at
+ * exit.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "heapprof.h"
+#include "context.h"
+#include "out.h"
+#include "log.h"
+#include "../clock.h"
+#include "../map.h"
+#include "../proc.h"
+#include "../io.h"
+
+#define BUCKETS 8192	/* power of two */
+#define SAMPLES 65536	/* power of two */
+
+struct bucket {
+	uint64_t hash;
+	size_t depth;	/* 0 for an unused bucket */
+	void *pc[GREAT_HEAPPROF_DEPTH];
+
+	uint64_t inuse_objs;
+	uint64_t inuse_bytes;
+	uint64_t alloc_objs;
+	uint64_t alloc_bytes;
+};
+
+struct sample {
+	void *ptr;	/* NULL for an unused slot */
+	size_t size;
+	struct bucket *bucket;
+};
+
+bool great_heapprof_enabled;
+
+static const char *prefix;
+static uint64_t rate;
+
+static struct bucket *buckets;
+static struct sample *samples;
+static size_t nsamples;
+static unsigned long dropped;
+
+static int lock;
+static unsigned long seq;	/* sequence count for samples[] */
+static int pending;	/* a signal arrived whilst the lock was held */
+static unsigned long dumps;	/* files written so far */
+
+static void
+spinlock(void)
+{
+	while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+		;
+}
+
+static bool
+trylock(void)
+{
+	return !__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE);
+}
+
+static void
+unlock(void)
+{
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+}
+
+/*
+ * The sequence count brackets modifications to samples[]. The lock must be
+ * held.
+ */
+static void
+modifying(void)
+{
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+modified(void)
+{
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static size_t
+home(const void *ptr)
+{
+	uint64_t h;
+
+	h = (uint64_t) (uintptr_t) ptr;
+	h = (h >> 4) * (uint64_t) 0x9e3779b97f4a7c15ULL;
+
+	return (size_t) (h >> 32) & (SAMPLES - 1);
+}
+
+/*
+ * Find the slot for ptr in samples[], or return -1 if it is not present.
+ * This may be called without the lock held; see lookup().
+ */
+static long
+find(const void *ptr)
+{
+	size_t i;
+
+	for (i = home(ptr); ; i = (i + 1) & (SAMPLES - 1)) {
+		void *p;
+
+		p = __atomic_load_n(&samples[i].ptr, __ATOMIC_RELAXED);
+		if (p == ptr) {
+			return (long) i;
+		}
+
+		if (!p) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Remove the sample in slot i, shifting back any following entries which
+ * would otherwise become unreachable. The lock must be held.
+ */
+static void
+delete(size_t i)
+{
+	size_t j;
+
+	assert(samples[i].ptr);
+
+	modifying();
+
+	for (j = (i + 1) & (SAMPLES - 1); samples[j].ptr; j = (j + 1) & (SAMPLES - 1)) {
+		size_t k;
+
+		k = home(samples[j].ptr);
+
+		/* may slot j's entry move back to the hole at i? */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+
+		samples[i].size   = samples[j].size;
+		samples[i].bucket = samples[j].bucket;
+		__atomic_store_n(&samples[i].ptr, samples[j].ptr, __ATOMIC_RELAXED);
+		i = j;
+	}
+
+	__atomic_store_n(&samples[i].ptr, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&nsamples, nsamples - 1, __ATOMIC_RELAXED);
+
+	modified();
+}
+
+/*
+ * Account for the sample in slot i being freed. The lock must be held.
+ */
+static void
+release(size_t i)
+{
+	struct bucket *b;
+
+	b = samples[i].bucket;
+	assert(b);
+
+	b->inuse_objs--;
+	b->inuse_bytes -= samples[i].size;
+
+	delete(i);
+}
+
+static struct bucket *
+bucket(void **pc, size_t depth)
+{
+	uint64_t h;
+	size_t i, n;
+
+	assert(depth > 0);
+
+	h = 14695981039346656037ULL;
+	for (i = 0; i < depth; i++) {
+		h = (h ^ (uint64_t) (uintptr_t) pc[i]) * 1099511628211ULL;
+	}
+
+	for (i = h & (BUCKETS - 1), n = 0; n < BUCKETS; i = (i + 1) & (BUCKETS - 1), n++) {
+		struct bucket *b = &buckets[i];
+
+		if (0 == b->depth) {
+			b->hash  = h;
+			b->depth = depth;
+			memcpy(b->pc, pc, depth * sizeof *pc);
+			return b;
+		}
+
+		if (b->hash == h && b->depth == depth
+		&& 0 == memcmp(b->pc, pc, depth * sizeof *pc)) {
+			return b;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * xorshift64*; this is kept apart from random.c's generators so that
+ * sampling does not perturb the sequence of interception decisions.
+ */
+static uint64_t
+xorshift(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * (uint64_t) 2685821657736338717ULL;
+}
+
+/*
+ * An approximation to log2(r) for r > 0, sufficient for choosing sampling
+ * distances. This avoids a dependency on libm, which the application may not
+ * have loaded.
+ */
+static double
+log2approx(uint64_t r)
+{
+	unsigned int k;
+	double m;
+
+	assert(r > 0);
+
+	for (k = 0; r >> k > 1; k++)
+		;
+
+	/* m is in [1, 2) */
+	m = (double) r / (double) ((uint64_t) 1 << k);
+
+	return k - 1.7417939 + (2.8212026 + (-1.4699568
+		+ (0.44717955 - 0.056570851 * m) * m) * m) * m;
+}
+
+/*
+ * Draw the distance to the next sample from an exponential distribution with
+ * mean rate: -ln(U) * rate for U uniform on (0, 1].
+ */
+static uint64_t
+distance(struct great_heapprof *hp)
+{
+	uint64_t r;
+	double d;
+
+	assert(hp);
+
+	r = (xorshift(&hp->rng) >> 11) | 1;	/* 53 bits, non-zero */
+	d = (53.0 - log2approx(r)) * 0.6931471805599453 * (double) rate;
+
+	return (uint64_t) d + 1;
+}
+
+static void
+dump(void)
+{
+	char path[4096];
+	struct great_out out;
+	uint64_t inuse_objs, inuse_bytes, alloc_objs, alloc_bytes;
+	size_t i;
+
+	if (!great_out_name(path, sizeof path, prefix, great_pid(),
+		__atomic_fetch_add(&dumps, 1, __ATOMIC_RELAXED), "heap")) {
+		return;
+	}
+
+	if (!great_out_open(&out, path)) {
+		return;
+	}
+
+	inuse_objs = inuse_bytes = alloc_objs = alloc_bytes = 0;
+	for (i = 0; i < BUCKETS; i++) {
+		inuse_objs  += buckets[i].inuse_objs;
+		inuse_bytes += buckets[i].inuse_bytes;
+		alloc_objs  += buckets[i].alloc_objs;
+		alloc_bytes += buckets[i].alloc_bytes;
+	}
+
+	great_out_str(&out, "heap profile: ");
+	great_out_ulong(&out, inuse_objs, 10);
+	great_out_str(&out, ": ");
+	great_out_ulong(&out, inuse_bytes, 10);
+	great_out_str(&out, " [");
+	great_out_ulong(&out, alloc_objs, 10);
+	great_out_str(&out, ": ");
+	great_out_ulong(&out, alloc_bytes, 10);
+	great_out_str(&out, "] @ heap_v2/");
+	great_out_ulong(&out, rate, 10);
+	great_out_str(&out, "\n");
+
+	for (i = 0; i < BUCKETS; i++) {
+		const struct bucket *b = &buckets[i];
+		size_t j;
+
+		if (0 == b->depth) {
+			continue;
+		}
+
+		great_out_ulong(&out, b->inuse_objs, 10);
+		great_out_str(&out, ": ");
+		great_out_ulong(&out, b->inuse_bytes, 10);
+		great_out_str(&out, " [");
+		great_out_ulong(&out, b->alloc_objs, 10);
+		great_out_str(&out, ": ");
+		great_out_ulong(&out, b->alloc_bytes, 10);
+		great_out_str(&out, "] @");
+
+		for (j = 0; j < b->depth; j++) {
+			great_out_str(&out, " 0x");
+			great_out_ulong(&out, (unsigned long) (uintptr_t) b->pc[j], 16);
+		}
+
+		great_out_str(&out, "\n");
+	}
+
+	great_out_str(&out, "\nMAPPED_LIBRARIES:\n");
+	great_out_flush(&out);
+	great_maps(out.fd);
+
+	(void) great_out_close(&out);
+}
+
+static void
+handler(int sig)
+{
+	int e;
+
+	(void) sig;
+
+	/* the interrupted thread may hold the lock; if so, it dumps for us */
+	e = errno;
+	if (trylock()) {
+		dump();
+		unlock();
+	} else {
+		__atomic_store_n(&pending, 1, __ATOMIC_RELAXED);
+	}
+	errno = e;
+}
+
+static void
+unlockpending(void)
+{
+	if (!__atomic_exchange_n(&pending, 0, __ATOMIC_RELAXED)) {
+		unlock();
+		return;
+	}
+
+	dump();
+	unlock();
+}
+
+/*
+ * The lock is held across fork(), so that the child's tables are consistent.
+ * A dump requested meanwhile is made by the parent.
+ */
+static void
+prepare(void)
+{
+	spinlock();
+}
+
+static void
+parent(void)
+{
+	unlockpending();
+}
+
+static void
+child(void)
+{
+	__atomic_store_n(&pending, 0, __ATOMIC_RELAXED);
+	unlock();
+}
+
+void
+great_heapprof_init(void)
+{
+	const char *s;
+	void *pc[1];
+
+	prefix = getenv("GREAT_HEAP_PROFILE");
+	if (!prefix || 0 == strlen(prefix)) {
+		return;
+	}
+
+	rate = 524288;
+
+	s = getenv("GREAT_HEAP_SAMPLE");
+	if (s && strlen(s) > 0) {
+		char *ep;
+		unsigned long l;
+
+		errno = 0;
+		l = strtoul(s, &ep, 10);
+		if (*ep != '\0' || 0 == l || ERANGE == errno) {
+			great_log(GREAT_LOG_ERROR, "GREAT_HEAP_SAMPLE",
+				"Invalid sampling interval: \"%s\"; disregarding", s);
+		} else {
+			rate = l;
+		}
+	}
+
+	buckets = great_map(BUCKETS * sizeof *buckets);
+	samples = great_map(SAMPLES * sizeof *samples);
+	if (!buckets || !samples) {
+		great_log(GREAT_LOG_ERROR, "GREAT_HEAP_PROFILE",
+			"Unable to map tables; profiling disabled");
+		return;
+	}
+
+	/* The first backtrace may allocate; get that out of the way */
+	(void) great_backtrace(pc, 1, 0);
+
+	if (!great_atfork(prepare, parent, child)) {
+		great_log(GREAT_LOG_ERROR, "GREAT_HEAP_PROFILE",
+			"Unable to handle fork(); profiling disabled");
+		return;
+	}
+
+	s = getenv("GREAT_HEAP_SIGNAL");
+	if (s && strlen(s) > 0) {
+		int sig;
+
+		sig = atoi(s);
+		if (sig <= 0 || !great_signal(sig, handler)) {
+			great_log(GREAT_LOG_ERROR, "GREAT_HEAP_SIGNAL",
+				"Unable to handle signal \"%s\"; disregarding", s);
+		}
+	}
+
+	great_heapprof_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_HEAP_PROFILE",
+		"Sampling every %lu bytes on average to %s",
+		(unsigned long) rate, prefix);
+}
+
+void
+great_heapprof_malloc(struct great_context *ctx, size_t size, void *p,
+	const void *caller)
+{
+	struct great_heapprof *hp;
+	void *pc[GREAT_HEAPPROF_DEPTH];
+	size_t depth;
+	struct bucket *b;
+	size_t i;
+	long l;
+
+	assert(ctx);
+
+	if (!p) {
+		return;
+	}
+
+	hp = &ctx->heapprof;
+
+	if (size < hp->until) {
+		hp->until -= size;
+		return;
+	}
+
+	/* A new context starts with no distance chosen */
+	if (0 == hp->rng) {
+		hp->rng = great_clock() ^ (uint64_t) (uintptr_t) ctx;
+		hp->rng |= 1;
+		hp->until = distance(hp);
+
+		if (size < hp->until) {
+			hp->until -= size;
+			return;
+		}
+	}
+
+	hp->until = distance(hp);
+
+	/*
+	 * Skip our own frames, up to the wrapper's caller. These are found by
+	 * address rather than counted, since they may have been inlined.
+	 */
+	depth = great_backtrace(pc, GREAT_HEAPPROF_DEPTH, 0);
+	for (i = 0; i < depth && pc[i] != caller; i++)
+		;
+	if (i < depth) {
+		memmove(pc, pc + i, (depth - i) * sizeof *pc);
+		depth -= i;
+	}
+	if (0 == depth) {
+		pc[0] = NULL;
+		depth = 1;
+	}
+
+	spinlock();
+
+	b = bucket(pc, depth);
+	if (!b || nsamples + 1 > SAMPLES / 4 * 3) {
+		dropped++;
+		unlockpending();
+		return;
+	}
+
+	b->alloc_objs++;
+	b->alloc_bytes += size;
+	b->inuse_objs++;
+	b->inuse_bytes += size;
+
+	/* An earlier free may have been missed, and the address reused */
+	l = find(p);
+	if (l != -1) {
+		release((size_t) l);
+	}
+
+	modifying();
+
+	for (i = home(p); samples[i].ptr; i = (i + 1) & (SAMPLES - 1))
+		;
+
+	samples[i].size   = size;
+	samples[i].bucket = b;
+	__atomic_store_n(&samples[i].ptr, p, __ATOMIC_RELAXED);
+	__atomic_store_n(&nsamples, nsamples + 1, __ATOMIC_RELAXED);
+
+	modified();
+
+	unlockpending();
+}
+
+void
+great_heapprof_free(void *ptr)
+{
+	unsigned long s1, s2;
+	long i;
+
+	if (!ptr) {
+		return;
+	}
+
+	if (0 == __atomic_load_n(&nsamples, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	s1 = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+	if (0 == (s1 & 1)) {
+		i = find(ptr);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+
+		if (s1 == s2 && -1 == i) {
+			return;
+		}
+	}
+
+	spinlock();
+
+	i = find(ptr);
+	if (i != -1) {
+		release((size_t) i);
+	}
+
+	unlockpending();
+}
+
+void
+great_heapprof_report(void)
+{
+	spinlock();
+	dump();
+	unlock();
+
+	if (dropped > 0) {
+		great_log(GREAT_LOG_ERROR, "GREAT_HEAP_PROFILE",
+			"%lu samples dropped; tables full", dropped);
+	}
+}
+
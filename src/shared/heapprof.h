@@ -0,0 +1,108 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sampling heap profiler.
+ *
+ * When $GREAT_HEAP_PROFILE is set to a path prefix, allocations are sampled
+ * by the number of bytes allocated: the distance in bytes between samples is
+ * drawn from an exponential distribution with a mean given by
+ * $GREAT_HEAP_SAMPLE (default 524288), as tcmalloc does. Large allocations are
+ * therefore more likely to be sampled than small ones, and the cost for most
+ * allocations is a single subtraction.
+ *
+ * For each sample, the stack at the point of allocation is recorded, and the
+ * sample is tracked until it is freed. Profiles of the space in use, and of
+ * the space allocated in total, are written in the legacy pprof heap format
+ * (heap_v2, which pprof scales to account for sampling) to files named
+ * "prefix.pid.seq.heap". These are written at exit, and also on receipt of
+ * the signal number given by $GREAT_HEAP_SIGNAL, if set.
+ *
+ * For example:
+ *
+ *	GREAT_HEAP_PROFILE=/tmp/app GREAT_SUBSETS= LD_PRELOAD=... ./app
+ *	pprof -sample_index=inuse_space ./app /tmp/app.1234.0.heap
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_HEAPPROF_H
+#define GREAT_SHARED_HEAPPROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The maximum number of stack frames recorded per sample.
+ */
+#define GREAT_HEAPPROF_DEPTH 32
+
+struct great_context;
+
+/*
+ * Per-thread sampling state, kept in struct great_context. Consider these
+ * private.
+ */
+struct great_heapprof {
+	uint64_t until;	/* bytes remaining until the next sample */
+	uint64_t rng;	/* PRNG state for sampling distances */
+};
+
+extern bool great_heapprof_enabled;
+
+/*
+ * Initialise from the environment. This must be called before use.
+ */
+void
+great_heapprof_init(void);
+
+/*
+ * Account for an allocation of size bytes at p, which may be sampled. The
+ * stack recorded starts from caller; see GREAT_WRAP_CALLER() in src/wrap.h.
+ */
+void
+great_heapprof_malloc(struct great_context *ctx, size_t size, void *p,
+	const void *caller);
+
+/*
+ * Account for ptr being freed. This is cheap when ptr was not sampled.
+ */
+void
+great_heapprof_free(void *ptr);
+
+/*
+ * Write a profile for the samples taken so far.
+ */
+void
+great_heapprof_report(void);
+
+#endif
+
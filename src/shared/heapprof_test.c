@@ -0,0 +1,162 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Sampling heap profiler. This sets $GREAT_HEAP_PROFILE itself, and samples
+ * every byte, so that the profile's totals are exact.
+ *
+ * Blocks are allocated by the real allocator from several threads, and
+ * reported as the wrappers would report them (see alloc.h).
+ *
+ * $Id$
+ */
+
+/* Required for setenv() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "alloc.h"
+#include "heapprof.h"
+#include "log.h"
+#include "../proc.h"
+
+#define PREFIX  "heapprof_test"
+#define THREADS 4
+#define CALLS   1000
+#define SIZE    64
+
+static void *blocks[THREADS][CALLS];
+
+/*
+ * Allocate CALLS blocks, and free every other one.
+ */
+static void *
+allocate(void *arg)
+{
+	void **p = arg;
+	size_t i;
+
+	for (i = 0; i < CALLS; i++) {
+		p[i] = malloc(SIZE);
+		assert(p[i]);
+
+		great_alloc_malloc(SIZE, p[i], NULL);
+	}
+
+	for (i = 0; i < CALLS; i += 2) {
+		great_alloc_free(p[i]);
+		free(p[i]);
+		p[i] = NULL;
+	}
+
+	return NULL;
+}
+
+int
+main(void)
+{
+	pthread_t tid[THREADS];
+	unsigned long inuse_objs, inuse_bytes, alloc_objs, alloc_bytes, rate;
+	char path[64];
+	char line[256];
+	bool mapped;
+	size_t i, j;
+	FILE *f;
+
+	if (-1 == setenv("GREAT_HEAP_PROFILE", PREFIX, 1)
+	|| -1 == setenv("GREAT_HEAP_SAMPLE", "1", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("heapprof_test", NULL);
+	great_alloc_init();
+	assert(great_heapprof_enabled);
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, allocate, blocks[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	great_heapprof_report();
+
+	sprintf(path, "%s.%lu.0.heap", PREFIX, great_pid());
+
+	f = fopen(path, "r");
+	assert(f);
+
+	assert(fgets(line, sizeof line, f));
+	assert(5 == sscanf(line, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu",
+		&inuse_objs, &inuse_bytes, &alloc_objs, &alloc_bytes, &rate));
+
+	assert(rate == 1);
+	assert(alloc_objs  == THREADS * CALLS);
+	assert(alloc_bytes == THREADS * CALLS * SIZE);
+	assert(inuse_objs  == THREADS * CALLS / 2);
+	assert(inuse_bytes == THREADS * CALLS / 2 * SIZE);
+
+	mapped = false;
+	while (fgets(line, sizeof line, f)) {
+		mapped = mapped || 0 == strcmp(line, "MAPPED_LIBRARIES:\n");
+	}
+	assert(mapped);
+
+	fclose(f);
+	(void) remove(path);
+
+	for (i = 0; i < THREADS; i++) {
+		for (j = 0; j < CALLS; j++) {
+			if (blocks[i][j]) {
+				great_alloc_free(blocks[i][j]);
+				free(blocks[i][j]);
+			}
+		}
+	}
+
+	printf("heapprof_test: %lu sampled, %lu in use\n", alloc_objs, inuse_objs);
+
+	return EXIT_SUCCESS;
+}
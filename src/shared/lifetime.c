@@ -0,0 +1,493 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation lifetime profiling.
+ *
+ * Sampled allocations are kept in a fixed-size open-addressing table of
+ * pointers, mapped rather than malloc()ed, with deletion by backward shifting.
+ * As for heapprof.c, the table is modified only whilst holding a spinlock, and
+ * free() looks up pointers without the lock, guarded by a sequence count.
+ * Histograms are updated under the same lock; since only sampled frees reach
+ * them, contention for it is rare.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "lifetime.h"
+#include "context.h"
+#include "log.h"
+#include "../clock.h"
+#include "../map.h"
+
+#define SAMPLES 65536	/* power of two */
+#define SIZES 65	/* as for GREAT_ALLOCSTATS_SIZES */
+#define DECADES 9	/* histogram buckets, by power of ten */
+
+struct sample {
+	void *ptr;	/* NULL for an unused slot */
+	uint64_t time;	/* great_clock() at allocation */
+	uint64_t allocs;	/* allocation count at allocation */
+	unsigned int size;	/* size class */
+};
+
+bool great_lifetime_enabled;
+
+static uint64_t interval;
+
+static struct sample *samples;
+static size_t nsamples;
+static unsigned long dropped;
+
+static int lock;
+static unsigned long seq;	/* sequence count for samples[] */
+
+/* Published allocation count; see GREAT_LIFETIME_BATCH */
+static uint64_t allocs;
+
+/* Histograms, by size class. The lock must be held to update these */
+static uint64_t sampled[SIZES];
+static uint64_t ns[SIZES][DECADES];	/* from < 1us */
+static uint64_t intervening[SIZES][DECADES];	/* from < 1 */
+
+static void
+spinlock(void)
+{
+	while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void
+unlock(void)
+{
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+}
+
+static void
+modifying(void)
+{
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+modified(void)
+{
+	__atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+static unsigned int
+sizeclass(size_t size)
+{
+	unsigned int n;
+
+	for (n = 0; size > 0; size >>= 1) {
+		n++;
+	}
+
+	assert(n < SIZES);
+
+	return n;
+}
+
+/*
+ * Return the histogram bucket for n, where bucket i counts values below
+ * base * 10^i, and the last bucket counts everything else.
+ */
+static unsigned int
+decade(uint64_t n, uint64_t base)
+{
+	unsigned int i;
+
+	for (i = 0; i < DECADES - 1; i++) {
+		if (n < base) {
+			break;
+		}
+
+		base *= 10;
+	}
+
+	return i;
+}
+
+static size_t
+home(const void *ptr)
+{
+	uint64_t h;
+
+	h = (uint64_t) (uintptr_t) ptr;
+	h = (h >> 4) * (uint64_t) 0x9e3779b97f4a7c15ULL;
+
+	return (size_t) (h >> 32) & (SAMPLES - 1);
+}
+
+/*
+ * Find the slot for ptr in samples[], or return -1 if it is not present.
+ * This may be called without the lock held; see great_lifetime_free().
+ */
+static long
+find(const void *ptr)
+{
+	size_t i;
+
+	for (i = home(ptr); ; i = (i + 1) & (SAMPLES - 1)) {
+		void *p;
+
+		p = __atomic_load_n(&samples[i].ptr, __ATOMIC_RELAXED);
+		if (p == ptr) {
+			return (long) i;
+		}
+
+		if (!p) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Remove the sample in slot i, shifting back any following entries which
+ * would otherwise become unreachable. The lock must be held.
+ */
+static void
+delete(size_t i)
+{
+	size_t j;
+
+	assert(samples[i].ptr);
+
+	modifying();
+
+	for (j = (i + 1) & (SAMPLES - 1); samples[j].ptr; j = (j + 1) & (SAMPLES - 1)) {
+		size_t k;
+
+		k = home(samples[j].ptr);
+
+		/* may slot j's entry move back to the hole at i? */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+
+		samples[i].time   = samples[j].time;
+		samples[i].allocs = samples[j].allocs;
+		samples[i].size   = samples[j].size;
+		__atomic_store_n(&samples[i].ptr, samples[j].ptr, __ATOMIC_RELAXED);
+		i = j;
+	}
+
+	__atomic_store_n(&samples[i].ptr, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&nsamples, nsamples - 1, __ATOMIC_RELAXED);
+
+	modified();
+}
+
+/*
+ * The count of allocations made by all threads, as seen by this one.
+ */
+static uint64_t
+now(const struct great_context *ctx)
+{
+	return __atomic_load_n(&allocs, __ATOMIC_RELAXED)
+		+ (ctx ? ctx->lifetime.allocs : 0);
+}
+
+/*
+ * Record the lifetime of the sample in slot i, and remove it. The lock must be
+ * held.
+ */
+static void
+expire(size_t i, uint64_t time, uint64_t count)
+{
+	const struct sample *s = &samples[i];
+
+	ns[s->size][decade(time - s->time, 1000)]++;
+	intervening[s->size][decade(count > s->allocs ? count - s->allocs : 0, 1)]++;
+
+	delete(i);
+}
+
+/*
+ * xorshift64*, kept apart from random.c's generators so that sampling does
+ * not perturb the sequence of interception decisions.
+ */
+static uint64_t
+xorshift(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+
+	return x * (uint64_t) 2685821657736338717ULL;
+}
+
+/*
+ * Intervals between samples are uniform on [1, 2 * interval - 1], so that
+ * periodic patterns of allocation are not sampled at the same point.
+ */
+static uint64_t
+next(struct great_lifetime *lt)
+{
+	return 1 + xorshift(&lt->rng) % (2 * interval - 1);
+}
+
+void
+great_lifetime_init(void)
+{
+	const char *s;
+
+	s = getenv("GREAT_LIFETIME");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	interval = 100;
+
+	if (strspn(s, "0123456789") == strlen(s)) {
+		unsigned long l;
+
+		errno = 0;
+		l = strtoul(s, NULL, 10);
+		if (0 == l || ERANGE == errno) {
+			great_log(GREAT_LOG_ERROR, "GREAT_LIFETIME",
+				"Invalid sampling interval: \"%s\"; disregarding", s);
+		} else {
+			interval = l;
+		}
+	}
+
+	samples = great_map(SAMPLES * sizeof *samples);
+	if (!samples) {
+		great_log(GREAT_LOG_ERROR, "GREAT_LIFETIME",
+			"Unable to map table; profiling disabled");
+		return;
+	}
+
+	great_lifetime_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+		"Sampling one in %lu allocations on average",
+		(unsigned long) interval);
+}
+
+void
+great_lifetime_malloc(struct great_context *ctx, size_t size, void *p)
+{
+	struct great_lifetime *lt;
+	uint64_t count;
+	long l;
+	size_t i;
+
+	assert(ctx);
+
+	if (!p) {
+		return;
+	}
+
+	lt = &ctx->lifetime;
+
+	lt->allocs++;
+	count = now(ctx);
+
+	if (lt->allocs >= GREAT_LIFETIME_BATCH) {
+		__atomic_add_fetch(&allocs, lt->allocs, __ATOMIC_RELAXED);
+		lt->allocs = 0;
+	}
+
+	/* A new context starts with no interval chosen */
+	if (0 == lt->rng) {
+		lt->rng = great_clock() ^ (uint64_t) (uintptr_t) ctx;
+		lt->rng |= 1;
+		lt->until = next(lt);
+	}
+
+	if (--lt->until > 0) {
+		return;
+	}
+
+	lt->until = next(lt);
+
+	spinlock();
+
+	/* An earlier free may have been missed, and the address reused */
+	l = find(p);
+	if (l != -1) {
+		delete((size_t) l);
+	}
+
+	if (nsamples + 1 > SAMPLES / 4 * 3) {
+		dropped++;
+		unlock();
+		return;
+	}
+
+	modifying();
+
+	for (i = home(p); samples[i].ptr; i = (i + 1) & (SAMPLES - 1))
+		;
+
+	samples[i].time   = great_clock();
+	samples[i].allocs = count;
+	samples[i].size   = sizeclass(size);
+	__atomic_store_n(&samples[i].ptr, p, __ATOMIC_RELAXED);
+	__atomic_store_n(&nsamples, nsamples + 1, __ATOMIC_RELAXED);
+
+	sampled[samples[i].size]++;
+
+	modified();
+
+	unlock();
+}
+
+void
+great_lifetime_free(struct great_context *ctx, void *ptr)
+{
+	unsigned long s1, s2;
+	uint64_t time, count;
+	long i;
+
+	if (!ptr) {
+		return;
+	}
+
+	if (0 == __atomic_load_n(&nsamples, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	s1 = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+	if (0 == (s1 & 1)) {
+		i = find(ptr);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		s2 = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+
+		if (s1 == s2 && -1 == i) {
+			return;
+		}
+	}
+
+	time  = great_clock();
+	count = now(ctx);
+
+	spinlock();
+
+	i = find(ptr);
+	if (i != -1) {
+		expire((size_t) i, time, count);
+	}
+
+	unlock();
+}
+
+void
+great_lifetime_report(void)
+{
+	unsigned int i;
+
+	spinlock();
+
+	for (i = 0; i < SIZES; i++) {
+		unsigned long lo, hi;
+		uint64_t freed, shortlived, batch;
+		unsigned int j;
+
+		if (0 == sampled[i]) {
+			continue;
+		}
+
+		lo = i == 0 ? 0 : (unsigned long) ((uint64_t) 1 << (i - 1));
+		hi = i == 0 ? 0 : (unsigned long) (((uint64_t) 1 << (i - 1)) * 2 - 1);
+
+		freed = shortlived = batch = 0;
+		for (j = 0; j < DECADES; j++) {
+			freed += ns[i][j];
+		}
+
+		/* < 1ms, and < 1000 intervening allocations */
+		for (j = 0; j < 4; j++) {
+			shortlived += ns[i][j];
+			batch      += intervening[i][j];
+		}
+
+		great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+			"size %lu-%lu: %lu sampled, %lu freed, %lu outlived",
+			lo, hi, (unsigned long) sampled[i], (unsigned long) freed,
+			(unsigned long) (sampled[i] - freed));
+
+		great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+			"size %lu-%lu: lifetime <1us %lu, <10us %lu, <100us %lu, "
+			"<1ms %lu, <10ms %lu, <100ms %lu, <1s %lu, <10s %lu, more %lu",
+			lo, hi,
+			(unsigned long) ns[i][0], (unsigned long) ns[i][1],
+			(unsigned long) ns[i][2], (unsigned long) ns[i][3],
+			(unsigned long) ns[i][4], (unsigned long) ns[i][5],
+			(unsigned long) ns[i][6], (unsigned long) ns[i][7],
+			(unsigned long) ns[i][8]);
+
+		great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+			"size %lu-%lu: intervening allocations <1 %lu, <10 %lu, "
+			"<100 %lu, <1k %lu, <10k %lu, <100k %lu, <1M %lu, <10M %lu, "
+			"more %lu",
+			lo, hi,
+			(unsigned long) intervening[i][0], (unsigned long) intervening[i][1],
+			(unsigned long) intervening[i][2], (unsigned long) intervening[i][3],
+			(unsigned long) intervening[i][4], (unsigned long) intervening[i][5],
+			(unsigned long) intervening[i][6], (unsigned long) intervening[i][7],
+			(unsigned long) intervening[i][8]);
+
+		/* Samples which outlived the process count against both */
+		if (shortlived * 10 >= sampled[i] * 9) {
+			great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+				"size %lu-%lu: short-lived", lo, hi);
+		}
+
+		if (batch * 10 >= sampled[i] * 9) {
+			great_log(GREAT_LOG_INFO, "GREAT_LIFETIME",
+				"size %lu-%lu: batch-freeable", lo, hi);
+		}
+	}
+
+	unlock();
+
+	if (dropped > 0) {
+		great_log(GREAT_LOG_ERROR, "GREAT_LIFETIME",
+			"%lu samples dropped; table full", dropped);
+	}
+}
+
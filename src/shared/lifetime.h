@@ -0,0 +1,106 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation lifetime profiling.
+ *
+ * When $GREAT_LIFETIME is set non-empty, one in every n calls to malloc() and
+ * realloc() is sampled, on average, where n is given by $GREAT_LIFETIME if it
+ * is a number, or is 100 otherwise. Each sample is timestamped, and when it is
+ * freed its lifetime is recorded, both in nanoseconds and in the number of
+ * allocations made by all threads in the meantime. This is intended to show
+ * where an arena or pool allocator would pay off.
+ *
+ * At exit, histograms of lifetimes are logged per power-of-two size class,
+ * and each class is summarised:
+ *
+ *  - Short-lived: at least 90% of samples were freed within 1ms;
+ *  - Batch-freeable: at least 90% of samples were freed within 1000
+ *    intervening allocations, and so would be released by resetting an arena
+ *    at that interval.
+ *
+ * Samples not freed by exit are counted as outliving the process.
+ *
+ * The count of allocations is kept per thread and published in batches of
+ * GREAT_LIFETIME_BATCH, so counts of intervening allocations may be out by up
+ * to that many per thread.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_LIFETIME_H
+#define GREAT_SHARED_LIFETIME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GREAT_LIFETIME_BATCH 256
+
+struct great_context;
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private.
+ */
+struct great_lifetime {
+	uint64_t until;	/* allocations remaining until the next sample */
+	uint64_t rng;	/* PRNG state for sampling intervals */
+	uint64_t allocs;	/* allocations not yet published */
+};
+
+extern bool great_lifetime_enabled;
+
+/*
+ * Initialise from $GREAT_LIFETIME. This must be called before use.
+ */
+void
+great_lifetime_init(void);
+
+/*
+ * Account for an allocation of size bytes at p, which may be sampled.
+ */
+void
+great_lifetime_malloc(struct great_context *ctx, size_t size, void *p);
+
+/*
+ * Account for ptr being freed. This is cheap when ptr was not sampled. The
+ * context may be NULL.
+ */
+void
+great_lifetime_free(struct great_context *ctx, void *ptr);
+
+/*
+ * Log histograms of the lifetimes recorded so far.
+ */
+void
+great_lifetime_report(void);
+
+#endif
+
@@ -0,0 +1,301 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation lifetime profiling. This sets $GREAT_LIFETIME and $GREAT_LOG
+ * itself, so that every allocation is sampled, and reads back the report.
+ *
+ * Several threads allocate blocks of one size class and free half of them,
+ * so that the counts of samples taken and freed are exact. Then the main
+ * thread alone frees blocks of other size classes either immediately, or
+ * after more than 1000 intervening allocations, so that the counts of
+ * intervening allocations are exact too.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "lifetime.h"
+#include "context.h"
+#include "log.h"
+
+#define LOGFILE "lifetime_test.log"
+#define THREADS 4
+#define CALLS   1000
+#define LONG    10
+
+struct class {
+	unsigned long lo, hi;
+	unsigned long sampled, freed, outlived;
+	unsigned long intervening[5];	/* <1 to <10k */
+	bool batch;
+};
+
+static void *blocks[THREADS][CALLS];
+
+/*
+ * Allocate CALLS blocks of 64 bytes, and free every other one.
+ */
+static void *
+allocate(void *arg)
+{
+	struct great_context *ctx;
+	void **p = arg;
+	size_t i;
+
+	ctx = great_context();
+	assert(ctx);
+
+	for (i = 0; i < CALLS; i++) {
+		p[i] = malloc(64);
+		assert(p[i]);
+
+		great_lifetime_malloc(ctx, 64, p[i]);
+	}
+
+	for (i = 0; i < CALLS; i += 2) {
+		great_lifetime_free(ctx, p[i]);
+		free(p[i]);
+		p[i] = NULL;
+	}
+
+	return NULL;
+}
+
+/*
+ * Allocate n blocks of size bytes, and free each immediately.
+ */
+static void
+churn(struct great_context *ctx, size_t n, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		void *p;
+
+		p = malloc(size);
+		assert(p);
+
+		great_lifetime_malloc(ctx, size, p);
+		great_lifetime_free(ctx, p);
+		free(p);
+	}
+}
+
+static struct class *
+find(struct class *c, size_t n, unsigned long lo)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (c[i].lo == lo) {
+			return &c[i];
+		}
+	}
+
+	return NULL;
+}
+
+int
+main(void)
+{
+	struct great_context *ctx;
+	pthread_t tid[THREADS];
+	struct class classes[8], *c;
+	void *longlived[LONG];
+	unsigned long lo, hi;
+	unsigned long dropped;
+	size_t nclasses;
+	char line[512];
+	const char *s;
+	FILE *f;
+	size_t i, j;
+	int n;
+
+	(void) remove(LOGFILE);
+
+	if (-1 == setenv("GREAT_LOG", LOGFILE, 1)
+	|| -1 == setenv("GREAT_LIFETIME", "1", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("lifetime_test", NULL);
+	great_context_init();
+	great_lifetime_init();
+	assert(great_lifetime_enabled);
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, allocate, blocks[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	ctx = great_context();
+	assert(ctx);
+
+	/* Freed with no intervening allocations */
+	churn(ctx, CALLS, 16);
+
+	/* Freed after at least 2 * CALLS intervening allocations */
+	for (i = 0; i < LONG; i++) {
+		longlived[i] = malloc(4096);
+		assert(longlived[i]);
+
+		great_lifetime_malloc(ctx, 4096, longlived[i]);
+	}
+
+	churn(ctx, 2 * CALLS, 1);
+
+	for (i = 0; i < LONG; i++) {
+		great_lifetime_free(ctx, longlived[i]);
+		free(longlived[i]);
+	}
+
+	great_lifetime_report();
+
+	f = fopen(LOGFILE, "r");
+	assert(f);
+
+	nclasses = 0;
+	dropped  = 0;
+	while (fgets(line, sizeof line, f)) {
+		s = strstr(line, " GREAT_LIFETIME ");
+		if (!s) {
+			continue;
+		}
+
+		if (strstr(s, " samples dropped")) {
+			dropped++;
+			continue;
+		}
+
+		s = strstr(s, ": size ");
+		if (!s) {
+			continue;
+		}
+
+		s += strlen(": ");
+
+		n = sscanf(s, "size %lu-%lu: ", &lo, &hi);
+		assert(n == 2);
+
+		c = find(classes, nclasses, lo);
+		if (!c) {
+			assert(nclasses < sizeof classes / sizeof *classes);
+			c = &classes[nclasses++];
+			memset(c, 0, sizeof *c);
+			c->lo = lo;
+			c->hi = hi;
+		}
+
+		s = strchr(s, ':') + 2;
+
+		if (strstr(s, " sampled, ")) {
+			n = sscanf(s, "%lu sampled, %lu freed, %lu outlived",
+				&c->sampled, &c->freed, &c->outlived);
+			assert(n == 3);
+		} else if (0 == strncmp(s, "intervening ", 12)) {
+			n = sscanf(s, "intervening allocations <1 %lu, "
+				"<10 %lu, <100 %lu, <1k %lu, <10k %lu",
+				&c->intervening[0], &c->intervening[1],
+				&c->intervening[2], &c->intervening[3],
+				&c->intervening[4]);
+			assert(n == 5);
+		} else if (0 == strcmp(s, "batch-freeable\n")) {
+			c->batch = true;
+		}
+	}
+
+	fclose(f);
+	(void) remove(LOGFILE);
+
+	assert(dropped == 0);
+	assert(nclasses == 4);
+
+	/* Sampled and freed from every thread */
+	c = find(classes, nclasses, 64);
+	assert(c && c->hi == 127);
+	assert(c->sampled  == THREADS * CALLS);
+	assert(c->freed    == THREADS * CALLS / 2);
+	assert(c->outlived == THREADS * CALLS / 2);
+
+	/* Freed immediately */
+	c = find(classes, nclasses, 16);
+	assert(c && c->hi == 31);
+	assert(c->sampled == CALLS && c->freed == CALLS && c->outlived == 0);
+	assert(c->intervening[0] == CALLS);
+	assert(c->batch);
+
+	c = find(classes, nclasses, 1);
+	assert(c && c->hi == 1);
+	assert(c->sampled == 2 * CALLS && c->freed == 2 * CALLS);
+	assert(c->intervening[0] == 2 * CALLS);
+	assert(c->batch);
+
+	/* Freed after more than 1000 intervening allocations */
+	c = find(classes, nclasses, 4096);
+	assert(c && c->hi == 8191);
+	assert(c->sampled == LONG && c->freed == LONG && c->outlived == 0);
+	assert(c->intervening[4] == LONG);
+	assert(!c->batch);
+
+	for (i = 0; i < THREADS; i++) {
+		for (j = 0; j < CALLS; j++) {
+			if (blocks[i][j]) {
+				great_lifetime_free(ctx, blocks[i][j]);
+				free(blocks[i][j]);
+			}
+		}
+	}
+
+	printf("lifetime_test: %lu size classes, none dropped\n",
+		(unsigned long) nclasses);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,714 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Live allocation tracking.
+ *
+ * Live blocks are kept in a hash of pointers to sizes and call sites, split
+ * into shards by the pointer's hash so that threads allocating concurrently
+ * rarely contend for the same lock. Each shard is an open-addressing table
+ * with linear probing, mapped rather than malloc()ed, which is doubled in size
+ * when three quarters full. Deletion is by backward shifting, so there are no
+ * tombstones.
+ *
+ * Modifications to a shard are made whilst holding its spinlock. Lookups are
+ * made without the lock, guarded by a sequence count which is odd whilst the
+ * shard is being modified, and which changes with every modification. If the
+ * count changes during a lookup, the lookup is made again with the lock held.
+ * This lets free() pass over pointers which are not known without writing to
+ * shared memory.
+ *
+ * Since a lookup may still be probing a table after it has been replaced by a
+ * larger one, replaced tables are never unmapped. They total less than the
+ * size of the current table.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "live.h"
+#include "context.h"
+#include "log.h"
+#include "../map.h"
+#include "../proc.h"
+
+#define SHARDBITS 6
+#define SHARDS (1 << SHARDBITS)
+#define INITIAL 4096	/* entries per table, a power of two */
+#define SITES 65536	/* power of two */
+#define TRIES 4	/* to fill a table without the lock; see grow() */
+
+struct entry {
+	void *ptr;	/* NULL for an unused slot */
+	size_t size;
+	const void *site;
+};
+
+struct table {
+	size_t mask;	/* number of entries, less one */
+	struct entry e[];
+};
+
+struct shard {
+	int lock;
+	unsigned long seq;
+	size_t count;
+	struct table *table;
+};
+
+/* Each shard has a cache line to itself */
+static union {
+	struct shard s;
+	char pad[64];
+} shards[SHARDS];
+
+struct site {
+	const void *site;
+	uint64_t blocks;
+	uint64_t bytes;
+	bool reported;
+};
+
+bool great_live_enabled;
+
+/* True if $GREAT_LIVE asked for a report, rather than just the table */
+static bool reporting;
+
+static unsigned long top;
+static unsigned long dropped;
+
+/* Published totals; see GREAT_LIVE_BATCH */
+static int64_t live;
+static int64_t peak;
+
+static uint64_t
+hash(const void *ptr)
+{
+	uint64_t h;
+
+	h = (uint64_t) (uintptr_t) ptr;
+
+	h ^= h >> 33;
+	h *= (uint64_t) 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= (uint64_t) 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static struct shard *
+shard(uint64_t h)
+{
+	return &shards[h >> (64 - SHARDBITS)].s;
+}
+
+static void
+spinlock(struct shard *sh)
+{
+	while (__atomic_test_and_set(&sh->lock, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void
+unlock(struct shard *sh)
+{
+	__atomic_clear(&sh->lock, __ATOMIC_RELEASE);
+}
+
+static void
+modifying(struct shard *sh)
+{
+	__atomic_store_n(&sh->seq, sh->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void
+modified(struct shard *sh)
+{
+	__atomic_store_n(&sh->seq, sh->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Find the slot for ptr in t, or return -1 if it is not present. This may be
+ * called without the lock held, in which case the result is only meaningful
+ * if the shard's sequence count is unchanged afterwards.
+ */
+static long
+find(const struct table *t, const void *ptr, uint64_t h)
+{
+	size_t i;
+
+	assert(t);
+
+	for (i = h & t->mask; ; i = (i + 1) & t->mask) {
+		void *p;
+
+		p = __atomic_load_n(&t->e[i].ptr, __ATOMIC_RELAXED);
+		if (p == ptr) {
+			return (long) i;
+		}
+
+		if (!p) {
+			return -1;
+		}
+	}
+}
+
+/*
+ * Look up ptr without taking the lock, giving whether it was found and its
+ * size, or 0 if not. Returns false if this could not be done consistently, in
+ * which case the caller must take the lock and try again.
+ */
+static bool
+lookup(struct shard *sh, const void *ptr, uint64_t h, bool *found,
+	size_t *size)
+{
+	const struct table *t;
+	unsigned long s1, s2;
+	long i;
+
+	s1 = __atomic_load_n(&sh->seq, __ATOMIC_ACQUIRE);
+	if (s1 & 1) {
+		return false;
+	}
+
+	t = __atomic_load_n(&sh->table, __ATOMIC_ACQUIRE);
+	*found = false;
+	*size = 0;
+
+	if (t) {
+		i = find(t, ptr, h);
+		if (i != -1) {
+			*found = true;
+			*size = __atomic_load_n(&t->e[i].size, __ATOMIC_RELAXED);
+		}
+	}
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	s2 = __atomic_load_n(&sh->seq, __ATOMIC_RELAXED);
+
+	return s1 == s2;
+}
+
+static size_t
+tablesize(size_t n)
+{
+	return sizeof (struct table) + n * sizeof (struct entry);
+}
+
+/*
+ * Give a table twice the size of old, or of INITIAL entries where old is NULL,
+ * holding old's entries. old may be read without the lock, in which case the
+ * result is only meaningful if the shard's sequence count is unchanged
+ * afterwards. Returns NULL if memory could not be had.
+ */
+static struct table *
+rehash(const struct table *old)
+{
+	struct table *new;
+	size_t n;
+	size_t i;
+
+	n = old ? (old->mask + 1) * 2 : INITIAL;
+
+	new = great_map(tablesize(n));
+	if (!new) {
+		return NULL;
+	}
+
+	new->mask = n - 1;
+
+	for (i = 0; old && i <= old->mask; i++) {
+		void *p;
+		size_t j;
+
+		p = __atomic_load_n(&old->e[i].ptr, __ATOMIC_RELAXED);
+		if (!p) {
+			continue;
+		}
+
+		for (j = hash(p) & new->mask; new->e[j].ptr;
+			j = (j + 1) & new->mask)
+			;
+
+		new->e[j].ptr  = p;
+		new->e[j].size = __atomic_load_n(&old->e[i].size,
+			__ATOMIC_RELAXED);
+		new->e[j].site = __atomic_load_n(&old->e[i].site,
+			__ATOMIC_RELAXED);
+	}
+
+	return new;
+}
+
+/*
+ * Replace the shard's table with one twice the size. The new table is filled
+ * with the lock released, so that other threads allocating from the shard
+ * are not left spinning meanwhile, and is swapped in only if the shard was not
+ * modified in the meantime. After TRIES such attempts, it is filled with the
+ * lock held. Returns false if memory could not be had. The lock must be held,
+ * and is held again on return, though not throughout.
+ */
+static bool
+grow(struct shard *sh)
+{
+	struct table *old, *new;
+	unsigned long seq;
+	unsigned int i;
+
+	for (i = 0; i < TRIES; i++) {
+		old = sh->table;
+		seq = sh->seq;
+
+		unlock(sh);
+		new = rehash(old);
+		spinlock(sh);
+
+		if (!new) {
+			return false;
+		}
+
+		if (sh->table == old && sh->seq == seq) {
+			__atomic_store_n(&sh->table, new, __ATOMIC_RELEASE);
+			return true;
+		}
+
+		great_unmap(new, tablesize(new->mask + 1));
+
+		/* Another thread grew the table meanwhile */
+		if (sh->table != old) {
+			return true;
+		}
+	}
+
+	new = rehash(sh->table);
+	if (!new) {
+		return false;
+	}
+
+	__atomic_store_n(&sh->table, new, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/*
+ * Remove the entry in slot i, shifting back any following entries which would
+ * otherwise become unreachable. The lock must be held, and the sequence count
+ * odd.
+ */
+static void
+delete(struct shard *sh, size_t i)
+{
+	struct table *t = sh->table;
+	size_t j;
+
+	assert(t);
+	assert(t->e[i].ptr);
+
+	for (j = (i + 1) & t->mask; t->e[j].ptr; j = (j + 1) & t->mask) {
+		size_t k;
+
+		k = hash(t->e[j].ptr) & t->mask;
+
+		/* may slot j's entry move back to the hole at i? */
+		if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) {
+			continue;
+		}
+
+		t->e[i].size = t->e[j].size;
+		t->e[i].site = t->e[j].site;
+		__atomic_store_n(&t->e[i].ptr, t->e[j].ptr, __ATOMIC_RELAXED);
+		i = j;
+	}
+
+	__atomic_store_n(&t->e[i].ptr, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&sh->count, sh->count - 1, __ATOMIC_RELAXED);
+}
+
+static void
+publish(int64_t delta)
+{
+	int64_t n, p;
+
+	n = __atomic_add_fetch(&live, delta, __ATOMIC_RELAXED);
+
+	p = __atomic_load_n(&peak, __ATOMIC_RELAXED);
+	while (n > p && !__atomic_compare_exchange_n(&peak, &p, n, true,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static void
+account(struct great_context *ctx, int64_t delta)
+{
+	struct great_live *l;
+
+	if (!ctx) {
+		publish(delta);
+		return;
+	}
+
+	l = &ctx->live;
+
+	l->delta += delta;
+	if (l->delta >= GREAT_LIVE_BATCH || l->delta <= -GREAT_LIVE_BATCH) {
+		publish(l->delta);
+		l->delta = 0;
+	}
+}
+
+void
+great_live_init(void)
+{
+	const char *s;
+
+	s = getenv("GREAT_LIVE");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	top = 10;
+
+	if (strspn(s, "0123456789") == strlen(s)) {
+		errno = 0;
+		top = strtoul(s, NULL, 10);
+		if (ERANGE == errno) {
+			top = 10;
+		}
+	}
+
+	great_live_enabled = true;
+	reporting = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+		"Tracking live allocations; reporting %lu sites", top);
+}
+
+void
+great_live_track(void)
+{
+	great_live_enabled = true;
+}
+
+bool
+great_live_malloc(struct great_context *ctx, size_t size, void *p,
+	const void *caller)
+{
+	struct shard *sh;
+	struct table *t;
+	uint64_t h;
+	size_t old;
+	bool fresh;
+	long i;
+
+	if (!p) {
+		return false;
+	}
+
+	h = hash(p);
+	sh = shard(h);
+
+	spinlock(sh);
+
+	t = sh->table;
+	if (!t || sh->count + 1 > (t->mask + 1) / 4 * 3) {
+		/* The lock is released whilst growing; the table may differ */
+		bool grown = grow(sh);
+
+		t = sh->table;
+		if (!grown && (!t || sh->count + 1 > (t->mask + 1) / 16 * 15)) {
+			dropped++;
+			unlock(sh);
+			return false;
+		}
+	}
+
+	modifying(sh);
+
+	/*
+	 * A block may be given twice without an intervening free() seen;
+	 * for example, a shared result for malloc(0).
+	 */
+	i = find(t, p, h);
+	fresh = i == -1;
+	if (!fresh) {
+		old = t->e[i].size;
+	} else {
+		old = 0;
+
+		for (i = (long) (h & t->mask); t->e[i].ptr; i = (long) ((i + 1) & t->mask))
+			;
+
+		__atomic_store_n(&sh->count, sh->count + 1, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&t->e[i].size, size, __ATOMIC_RELAXED);
+	t->e[i].site = caller;
+	__atomic_store_n(&t->e[i].ptr, p, __ATOMIC_RELAXED);
+
+	modified(sh);
+
+	unlock(sh);
+
+	account(ctx, (int64_t) size - (int64_t) old);
+
+	return fresh;
+}
+
+bool
+great_live_free(struct great_context *ctx, void *ptr)
+{
+	struct shard *sh;
+	uint64_t h;
+	size_t size;
+	bool found;
+	long i;
+
+	if (!ptr) {
+		return false;
+	}
+
+	h = hash(ptr);
+	sh = shard(h);
+
+	if (0 == __atomic_load_n(&sh->count, __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	if (lookup(sh, ptr, h, &found, &size) && !found) {
+		return false;
+	}
+
+	spinlock(sh);
+
+	i = -1;
+	if (sh->table) {
+		i = find(sh->table, ptr, h);
+	}
+
+	if (-1 == i) {
+		unlock(sh);
+		return false;
+	}
+
+	size = sh->table->e[i].size;
+
+	modifying(sh);
+	delete(sh, (size_t) i);
+	modified(sh);
+
+	unlock(sh);
+
+	account(ctx, -(int64_t) size);
+
+	return true;
+}
+
+size_t
+great_live_size(const void *ptr)
+{
+	struct shard *sh;
+	uint64_t h;
+	size_t size;
+	bool found;
+
+	if (!ptr) {
+		return 0;
+	}
+
+	h = hash(ptr);
+	sh = shard(h);
+
+	while (!lookup(sh, ptr, h, &found, &size))
+		;
+
+	return size;
+}
+
+/*
+ * Add a block to the per-site totals. Sites beyond SITES are not counted.
+ */
+static void
+tally(struct site *sites, const struct entry *e)
+{
+	size_t i, n;
+
+	for (i = hash(e->site) & (SITES - 1), n = 0; n < SITES;
+		i = (i + 1) & (SITES - 1), n++) {
+		if (0 == sites[i].blocks) {
+			sites[i].site = e->site;
+			break;
+		}
+
+		if (sites[i].site == e->site) {
+			break;
+		}
+	}
+
+	if (n == SITES) {
+		return;
+	}
+
+	sites[i].blocks++;
+	sites[i].bytes += e->size;
+}
+
+static void
+site(const struct site *s)
+{
+	const char *object, *symbol;
+	unsigned long offset;
+
+	if (!great_symbol(s->site, &object, &symbol, &offset)) {
+		great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+			"%lu bytes in %lu blocks from 0x%lx",
+			(unsigned long) s->bytes, (unsigned long) s->blocks,
+			(unsigned long) (uintptr_t) s->site);
+		return;
+	}
+
+	if (!symbol) {
+		great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+			"%lu bytes in %lu blocks from %s+0x%lx",
+			(unsigned long) s->bytes, (unsigned long) s->blocks,
+			object, offset);
+		return;
+	}
+
+	great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+		"%lu bytes in %lu blocks from %s+0x%lx (%s)",
+		(unsigned long) s->bytes, (unsigned long) s->blocks,
+		symbol, offset, object);
+}
+
+void
+great_live_report(void)
+{
+	struct great_context *ctx;
+	struct site *sites;
+	uint64_t blocks, bytes;
+	int64_t unpublished;
+	unsigned long n;
+	size_t i;
+
+	/* The table may be kept for memlimit.h alone */
+	if (!reporting) {
+		return;
+	}
+
+	/* Sites are numerous, so they are not kept on the stack */
+	sites = great_map(SITES * sizeof *sites);
+
+	blocks = bytes = 0;
+
+	for (i = 0; i < SHARDS; i++) {
+		struct shard *sh = &shards[i].s;
+		size_t j;
+
+		spinlock(sh);
+
+		for (j = 0; sh->table && j <= sh->table->mask; j++) {
+			const struct entry *e = &sh->table->e[j];
+
+			if (!e->ptr) {
+				continue;
+			}
+
+			blocks++;
+			bytes += e->size;
+
+			if (sites) {
+				tally(sites, e);
+			}
+		}
+
+		unlock(sh);
+	}
+
+	/* The peak may have been reached by totals not yet published */
+	unpublished = 0;
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		unpublished += ctx->live.delta;
+	}
+
+	publish(0);
+	if (live + unpublished > peak) {
+		peak = live + unpublished;
+	}
+
+	great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+		"%lu bytes outstanding in %lu blocks",
+		(unsigned long) bytes, (unsigned long) blocks);
+
+	great_log(GREAT_LOG_INFO, "GREAT_LIVE",
+		"%lu bytes peak", (unsigned long) peak);
+
+	if (dropped > 0) {
+		great_log(GREAT_LOG_ERROR, "GREAT_LIVE",
+			"%lu blocks not tracked; out of memory", dropped);
+	}
+
+	if (!sites) {
+		return;
+	}
+
+	for (n = 0; n < top; n++) {
+		struct site *max;
+
+		max = NULL;
+		for (i = 0; i < SITES; i++) {
+			if (sites[i].blocks == 0 || sites[i].reported) {
+				continue;
+			}
+
+			if (!max || sites[i].bytes > max->bytes) {
+				max = &sites[i];
+			}
+		}
+
+		if (!max) {
+			break;
+		}
+
+		site(max);
+		max->reported = true;
+	}
+
+	great_unmap(sites, SITES * sizeof *sites);
+}
+
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Live allocation tracking.
+ *
+ * When $GREAT_LIVE is set non-empty, each block returned by malloc() and
+ * realloc() is recorded with its requested size and the address from which it
+ * was allocated, until it is freed. At exit, a summary is logged giving:
+ *
+ *  - The number of bytes and blocks still outstanding;
+ *  - The peak number of bytes live at any one time;
+ *  - The call sites responsible for the most outstanding bytes.
+ *
+ * $GREAT_LIVE may be set to a number to give the number of call sites
+ * reported; otherwise ten are given.
+ *
+ * Blocks allocated before initialisation, or whilst observation was otherwise
+ * unavailable, are not known, and freeing them is disregarded.
+ *
+ * The peak is maintained from per-thread running totals which are only
+ * published once they have changed by GREAT_LIVE_BATCH bytes, so that threads
+ * do not contend for a shared counter on every call. It may therefore be
+ * under-reported by up to GREAT_LIVE_BATCH bytes per thread.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_LIVE_H
+#define GREAT_SHARED_LIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GREAT_LIVE_BATCH 65536
+
+struct great_context;
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private.
+ */
+struct great_live {
+	int64_t delta;	/* bytes allocated less bytes freed, not yet published */
+};
+
+extern bool great_live_enabled;
+
+/*
+ * Initialise from $GREAT_LIVE. This must be called before use.
+ */
+void
+great_live_init(void);
+
+/*
+ * Keep the table of live blocks without $GREAT_LIVE, for memlimit.h, which
+ * must know which blocks it has counted. Nothing is reported unless
+ * $GREAT_LIVE was set. This sets great_live_enabled.
+ */
+void
+great_live_track(void);
+
+/*
+ * Record a block of size bytes at p, allocated from caller. Returns true if
+ * p was not already recorded and has been now. The context may be NULL.
+ */
+bool
+great_live_malloc(struct great_context *ctx, size_t size, void *p,
+	const void *caller);
+
+/*
+ * Record that ptr was freed. Returns true if ptr was known. This is cheap
+ * when ptr is not known. The context may be NULL.
+ */
+bool
+great_live_free(struct great_context *ctx, void *ptr);
+
+/*
+ * Return the size recorded for ptr, or 0 if ptr is not known. This does not
+ * take a lock.
+ */
+size_t
+great_live_size(const void *ptr);
+
+/*
+ * Log a summary of outstanding blocks, if $GREAT_LIVE was set.
+ */
+void
+great_live_report(void);
+
+#endif
+
@@ -0,0 +1,292 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Live allocation tracking. This sets $GREAT_LIVE and $GREAT_LOG itself, and
+ * reads back the report. Given "track", $GREAT_LIVE is left unset, and the
+ * table is kept only as for memlimit.h, so that nothing is to be reported.
+ *
+ * Blocks are allocated by the real allocator from several threads, and
+ * reported as the wrappers would report them (see alloc.h). With "track",
+ * several threads then record enough made-up addresses that every shard's
+ * table is grown whilst the others look up and free theirs.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() and pthread_barrier_wait() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "live.h"
+#include "context.h"
+#include "log.h"
+
+#define LOGFILE "live_test.log"
+#define THREADS 4
+#define CALLS   1000
+#define SIZE    1024
+#define GROWN   200000	/* addresses per thread, to grow every table */
+
+static void *blocks[THREADS][CALLS];
+static pthread_barrier_t barrier;
+
+/*
+ * Allocate CALLS blocks, and once every thread has done so, free every other
+ * one; the peak is when every block is allocated.
+ */
+static void *
+allocate(void *arg)
+{
+	struct great_context *ctx;
+	void **p = arg;
+	size_t i;
+
+	ctx = great_context();
+	assert(ctx);
+
+	for (i = 0; i < CALLS; i++) {
+		p[i] = malloc(SIZE);
+		assert(p[i]);
+
+		assert(great_live_malloc(ctx, SIZE, p[i], arg));
+	}
+
+	(void) pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < CALLS; i += 2) {
+		assert(great_live_free(ctx, p[i]));
+		free(p[i]);
+		p[i] = NULL;
+	}
+
+	return NULL;
+}
+
+/*
+ * A made-up address, never dereferenced, for the ith block of thread t.
+ */
+static void *
+address(size_t t, size_t i)
+{
+	return (void *) (((uintptr_t) (t + 1) << 28) + ((uintptr_t) i << 4));
+}
+
+/*
+ * Record GROWN addresses, freeing every third, and finding each of this
+ * thread's blocks as it goes, whilst other threads grow the tables.
+ */
+static void *
+churn(void *arg)
+{
+	size_t t = (size_t) (uintptr_t) arg;
+	size_t i;
+
+	(void) pthread_barrier_wait(&barrier);
+
+	for (i = 0; i < GROWN; i++) {
+		assert(great_live_malloc(NULL, i + 1, address(t, i), NULL));
+
+		if (i % 3 == 2) {
+			assert(great_live_free(NULL, address(t, i - 1)));
+		}
+
+		assert(great_live_size(address(t, i / 2))
+			== (i / 2 % 3 == 1 && i / 2 + 1 <= i ? 0 : i / 2 + 1));
+	}
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct great_context *ctx;
+	pthread_t tid[THREADS];
+	unsigned long bytes, nblocks, peak;
+	unsigned long sites;
+	bool track;
+	char line[512];
+	const char *s;
+	char zero[1];
+	FILE *f;
+	int i, n;
+
+	track = argc == 2 && 0 == strcmp(argv[1], "track");
+
+	(void) remove(LOGFILE);
+
+	if (-1 == setenv("GREAT_LOG", LOGFILE, 1)
+	|| -1 == setenv("GREAT_LIVE", track ? "" : "2", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("live_test", NULL);
+	great_context_init();
+	great_live_init();
+
+	if (track) {
+		assert(!great_live_enabled);
+		great_live_track();
+	}
+
+	assert(great_live_enabled);
+
+	ctx = great_context();
+	assert(ctx);
+
+	/* A block is recorded once, and found once */
+	assert(great_live_malloc(ctx, 8, &zero, NULL));
+	assert(!great_live_malloc(ctx, 8, &zero, NULL));
+	assert(great_live_size(&zero) == 8);
+	assert(great_live_free(ctx, &zero));
+	assert(!great_live_free(ctx, &zero));
+	assert(great_live_size(&zero) == 0);
+
+	/* A block of no size is still known */
+	assert(great_live_malloc(ctx, 0, &zero, NULL));
+	assert(great_live_free(ctx, &zero));
+	assert(!great_live_free(ctx, &zero));
+
+	assert(!great_live_malloc(ctx, 8, NULL, NULL));
+	assert(!great_live_free(ctx, NULL));
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, allocate, blocks[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	assert(great_live_size(blocks[0][1]) == SIZE);
+
+	great_live_report();
+
+	f = fopen(LOGFILE, "r");
+	assert(f);
+
+	bytes = nblocks = peak = sites = 0;
+	while (fgets(line, sizeof line, f)) {
+		s = strstr(line, " GREAT_LIVE INFO: ");
+		if (!s) {
+			continue;
+		}
+
+		s += strlen(" GREAT_LIVE INFO: ");
+
+		if (strstr(s, " bytes outstanding in ")) {
+			n = sscanf(s, "%lu bytes outstanding in %lu blocks",
+				&bytes, &nblocks);
+			assert(n == 2);
+		} else if (strstr(s, " bytes peak")) {
+			n = sscanf(s, "%lu bytes peak", &peak);
+			assert(n == 1);
+		} else if (strstr(s, " blocks from ")) {
+			sites++;
+		}
+	}
+
+	fclose(f);
+	(void) remove(LOGFILE);
+
+	if (track) {
+		size_t j;
+
+		assert(bytes == 0 && nblocks == 0 && peak == 0 && sites == 0);
+
+		for (i = 0; i < THREADS; i++) {
+			if (0 != pthread_create(&tid[i], NULL, churn,
+				(void *) (uintptr_t) i)) {
+				perror("pthread_create");
+				return EXIT_FAILURE;
+			}
+		}
+
+		for (i = 0; i < THREADS; i++) {
+			if (0 != pthread_join(tid[i], NULL)) {
+				perror("pthread_join");
+				return EXIT_FAILURE;
+			}
+		}
+
+		/* Nothing was lost or revived as the tables were replaced */
+		for (i = 0; i < THREADS; i++) {
+			for (j = 0; j < GROWN; j++) {
+				void *a = address((size_t) i, j);
+
+				if (j % 3 == 1 && j + 1 < GROWN) {
+					assert(great_live_size(a) == 0);
+					continue;
+				}
+
+				assert(great_live_size(a) == j + 1);
+				assert(great_live_free(NULL, a));
+			}
+		}
+
+		printf("live_test: track passed\n");
+		return EXIT_SUCCESS;
+	}
+
+	assert(bytes   == THREADS * CALLS / 2 * SIZE);
+	assert(nblocks == THREADS * CALLS / 2);
+
+	/* Totals are published in batches, and so the peak may be under-reported */
+	assert(peak <= THREADS * CALLS * SIZE);
+	assert(peak + THREADS * GREAT_LIVE_BATCH >= THREADS * CALLS * SIZE);
+
+	/* Each thread's blocks are from a site of their own; two are reported */
+	assert(sites == 2);
+
+	printf("live_test: %lu bytes outstanding, %lu peak\n", bytes, peak);
+
+	return EXIT_SUCCESS;
+}
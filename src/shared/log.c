@@ -33,9 +33,15 @@
  *
  * TODO Set logging level by environment
  *
+ * Each line gives the process ID, since children forked by the application
+ * log to the same file as their parent. Lines are written whole, by a single
+ * write(); see flush(). The buffer is shared by all threads, and so each line
+ * is composed under a lock.
+ *
  * $Id$
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <fcntl.h>
 #include <ctype.h>
@@ -50,10 +56,12 @@
 #include "subset.h"
 #include "../timestamp.h"
 #include "../io.h"
+#include "../proc.h"
 
 FILE *fp;
 const char *libname;
 const char *stdname;
+static unsigned long pid;	/* of this process, for display */
 
 /*
  * This is a buffer maintained for log messages; they are output one line at a
@@ -63,6 +71,13 @@ char *buffer;
 size_t bufferindex;
 size_t buffersize;
 
+/*
+ * Held whilst composing a line. A thread logging from within vlog() (by way
+ * of a wrapper, say) already holds it, and so carries on without.
+ */
+static char lock;
+static __thread bool locked;
+
 /*
  * Prerequisite: s contains one or more characters before a newline.
  */
@@ -93,9 +108,10 @@ flush(char *s) {
 
 	assert(bufferindex >= (size_t) (p - s));
 	bufferindex -= p - s;
-	memmove(s, p, buffersize - bufferindex);
+	memmove(s, p, bufferindex);
 
-	if (!*s) {
+	/* The buffer is not terminated; anything past bufferindex is stale */
+	if (0 == bufferindex) {
 		return;
 	}
 
@@ -116,12 +132,13 @@ static void
 push(const char *s, size_t len)
 {
 	assert(s);
-	assert(*s);
 
 	if (0 == len) {
 		return;
 	}
 
+	assert(*s);
+
 	if (len + 1 > buffersize - bufferindex) {
 		size_t ns;
 		char *n;
@@ -166,6 +183,31 @@ writeint(int i, int base, const char digits[])
 	push(&digits[i % base], 1);
 }
 
+/* As writeint(), for the 'l' length modifier and for %u */
+static void
+writeulong(unsigned long u, unsigned int base, const char digits[])
+{
+	assert(base == strlen(digits));
+
+	if (u / base) {
+		writeulong(u / base, base, digits);
+	}
+
+	push(&digits[u % base], 1);
+}
+
+static void
+writelong(long l, unsigned int base, const char digits[])
+{
+	if (l < 0) {
+		push("-", 1);
+		writeulong(-(unsigned long) l, base, digits);
+		return;
+	}
+
+	writeulong(l, base, digits);
+}
+
 /*
  * Read the precision given by a formatting specifier. This is expected to be
  * passed a pointer to the character after the '.' which begins the precision
@@ -225,11 +267,20 @@ static void
 vlogf(const char *fmt, va_list ap)
 {
 	const char *p;
+	va_list aq;
 
 	assert(fmt);
 
+	/*
+	 * va_list may be an array type, in which case &ap here would not be a
+	 * pointer to a va_list. A local copy is taken so that readprecision() may
+	 * be passed its address portably.
+	 */
+	va_copy(aq, ap);
+
 	for (p = fmt; *p; p++) {
 		int precision = -1;
+		bool islong = false;
 
 		switch (*p) {
 		case '%':
@@ -238,10 +289,15 @@ vlogf(const char *fmt, va_list ap)
 
 			/* readprecision() will nudge ap along for a precision of ".*" */
 			if ('.' == *p) {
-				p = readprecision(p + 1, &precision, &ap);
+				p = readprecision(p + 1, &precision, &aq);
 				assert(precision >= 0);
 			}
 
+			if ('l' == *p) {
+				islong = true;
+				p++;
+			}
+
 			switch(*p) {
 			case '%':
 				push("%", 1);
@@ -250,7 +306,7 @@ vlogf(const char *fmt, va_list ap)
 			case 's': {
 				char *s;
 
-				s = va_arg(ap, char *);
+				s = va_arg(aq, char *);
 				assert(s);
 				push(s, -1 == precision ? (int) strlen(s) : precision);
 				break;
@@ -258,16 +314,39 @@ vlogf(const char *fmt, va_list ap)
 
 			case 'i':
 			case 'd':
-				writeint(va_arg(ap, int), 10, "0123456789");
+				if (islong) {
+					writelong(va_arg(aq, long), 10, "0123456789");
+					break;
+				}
+
+				writeint(va_arg(aq, int), 10, "0123456789");
+				break;
+
+			case 'u':
+				writeulong(islong
+					? va_arg(aq, unsigned long)
+					: va_arg(aq, unsigned int), 10, "0123456789");
 				break;
 
 			case 'o':
-				writeint(va_arg(ap, int), 8, "01234567");
+				if (islong) {
+					writeulong(va_arg(aq, unsigned long), 8, "01234567");
+					break;
+				}
+
+				writeint(va_arg(aq, int), 8, "01234567");
 				break;
 
 			case 'x':
 			case 'X':
-				writeint(va_arg(ap, int), 16, *p == 'x'
+				if (islong) {
+					writeulong(va_arg(aq, unsigned long), 16, *p == 'x'
+						? "0123456789abcdef"
+						: "0123456789ABCDEF");
+					break;
+				}
+
+				writeint(va_arg(aq, int), 16, *p == 'x'
 					? "0123456789abcdef"
 					: "0123456789ABCDEF");
 				break;
@@ -275,7 +354,7 @@ vlogf(const char *fmt, va_list ap)
 			case 'c': {
 				char c;
 
-				c = va_arg(ap, int);	/* promoted */
+				c = va_arg(aq, int);	/* promoted */
 				push(&c, 1);
 				break;
 			}
@@ -293,6 +372,8 @@ vlogf(const char *fmt, va_list ap)
 			break;
 		}
 	}
+
+	va_end(aq);
 }
 
 static void
@@ -311,20 +392,32 @@ static void
 vlog(enum great_log_level level, const char *facility, const char *section, const char *fmt, va_list ap) 
 {
 	char buf[26];
+	bool nested;
 
 	assert(facility);
 	assert(libname);
 
 	great_subset_disable();
 
+	nested = locked;
+	if (!nested) {
+		while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+			;
+		locked = true;
+	}
+
 	great_timestamp(buf);
     /* -2 to cut off the \n\0 */
-	avlog("%.*s %s %s ", sizeof buf - 2, buf, libname, facility);
+	avlog("%.*s %s[%lu] %s ", sizeof buf - 2, buf, libname, pid, facility);
 	if (stdname && section) {
 		assert(strlen(stdname) > 0);
 		assert(strlen(section) > 0);
 
 		avlog("[%s %s] ", stdname, section);
+	} else if (section) {
+		assert(strlen(section) > 0);
+
+		avlog("[%s] ", section);
 	}
 
 	switch (level) {
@@ -361,9 +454,27 @@ vlog(enum great_log_level level, const char *facility, const char *section, cons
 
 	push("\n", 1);
 
+	if (!nested) {
+		locked = false;
+		__atomic_clear(&lock, __ATOMIC_RELEASE);
+	}
+
 	great_subset_enable();
 }
 
+/*
+ * Another thread may have been part way through a line when the application
+ * forked. That line is the parent's to finish, and so the child discards it,
+ * along with the lock. The child shares fp with its parent.
+ */
+static void
+child(void)
+{
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+	bufferindex = 0;
+	pid = great_pid();
+}
+
 void
 great_log_init(const char *name, const char *standard)
 {
@@ -374,6 +485,10 @@ great_log_init(const char *name, const char *standard)
 
 	libname = name;
 	stdname = standard;
+	pid = great_pid();
+
+	/* Without a handler, a child may repeat part of a line; that is all */
+	(void) great_atfork(NULL, NULL, child);
 
 	/* default to stderr */
 	fp = stderr;
@@ -71,7 +71,7 @@ enum great_log_level {
  * Initialise logging. This must be called before use.
  *
  * The name passed is taken as the name of the library; this is used to
- * prefix log messages.
+ * prefix log messages. The standard may be NULL; see great_ub().
  *
  * The file to which logs are written is given by the environment variable
  * GREAT_LOG. This may may be a filename, or "-" to indicate stdout. If not
@@ -104,6 +104,10 @@ great_log_fini(void);
  *	%o		An int formatted as octal
  *	%i, %d	An int formatted as decimal
  *	%x, %X	An int formatted as hexadecimal in lower and upper case respectively
+ *	%u		An unsigned int formatted as decimal
+ *
+ * The length modifier l may be given for %d, %i, %o, %u, %x and %X, in which
+ * case the argument is a long (for %d and %i) or an unsigned long (otherwise).
  *
  * Other characters are passed through as-is. These must be printable
  * characters, as defined by isprint().
@@ -114,7 +118,7 @@ great_log_fini(void);
  *	%.*s	A positive int passed variadicaly
  *	%123s	A positive decimal number
  *
- * No conversion specifiers, lengths, widths or flags are provided.
+ * No other conversion specifiers, lengths, widths or flags are provided.
  */
 void
 great_log(enum great_log_level level, const char *facility, const char *fmt, ...);
@@ -135,8 +139,9 @@ great_perror(const char *facility, const char *string);
  *
  * Logs are formatted as "timestamp library facility [std section] level: msg"
 
- * [std section] is present only if a standard was specified by way of
- * great_log_init(), and if a section within the standard is given.
+ * [std section] is present only if a section within the standard is given.
+ * Where no standard was specified by way of great_log_init(), this is just
+ * [section], and the section is expected to name its standard.
  *
  * Otherwise, this function behaves as great_log().
  */
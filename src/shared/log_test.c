@@ -68,6 +68,9 @@ main(void)
 			a[i], a[i], a[i], a[i], a[i]);
 	}
 
+	great_log(GREAT_LOG_INFO, "l", "%lu %ld %lx %lo %u",
+		3000000000UL, -2000000000L, 0xdeadbeefUL, 8UL, 42u);
+
 	great_log_fini();
 
 	return 0;
@@ -0,0 +1,178 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory ceiling.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "memlimit.h"
+#include "context.h"
+#include "live.h"
+#include "subset.h"
+#include "misc.h"
+#include "log.h"
+#include "../map.h"
+
+bool great_memlimit_enabled;
+
+static int64_t limit;
+
+/* Published total; see GREAT_MEMLIMIT_BATCH */
+static int64_t live;
+
+/*
+ * The usable size of a block, or 0 for great_nothing.
+ */
+static size_t
+usable(void *p)
+{
+	if (!p || p == great_nothing + 1) {
+		return 0;
+	}
+
+	return great_usable_size(p);
+}
+
+static void
+account(struct great_context *ctx, int64_t delta)
+{
+	struct great_memlimit *m;
+
+	if (!ctx) {
+		__atomic_add_fetch(&live, delta, __ATOMIC_RELAXED);
+		return;
+	}
+
+	m = &ctx->memlimit;
+
+	m->delta += delta;
+	if (m->delta >= GREAT_MEMLIMIT_BATCH || m->delta <= -GREAT_MEMLIMIT_BATCH) {
+		__atomic_add_fetch(&live, m->delta, __ATOMIC_RELAXED);
+		m->delta = 0;
+	}
+}
+
+void
+great_memlimit_init(void)
+{
+	const char *s;
+	unsigned long l;
+	unsigned long scale;
+	char *e;
+
+	s = getenv("GREAT_MEM_LIMIT");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	errno = 0;
+	l = strtoul(s, &e, 10);
+
+	scale = 1;
+	if (0 == strcmp(e, "K")) {
+		scale = 1024UL;
+	} else if (0 == strcmp(e, "M")) {
+		scale = 1024UL * 1024;
+	} else if (0 == strcmp(e, "G")) {
+		scale = 1024UL * 1024 * 1024;
+	} else if (*e != '\0') {
+		scale = 0;
+	}
+
+	if (*s < '0' || *s > '9' || ERANGE == errno || l == 0 || scale == 0
+	|| l > (unsigned long) INT64_MAX / scale) {
+		great_log(GREAT_LOG_ERROR, "GREAT_MEM_LIMIT",
+			"Invalid limit: \"%s\"; disregarding", s);
+		return;
+	}
+
+	limit = (int64_t) (l * scale);
+
+	great_memlimit_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_MEM_LIMIT",
+		"Failing allocations beyond %lu bytes live", l * scale);
+}
+
+bool
+great_memlimit_exceeded(void *ptr, size_t size)
+{
+	struct great_context *ctx;
+	int64_t n;
+	size_t old;
+
+	/* Calls made by the library itself are not the program's to fail */
+	if (great_subsets_disabled != 0) {
+		return false;
+	}
+
+	/* Only a block counted has bytes counted to give back */
+	old = great_live_size(ptr) != 0 ? usable(ptr) : 0;
+	if (size <= old) {
+		return false;
+	}
+
+	n = __atomic_load_n(&live, __ATOMIC_RELAXED);
+
+	ctx = great_context();
+	if (ctx) {
+		n += ctx->memlimit.delta;
+	}
+
+	return (uint64_t) (size - old) > (uint64_t) (n < limit ? limit - n : 0);
+}
+
+void
+great_memlimit_malloc(struct great_context *ctx, void *p)
+{
+	account(ctx, (int64_t) usable(p));
+}
+
+void
+great_memlimit_realloc(struct great_context *ctx, size_t oldsize, void *p)
+{
+	account(ctx, (int64_t) usable(p) - (int64_t) oldsize);
+}
+
+void
+great_memlimit_free(struct great_context *ctx, void *ptr)
+{
+	account(ctx, -(int64_t) usable(ptr));
+}
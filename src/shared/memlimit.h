@@ -0,0 +1,126 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory ceiling.
+ *
+ * When $GREAT_MEM_LIMIT is set non-empty, it gives a number of bytes (with an
+ * optional suffix of K, M or G), and the bytes live on the heap are counted;
+ * once an allocation would take them past the limit, it fails, as it would for
+ * a process at its memory limit. For example, to see how caches behave with
+ * a 256MB ceiling and no random failures:
+ *
+ *	$GREAT_MEM_LIMIT='256M' $GREAT_PROBABILITY='0'
+ *
+ * Every allocation made by the program is subject to the limit, whether or
+ * not its function is in $GREAT_SUBSETS; only calls made by the library itself
+ * are exempt. Every block from malloc() and realloc() is counted, by its
+ * usable size (see great_usable_size()) rather than the size requested. Where
+ * usable sizes are not known, nothing is counted.
+ *
+ * Blocks from allocators which are not wrapped (calloc(), posix_memalign()
+ * and so on), and blocks allocated before initialisation, are not counted, and
+ * so neither is freeing them. To tell these apart, the blocks counted are kept
+ * in the table of live blocks (see great_live_track()), which costs a lookup
+ * for each call. A block the table has no room for is not counted.
+ *
+ * Each thread keeps a running total of its own, which is added to the shared
+ * count once it has changed by GREAT_MEMLIMIT_BATCH bytes, so that threads do
+ * not contend on every call. Each thread sees the shared count plus its own
+ * total, and so the limit is exact for a single thread, and may be overshot by
+ * up to GREAT_MEMLIMIT_BATCH bytes per other thread.
+ *
+ * This is provided by the C89 and C99 APIs, whose memory management wrappers
+ * observe allocations (see alloc.h).
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_MEMLIMIT_H
+#define GREAT_SHARED_MEMLIMIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GREAT_MEMLIMIT_BATCH 65536
+
+struct great_context;
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private.
+ */
+struct great_memlimit {
+	int64_t delta;	/* bytes allocated less bytes freed, not yet published */
+};
+
+extern bool great_memlimit_enabled;
+
+/*
+ * Initialise from $GREAT_MEM_LIMIT. This must be called before use.
+ */
+void
+great_memlimit_init(void);
+
+/*
+ * Return true if allocating size bytes, or reallocating ptr to size bytes
+ * where ptr is non-null, would take the bytes live past the limit. A block
+ * which was not counted is taken to give back nothing. This is always false
+ * for calls made whilst subsets are disabled.
+ */
+bool
+great_memlimit_exceeded(void *ptr, size_t size);
+
+/*
+ * The functions below are given only blocks which are recorded in the table
+ * of live blocks, that is, blocks which were counted.
+ */
+
+/*
+ * Count the block at p, allocated by malloc(). The context may be NULL.
+ */
+void
+great_memlimit_malloc(struct great_context *ctx, void *p);
+
+/*
+ * Count a call to realloc() which freed a block whose usable size was oldsize,
+ * or 0 if it freed no counted block, and which returned p, or NULL if there is
+ * no block to count. The context may be NULL.
+ */
+void
+great_memlimit_realloc(struct great_context *ctx, size_t oldsize, void *p);
+
+/*
+ * Count the block at ptr as about to be freed. The context may be NULL.
+ */
+void
+great_memlimit_free(struct great_context *ctx, void *ptr);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Memory ceiling. This sets $GREAT_MEM_LIMIT itself.
+ *
+ * Blocks are allocated by the real allocator and reported as the wrappers
+ * would report them (see alloc.h).
+ *
+ * $Id$
+ */
+
+/* Required for setenv() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "alloc.h"
+#include "memlimit.h"
+#include "subset.h"
+#include "log.h"
+#include "../map.h"
+
+#define LIMIT   (4L * 1024 * 1024)
+#define BLOCK   1000
+#define THREADS 4
+
+/* Enough blocks for any one thread to reach the limit */
+#define BLOCKS (LIMIT / BLOCK + 1)
+
+struct fill {
+	void *p[BLOCKS];
+	size_t n;
+	size_t bytes;	/* usable */
+};
+
+static struct fill fills[THREADS];
+
+/*
+ * Allocate blocks as malloc() would, until the limit says otherwise.
+ */
+static void *
+fill(void *arg)
+{
+	struct fill *f = arg;
+
+	f->n = 0;
+	f->bytes = 0;
+
+	while (!great_memlimit_exceeded(NULL, BLOCK)) {
+		void *p;
+
+		assert(f->n < BLOCKS);
+
+		p = malloc(BLOCK);
+		assert(p);
+
+		great_alloc_malloc(BLOCK, p, NULL);
+
+		f->p[f->n++] = p;
+		f->bytes += great_usable_size(p);
+	}
+
+	return NULL;
+}
+
+static void
+drain(struct fill *f)
+{
+	size_t i;
+
+	for (i = 0; i < f->n; i++) {
+		great_alloc_free(f->p[i]);
+		free(f->p[i]);
+	}
+
+	f->n = 0;
+}
+
+/*
+ * True if exactly size more bytes may be allocated.
+ */
+static int
+headroom(long size)
+{
+	return !great_memlimit_exceeded(NULL, (size_t) size)
+		&& great_memlimit_exceeded(NULL, (size_t) size + 1);
+}
+
+int
+main(void)
+{
+	pthread_t tid[THREADS];
+	size_t total, slack;
+	void *p, *q;
+	size_t n;
+	int i;
+
+	if (-1 == setenv("GREAT_MEM_LIMIT", "4M", 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("memlimit_test", NULL);
+	great_alloc_init();
+	assert(great_memlimit_enabled);
+	assert(headroom(LIMIT));
+
+	/* calloc() is not wrapped, so freeing its blocks counts for nothing */
+	for (i = 0; i < 10000; i++) {
+		p = calloc(1, 4096);
+		assert(p);
+
+		great_alloc_free(p);
+		free(p);
+	}
+
+	assert(headroom(LIMIT));
+
+	/* Reallocating such a block counts only the new block; as if moved */
+	p = calloc(1, 4096);
+	assert(p);
+
+	n = great_usable_size(p);
+	q = malloc(8192);
+	assert(q);
+
+	great_alloc_realloc(p, n, 8192, q, NULL);
+	free(p);
+	assert(headroom(LIMIT - (long) great_usable_size(q)));
+
+	great_alloc_free(q);
+	free(q);
+
+	assert(headroom(LIMIT));
+
+	/* A single thread stops exactly at the limit */
+	slack = great_usable_size(fills[0].p[0] = malloc(BLOCK)) - BLOCK;
+	free(fills[0].p[0]);
+
+	(void) fill(&fills[0]);
+	assert(fills[0].bytes + BLOCK > LIMIT);
+	assert(fills[0].bytes <= LIMIT + slack);
+	assert(headroom(LIMIT - (long) fills[0].bytes));
+
+	/* A block counted may grow within its usable size */
+	p = fills[0].p[0];
+	assert(!great_memlimit_exceeded(p, great_usable_size(p)));
+
+	/* One never counted gives back nothing, and so may not */
+	p = calloc(1, 4096);
+	assert(p);
+	assert(great_memlimit_exceeded(p, great_usable_size(p)));
+	free(p);
+
+	/* Calls made by the library itself are exempt */
+	great_subset_disable();
+	assert(!great_memlimit_exceeded(NULL, LIMIT));
+	great_subset_enable();
+
+	drain(&fills[0]);
+	assert(headroom(LIMIT));
+
+	/* Other threads may overshoot by what they have not yet published */
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, fill, &fills[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	total = 0;
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+
+		total += fills[i].bytes;
+	}
+
+	assert(total + BLOCK > LIMIT);
+	assert(total <= LIMIT + (THREADS - 1) * GREAT_MEMLIMIT_BATCH
+		+ THREADS * (BLOCK + slack));
+
+	for (i = 0; i < THREADS; i++) {
+		drain(&fills[i]);
+	}
+
+	printf("memlimit_test: %lu bytes across %d threads for a limit of %ld\n",
+		(unsigned long) total, THREADS, LIMIT);
+
+	return EXIT_SUCCESS;
+}
@@ -40,6 +40,8 @@
 
 #include "misc.h"
 
+char great_nothing[] = "";
+
 char *
 great_strdup(const char *str)
 {
@@ -49,5 +49,17 @@
 char *
 great_strdup(const char *str);
 
+/*
+ * Here we're after a valid pointer (that is, one which malloc may return) which
+ * points to an address that may not be read from or written to; the memory
+ * management wrappers of every API return great_nothing + 1 for this, and
+ * recognise it when freed.
+ *
+ * C99 6.5.5 P8 If both the pointer operand and the result point ... one past
+ * the last element of the array object, the evaluation shall not produce an
+ * overflow.
+ */
+extern char great_nothing[];
+
 #endif
 
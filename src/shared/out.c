@@ -0,0 +1,197 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Buffered output to files.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+
+#include "out.h"
+#include "../io.h"
+
+bool
+great_out_open(struct great_out *out, const char *path)
+{
+	assert(out);
+	assert(path);
+
+	out->n = 0;
+	out->error = false;
+
+	out->fd = great_open(path);
+	if (-1 == out->fd) {
+		return false;
+	}
+
+	return true;
+}
+
+void
+great_out_flush(struct great_out *out)
+{
+	assert(out);
+	assert(out->fd != -1);
+
+	if (0 == out->n) {
+		return;
+	}
+
+	if (!out->error && !great_writefd(out->fd, out->buf, out->n)) {
+		out->error = true;
+	}
+
+	out->n = 0;
+}
+
+bool
+great_out_close(struct great_out *out)
+{
+	assert(out);
+
+	great_out_flush(out);
+	great_close(out->fd);
+	out->fd = -1;
+
+	return !out->error;
+}
+
+void
+great_out_bytes(struct great_out *out, const void *p, size_t len)
+{
+	const char *s = p;
+
+	assert(out);
+	assert(p || len == 0);
+
+	while (len > 0) {
+		size_t n;
+
+		if (out->n == sizeof out->buf) {
+			great_out_flush(out);
+		}
+
+		n = sizeof out->buf - out->n;
+		if (n > len) {
+			n = len;
+		}
+
+		memcpy(out->buf + out->n, s, n);
+		out->n += n;
+		s      += n;
+		len    -= n;
+	}
+}
+
+void
+great_out_str(struct great_out *out, const char *s)
+{
+	assert(s);
+
+	great_out_bytes(out, s, strlen(s));
+}
+
+void
+great_out_ulong(struct great_out *out, unsigned long u, unsigned int base)
+{
+	char tmp[sizeof u * 8];
+	size_t n;
+
+	assert(base >= 2 && base <= 16);
+
+	/* digits are given in reverse */
+	n = sizeof tmp;
+	do {
+		tmp[--n] = "0123456789abcdef"[u % base];
+		u /= base;
+	} while (u > 0);
+
+	great_out_bytes(out, tmp + n, sizeof tmp - n);
+}
+
+/*
+ * Append s to buf at *n, limited to len bytes including a terminating null.
+ */
+static bool
+append(char *buf, size_t len, size_t *n, const char *s)
+{
+	size_t l;
+
+	l = strlen(s);
+	if (*n + l + 1 > len) {
+		return false;
+	}
+
+	memcpy(buf + *n, s, l + 1);
+	*n += l;
+
+	return true;
+}
+
+static bool
+appendulong(char *buf, size_t len, size_t *n, unsigned long u)
+{
+	char tmp[sizeof u * 3 + 1];
+	size_t i;
+
+	i = sizeof tmp - 1;
+	tmp[i] = '\0';
+	do {
+		tmp[--i] = "0123456789"[u % 10];
+		u /= 10;
+	} while (u > 0);
+
+	return append(buf, len, n, tmp + i);
+}
+
+bool
+great_out_name(char *buf, size_t len, const char *prefix,
+	unsigned long pid, unsigned long seq, const char *suffix)
+{
+	size_t n = 0;
+
+	assert(buf);
+	assert(prefix);
+	assert(suffix);
+
+	return append(buf, len, &n, prefix)
+		&& append(buf, len, &n, ".")
+		&& appendulong(buf, len, &n, pid)
+		&& append(buf, len, &n, ".")
+		&& appendulong(buf, len, &n, seq)
+		&& append(buf, len, &n, ".")
+		&& append(buf, len, &n, suffix);
+}
+
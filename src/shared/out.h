@@ -0,0 +1,99 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Buffered output to files.
+ *
+ * This is a minimal alternative to stdio for writing reports and profiles to
+ * files of their own, for use where stdio may not be (for example, from
+ * within a malloc() wrapper, or from a signal handler). Nothing here calls
+ * malloc(); the buffer is kept in struct great_out itself.
+ *
+ * Errors are sticky: once a write has failed, further output is discarded,
+ * and the failure is reported by great_out_close().
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_OUT_H
+#define GREAT_SHARED_OUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct great_out {
+	int fd;
+	bool error;
+	size_t n;
+	char buf[4096];
+};
+
+/*
+ * Open a file for output, truncating any existing content. Returns false on
+ * error.
+ */
+bool
+great_out_open(struct great_out *out, const char *path);
+
+/*
+ * Flush and close. Returns false if any error occurred since the file was
+ * opened.
+ */
+bool
+great_out_close(struct great_out *out);
+
+/*
+ * Flush the buffer to the file.
+ */
+void
+great_out_flush(struct great_out *out);
+
+void
+great_out_bytes(struct great_out *out, const void *p, size_t len);
+
+void
+great_out_str(struct great_out *out, const char *s);
+
+/*
+ * Output an unsigned integer in the given base (up to 16), in lower case.
+ */
+void
+great_out_ulong(struct great_out *out, unsigned long u, unsigned int base);
+
+/*
+ * Build a filename of the form "prefix.pid.seq.suffix" into buf, limited to
+ * len bytes including the terminating null. Returns false if it does not fit.
+ */
+bool
+great_out_name(char *buf, size_t len, const char *prefix,
+	unsigned long pid, unsigned long seq, const char *suffix);
+
+#endif
+
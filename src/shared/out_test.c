@@ -0,0 +1,112 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Buffered output to files.
+ *
+ * $Id$
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "out.h"
+
+#define FILENAME "out_test.out"
+
+/* More than the buffer holds, so that it is flushed part way */
+#define LONG (3 * sizeof ((struct great_out *) 0)->buf + 7)
+
+static char expected[LONG + 256];
+static char got[sizeof expected];
+
+int
+main(void)
+{
+	struct great_out out;
+	char name[13];
+	size_t n;
+	FILE *f;
+
+	/* Names which only just fit, and which do not */
+	assert(great_out_name(name, sizeof name, "p", 123, 4, "heap"));
+	assert(0 == strcmp(name, "p.123.4.heap"));
+	assert(!great_out_name(name, sizeof name - 1, "p", 123, 4, "heap"));
+	assert(!great_out_name(name, sizeof name, "p", 123, 45, "heap"));
+
+	assert(great_out_open(&out, FILENAME));
+
+	great_out_str(&out, "abc ");
+	great_out_ulong(&out, 0, 10);
+	great_out_str(&out, " ");
+	great_out_ulong(&out, 255, 16);
+	great_out_str(&out, " ");
+	great_out_ulong(&out, ULONG_MAX, 2);
+	great_out_str(&out, " ");
+
+	n = strlen("abc 0 ff ");
+	memcpy(expected, "abc 0 ff ", n);
+	memset(expected + n, '1', sizeof (unsigned long) * CHAR_BIT);
+	n += sizeof (unsigned long) * CHAR_BIT;
+	expected[n++] = ' ';
+
+	memset(expected + n, 'x', LONG);
+	great_out_bytes(&out, expected + n, LONG);
+	n += LONG;
+
+	assert(great_out_close(&out));
+
+	f = fopen(FILENAME, "rb");
+	assert(f);
+	assert(fread(got, 1, sizeof got, f) == n);
+	fclose(f);
+
+	assert(0 == memcmp(got, expected, n));
+
+	(void) remove(FILENAME);
+
+	/* Errors are sticky, and reported on closing */
+	if (great_out_open(&out, "/dev/full")) {
+		great_out_bytes(&out, expected, LONG);
+		great_out_str(&out, "abc");
+		assert(!great_out_close(&out));
+	}
+
+	assert(!great_out_open(&out, "/nonexistent/" FILENAME));
+
+	printf("out_test: passed\n");
+
+	return EXIT_SUCCESS;
+}
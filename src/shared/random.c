@@ -81,6 +81,13 @@
  *
  * XXX This is not thread-safe (forthcoming).
  *
+ * A child forked by the application would otherwise inherit the global
+ * failure state, and so make exactly the same decisions as its siblings. Each
+ * child is instead reseeded from its parent's seed and the ordinal of the
+ * fork (1 for the parent's first fork, and so on), so that siblings follow
+ * distinct sequences, and a given child's sequence is reproducible. A child's
+ * own children are numbered afresh from its new seed.
+ *
  * $Id$
  */
 
@@ -95,7 +102,9 @@
 #include <assert.h>
 
 #include "random.h"
+#include "decision.h"
 #include "log.h"
+#include "../proc.h"
 
 /* This value corresponds to the MT implementation */
 #define GREAT_RAND_MAX 0xffffffffUL
@@ -112,6 +121,10 @@
 
 struct great_random_state great_random_failure;	/* global failure state */
 
+static uint32_t failureseed;	/* of great_random_failure */
+static unsigned long forks;	/* by this process so far */
+static __thread unsigned long ordinal;	/* of the fork in progress */
+
 /*
  * Draw the seed from the envrionment variable GREAT_RANDOM_SEED if present.
  * Otherwise, an arbitary default (5489) is used. We do not need to conform
@@ -158,11 +171,51 @@ find_seed(void)
 	return (uint32_t) l;
 }
 
+/*
+ * Derive a seed from the parent's seed and the ordinal of the fork, by way of
+ * the SplitMix64 finaliser; consecutive ordinals give unrelated seeds.
+ */
+static uint32_t
+derive_seed(uint32_t seed, unsigned long n)
+{
+	uint64_t z;
+
+	z = ((uint64_t) seed << 32) + n * (uint64_t) 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * (uint64_t) 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * (uint64_t) 0x94d049bb133111ebULL;
+	z ^= z >> 31;
+
+	return (uint32_t) (z >> 32);
+}
+
+/* Called in the forking thread, which is the only thread in the child */
+static void
+prepare(void)
+{
+	ordinal = __atomic_add_fetch(&forks, 1, __ATOMIC_RELAXED);
+}
+
+static void
+child(void)
+{
+	failureseed = derive_seed(failureseed, ordinal);
+	forks = 0;
+
+	great_random_seed(&great_random_failure, failureseed);
+
+	great_log(GREAT_LOG_INFO, "GREAT_RANDOM_SEED",
+		"Reseeded as %lu for fork %lu", (unsigned long) failureseed, ordinal);
+}
+
 void
 great_random_init(struct great_random_state *state)
 {
 	if(!state) {
-		great_random_seed(&great_random_failure, find_seed());
+		failureseed = find_seed();
+		great_random_seed(&great_random_failure, failureseed);
+
+		/* Without handlers, children share their parent's sequence */
+		(void) great_atfork(prepare, NULL, child);
 	}
 }
 
@@ -192,6 +245,7 @@ static uint32_t
 genrand(struct great_random_state *state)
 {
 	uint32_t y;
+	uint32_t i;
 
 	if(!state) {
 		state = &great_random_failure;
@@ -200,8 +254,15 @@ genrand(struct great_random_state *state)
 	/* mag01[x] = x * MATRIX_A  for x = 0,1 */
 	static const uint32_t mag01[2] = { 0, MATRIX_A };
 
+	/*
+	 * A state may be shared by threads without locking (see random.h), so
+	 * the index is read once and bounded here; racing threads may repeat or
+	 * skip a word, but never read past the state vector.
+	 */
+	i = __atomic_load_n(&state->mti, __ATOMIC_RELAXED);
+
 	/* generate N words at one time */
-	if(state->mti >= N) {
+	if(i >= N) {
 		int kk;
 
 		for(kk = 0; kk < N - M; kk++) {
@@ -217,10 +278,12 @@ genrand(struct great_random_state *state)
 		y = (state->mt[N - 1] & UPPER_MASK) | (state->mt[0] & LOWER_MASK);
 		state->mt[N - 1] = state->mt[M - 1] ^ (y >> 1) ^ mag01[y & 0x1UL];
 
-		state->mti = 0;
+		i = 0;
 	}
 
-	y = state->mt[state->mti++];
+	__atomic_store_n(&state->mti, i + 1, __ATOMIC_RELAXED);
+
+	y = state->mt[i];
 
 	/* Tempering */
 	y ^= (y >> 11);
@@ -237,7 +300,7 @@ genrand(struct great_random_state *state)
 static bool
 probability(struct great_random_state *state, double p)
 {
-	return p < (0.0 + genrand(state)) / GREAT_RAND_MAX;
+	return (0.0 + genrand(state)) / GREAT_RAND_MAX < p;
 }
 
 bool
@@ -287,11 +350,20 @@ great_random_choice(unsigned int range)
 	unsigned int x = GREAT_RAND_MAX / range;
 	unsigned int y = x * range;
 	uint32_t r;
+	uint64_t v;
+
+	if (great_decision_replaying && great_decision_value(&v)) {
+		return (unsigned int) (v % range);
+	}
 
 	do {
 		r = genrand(&great_random_failure);
 	} while(r >= y);
 
+	if (great_decision_recording) {
+		great_decision_note(r / x);
+	}
+
 	return r / x;
 }
 
@@ -303,6 +375,14 @@ great_random_long(struct great_random_state *state)
 
 	uint32_t r = 0;	/* random source */
 	long int o;	/* output */
+	uint64_t v;
+
+	/* Only the failure state's values are recorded; see decision.h */
+	if (!state || state == &great_random_failure) {
+		if (great_decision_replaying && great_decision_value(&v)) {
+			return (long int) v;
+		}
+	}
 
 	/*
 	 * Values are set bit-by-bit for portability, should the range of a type
@@ -318,6 +398,11 @@ great_random_long(struct great_random_state *state)
 		r >>= 1;
 	}
 
+	if (great_decision_recording
+	&& (!state || state == &great_random_failure)) {
+		great_decision_note((uint64_t) o);
+	}
+
 	return o;
 }
 
@@ -330,6 +415,13 @@ great_random_int(struct great_random_state *state)
 
 	uint32_t r = 0;
 	int o;
+	uint64_t v;
+
+	if (!state || state == &great_random_failure) {
+		if (great_decision_replaying && great_decision_value(&v)) {
+			return (int) v;
+		}
+	}
 
 	for (o = 0; is > 0; is--, us--) {
 		if (0 == us) {
@@ -341,6 +433,10 @@ great_random_int(struct great_random_state *state)
 		r >>= 1;
 	}
 
+	if (great_decision_recording
+	&& (!state || state == &great_random_failure)) {
+		great_decision_note((uint64_t) o);
+	}
+
 	return o;
 }
-
@@ -70,7 +70,8 @@ extern struct great_random_state great_random_failure;	/* global failure state *
  * If the global failure state is initialised (that is, state is NULL), it is
  * also seeded. This is not true for other states. The seed for the global
  * state is taken from the environment (given as GREAT_RANDOM_SEED if present),
- * or an arbitary default (5489).
+ * or an arbitary default (5489). Children forked subsequently are reseeded
+ * with a seed derived from this and the ordinal of the fork.
  */
 void
 great_random_init(struct great_random_state *state);
@@ -0,0 +1,593 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Injection schedules.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "schedule.h"
+#include "random.h"
+#include "site.h"
+#include "callers.h"
+#include "threadname.h"
+#include "tree.h"
+#include "decision.h"
+#include "log.h"
+#include "../clock.h"
+
+#define DELIM " \t,;|/"
+
+/* The time over which tokens may accrue for $GREAT_FAIL_RATE, in ns */
+#define SLACK 10000000
+
+/* Shared by every function; see great_schedule_init() */
+static unsigned long warmup;	/* calls */
+static uint64_t warmupns;
+static uint64_t start;
+static int warm;	/* set once warmupns has passed */
+static unsigned long budget;
+static bool initialised;
+
+/*
+ * Parse an unsigned count, non-zero, of n characters. Returns 0 on error.
+ */
+static unsigned long
+parsecount(const char *s, size_t n, const char **ep)
+{
+	unsigned long l;
+	char *e;
+
+	assert(s);
+
+	if (n == 0 || *s < '0' || *s > '9') {
+		return 0;
+	}
+
+	errno = 0;
+	l = strtoul(s, &e, 10);
+	if (ERANGE == errno) {
+		return 0;
+	}
+
+	*ep = e;
+
+	return l;
+}
+
+/*
+ * Parse the name:count pair of n characters at s, giving the length of its
+ * name. Returns the count, or 0 if the pair is malformed.
+ */
+static unsigned long
+pair(const char *s, size_t n, size_t *namelen)
+{
+	const char *ep;
+	unsigned long l;
+	size_t c;
+
+	assert(s);
+	assert(namelen);
+
+	/* The count follows the last colon */
+	for (c = n; c > 0 && s[c - 1] != ':'; c--)
+		;
+
+	if (c <= 1) {
+		return 0;
+	}
+
+	l = parsecount(s + c, n - c, &ep);
+	if (l == 0 || ep != s + n) {
+		return 0;
+	}
+
+	*namelen = c - 1;
+
+	return l;
+}
+
+/*
+ * Find the name:count pair for the given subset path in a list, and return its
+ * count, or 0 if it is not listed. The name given may be the whole path, or
+ * its last component. Malformed pairs are disregarded; see check().
+ */
+static unsigned long
+lookup(const char *list, const char *path)
+{
+	const char *name;
+	unsigned long l;
+	size_t namelen;
+	size_t n;
+
+	assert(list);
+	assert(path);
+
+	name = strrchr(path, ':');
+	name = name ? name + 1 : path;
+
+	for (;;) {
+		list += strspn(list, DELIM);
+		if (!*list) {
+			return 0;
+		}
+
+		n = strcspn(list, DELIM);
+
+		l = pair(list, n, &namelen);
+		if (l != 0 && ((namelen == strlen(name) && !strncmp(list, name, namelen))
+		|| (namelen == strlen(path) && !strncmp(list, path, namelen)))) {
+			return l;
+		}
+
+		list += n;
+	}
+}
+
+/*
+ * Parse a $GREAT_SIZES predicate of n characters at p into s, if s is
+ * non-NULL. Returns false if the predicate is malformed.
+ */
+static bool
+predicate(const char *p, size_t n, struct great_schedule *s)
+{
+	const char *e;
+	unsigned long l;
+	unsigned long scale;
+	bool growth;
+	bool strict;
+	bool less;
+	char *ep;
+	double d;
+
+	assert(p);
+
+	e = p + n;
+
+	if (n > 4 && 0 == strncmp(p, "size", 4)) {
+		growth = false;
+		p += 4;
+	} else if (n > 6 && 0 == strncmp(p, "growth", 6)) {
+		growth = true;
+		p += 6;
+	} else {
+		return false;
+	}
+
+	if (*p != '<' && *p != '>') {
+		return false;
+	}
+
+	less = *p++ == '<';
+	strict = *p != '=';
+	if (!strict) {
+		p++;
+	}
+
+	if (p >= e || *p < '0' || *p > '9') {
+		return false;
+	}
+
+	errno = 0;
+
+	if (growth) {
+		d = strtod(p, &ep);
+		if (less || ERANGE == errno || ep + 1 != e || *ep != 'x'
+		|| d * 256 < 1 || d > 65536) {
+			return false;
+		}
+
+		if (s) {
+			s->growth = (unsigned long) (d * 256 + 0.5);
+		}
+
+		return true;
+	}
+
+	l = strtoul(p, &ep, 10);
+	if (ERANGE == errno) {
+		return false;
+	}
+
+	scale = 1;
+	if (ep + 1 == e && *ep == 'K') {
+		scale = 1024UL;
+	} else if (ep + 1 == e && *ep == 'M') {
+		scale = 1024UL * 1024;
+	} else if (ep + 1 == e && *ep == 'G') {
+		scale = 1024UL * 1024 * 1024;
+	} else if (ep != e) {
+		return false;
+	}
+
+	/* The bounds kept are inclusive below and exclusive above */
+	if (l > (SIZE_MAX - 1) / scale || (less && strict && l == 0)) {
+		return false;
+	}
+
+	l *= scale;
+
+	if (s && less) {
+		s->max = strict ? l : l + 1;
+	} else if (s) {
+		s->min = strict ? l + 1 : l;
+	}
+
+	return true;
+}
+
+/*
+ * Apply each $GREAT_SIZES predicate in list for the given subset path to s.
+ * Malformed entries are disregarded; see check().
+ */
+static void
+sizes(const char *list, const char *path, struct great_schedule *s)
+{
+	const char *name;
+	size_t namelen;
+	size_t n;
+
+	assert(list);
+	assert(path);
+	assert(s);
+
+	name = strrchr(path, ':');
+	name = name ? name + 1 : path;
+
+	for (;;) {
+		list += strspn(list, DELIM);
+		if (!*list) {
+			return;
+		}
+
+		n = strcspn(list, DELIM);
+
+		/* The predicate follows the last colon */
+		for (namelen = n; namelen > 0 && list[namelen - 1] != ':'; namelen--)
+			;
+
+		if (namelen > 1 && predicate(list + namelen, n - namelen, NULL)
+		&& ((namelen - 1 == strlen(name) && !strncmp(list, name, namelen - 1))
+		|| (namelen - 1 == strlen(path) && !strncmp(list, path, namelen - 1)))) {
+			(void) predicate(list + namelen, n - namelen, s);
+
+			great_log(GREAT_LOG_INFO, "GREAT_SIZES",
+				"Intercepting %s only where %.*s", path,
+				(int) (n - namelen), list + namelen);
+		}
+
+		list += n;
+	}
+}
+
+static bool
+validcount(const char *s, size_t n)
+{
+	size_t namelen;
+
+	return 0 != pair(s, n, &namelen);
+}
+
+static bool
+validsize(const char *s, size_t n)
+{
+	size_t c;
+
+	for (c = n; c > 0 && s[c - 1] != ':'; c--)
+		;
+
+	return c > 1 && predicate(s + c, n - c, NULL);
+}
+
+/*
+ * Report malformed entries in a list, once for all APIs.
+ */
+static void
+check(const char *env, bool (*valid)(const char *s, size_t n), const char *form)
+{
+	const char *list;
+	size_t n;
+
+	assert(env);
+
+	list = getenv(env);
+	if (!list) {
+		return;
+	}
+
+	for (;;) {
+		list += strspn(list, DELIM);
+		if (!*list) {
+			return;
+		}
+
+		n = strcspn(list, DELIM);
+
+		if (!valid(list, n)) {
+			great_log(GREAT_LOG_ERROR, env,
+				"Invalid %s \"%.*s\"; disregarding", form, (int) n, list);
+		}
+
+		list += n;
+	}
+}
+
+/*
+ * Read $GREAT_WARMUP and $GREAT_BUDGET, which are shared between APIs and so
+ * are read once only.
+ */
+static void
+init(void)
+{
+	const char *s;
+	const char *ep;
+	unsigned long l;
+
+	start = great_clock();
+
+	great_decision_init();
+
+	check("GREAT_FAIL_AT",    validcount, "name:count");
+	check("GREAT_FAIL_EVERY", validcount, "name:count");
+	check("GREAT_FAIL_RATE",  validcount, "name:count");
+	check("GREAT_SIZES",      validsize,  "name:predicate");
+
+	great_site_init();
+	great_callers_init();
+	great_threadname_init();
+	great_tree_init();
+
+	s = getenv("GREAT_WARMUP");
+	if (s && strlen(s) > 0) {
+		l = parsecount(s, strlen(s), &ep);
+		if (l != 0 && 0 == strcmp(ep, "ms")) {
+			warmupns = (uint64_t) l * 1000000;
+			great_log(GREAT_LOG_INFO, "GREAT_WARMUP",
+				"No interception for %lums", l);
+		} else if (l != 0 && *ep == '\0') {
+			warmup = l;
+			great_log(GREAT_LOG_INFO, "GREAT_WARMUP",
+				"No interception for %lu calls per function", l);
+		} else {
+			great_log(GREAT_LOG_ERROR, "GREAT_WARMUP",
+				"Invalid warm-up: \"%s\"; disregarding", s);
+		}
+	}
+
+	s = getenv("GREAT_BUDGET");
+	if (s && strlen(s) > 0) {
+		l = parsecount(s, strlen(s), &ep);
+		if (l != 0 && *ep == '\0') {
+			budget = l;
+			great_log(GREAT_LOG_INFO, "GREAT_BUDGET",
+				"At most %lu interceptions per function", l);
+		} else {
+			great_log(GREAT_LOG_ERROR, "GREAT_BUDGET",
+				"Invalid budget: \"%s\"; disregarding", s);
+		}
+	}
+}
+
+void
+great_schedule_init(struct great_schedule table[], const char *const path[],
+	size_t count)
+{
+	const char *at;
+	const char *every;
+	const char *rate;
+	const char *size;
+	unsigned long l;
+	size_t i;
+
+	assert(table);
+	assert(path);
+
+	if (!initialised) {
+		init();
+		initialised = true;
+	}
+
+	at    = getenv("GREAT_FAIL_AT");
+	every = getenv("GREAT_FAIL_EVERY");
+	rate  = getenv("GREAT_FAIL_RATE");
+	size  = getenv("GREAT_SIZES");
+
+	for (i = 0; i < count; i++) {
+		if (at) {
+			table[i].at = lookup(at, path[i]);
+		}
+
+		if (every) {
+			table[i].every = lookup(every, path[i]);
+		}
+
+		l = rate ? lookup(rate, path[i]) : 0;
+		if (l != 0) {
+			table[i].interval = l < 1000000000u ? 1000000000u / l : 1;
+		}
+
+		if (size) {
+			sizes(size, path[i], &table[i]);
+		}
+
+		table[i].tree = great_tree_counter(path[i]);
+		table[i].id   = great_decision_function(path[i]);
+
+		if (table[i].at) {
+			great_log(GREAT_LOG_INFO, "GREAT_FAIL_AT",
+				"Intercepting %s at call %lu", path[i], table[i].at);
+		}
+
+		if (table[i].every) {
+			great_log(GREAT_LOG_INFO, "GREAT_FAIL_EVERY",
+				"Intercepting %s every %lu calls", path[i], table[i].every);
+		}
+
+		if (table[i].interval) {
+			great_log(GREAT_LOG_INFO, "GREAT_FAIL_RATE",
+				"Intercepting %s every %luns", path[i],
+				(unsigned long) table[i].interval);
+		}
+	}
+}
+
+/*
+ * Take a token from a function's bucket, if one is due. The bucket is the
+ * time from which the next token is due; tokens due more than SLACK ago are
+ * forgone. Threads contend for the bucket only when a token is due.
+ */
+static bool
+bucket(struct great_schedule *s)
+{
+	uint64_t now;
+	uint64_t next;
+	uint64_t base;
+
+	assert(s);
+	assert(s->interval != 0);
+
+	now  = great_clock_coarse();
+	next = __atomic_load_n(&s->next, __ATOMIC_RELAXED);
+
+	do {
+		if (now < next) {
+			return false;
+		}
+
+		base = now - next > SLACK ? now - SLACK : next;
+	} while (!__atomic_compare_exchange_n(&s->next, &next, base + s->interval,
+		false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return true;
+}
+
+static bool
+decide(struct great_schedule *s, struct great_random_state *state,
+	const void *caller)
+{
+	unsigned long n;
+
+	assert(s);
+
+	/* Once the budget is used, nothing more is worth deciding */
+	if (__atomic_load_n(&s->exhausted, __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	if (great_threadname_enabled && !great_threadname()) {
+		return false;
+	}
+
+	if (great_callers_enabled && !great_callers(caller)) {
+		return false;
+	}
+
+	if (great_site_enabled && !great_site(caller)) {
+		return false;
+	}
+
+	n = __atomic_add_fetch(&s->calls, 1, __ATOMIC_RELAXED);
+
+	if (budget != 0 && __atomic_load_n(s->tree ? s->tree : &s->injected,
+		__ATOMIC_RELAXED) >= budget) {
+		__atomic_store_n(&s->exhausted, true, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	if (n <= warmup) {
+		return false;
+	}
+
+	if (warmupns != 0 && !__atomic_load_n(&warm, __ATOMIC_RELAXED)) {
+		if (great_clock() - start < warmupns) {
+			return false;
+		}
+
+		__atomic_store_n(&warm, 1, __ATOMIC_RELAXED);
+	}
+
+	if (s->at != 0 || s->every != 0) {
+		if (n != s->at && (s->every == 0 || n % s->every != 0)) {
+			return false;
+		}
+	} else if (s->interval != 0) {
+		if (!bucket(s)) {
+			return false;
+		}
+	} else if (!great_random_probability(state)) {
+		return false;
+	}
+
+	if (s->tree && !great_tree_take(s->tree, budget)) {
+		return false;
+	}
+
+	/* Another thread may have taken the last of the budget meanwhile */
+	n = __atomic_add_fetch(&s->injected, 1, __ATOMIC_RELAXED);
+	if (s->tree) {
+		n = __atomic_load_n(s->tree, __ATOMIC_RELAXED);
+	}
+
+	if (budget != 0 && n >= budget) {
+		__atomic_store_n(&s->exhausted, true, __ATOMIC_RELAXED);
+	}
+
+	return s->tree || budget == 0 || n <= budget;
+}
+
+bool
+great_schedule(struct great_schedule *s, struct great_random_state *state,
+	const void *caller)
+{
+	bool intercept;
+
+	assert(s);
+
+	if (great_decision_replaying) {
+		return great_decision_replay(s->id);
+	}
+
+	intercept = decide(s, state, caller);
+
+	if (great_decision_recording) {
+		great_decision_record(s->id, intercept);
+	}
+
+	return intercept;
+}
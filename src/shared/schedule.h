@@ -0,0 +1,160 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Injection schedules.
+ *
+ * Each wrapper decides whether to intercept a call it has been given (once
+ * the function is known to be in $GREAT_SUBSETS) by way of great_schedule().
+ * By default this is a draw from the PRNG with the probability given by
+ * $GREAT_PROBABILITY, but a function may instead be given an exact schedule:
+ *
+ *	$GREAT_FAIL_AT='malloc:1234'	intercept the 1234th call only
+ *	$GREAT_FAIL_EVERY='fopen:3'	intercept every third call
+ *
+ * Each is a list of name:count pairs delimited by commas or spaces, where the
+ * name is either a function's name or its full subset path. Calls are
+ * counted from 1 per function, once the function is found to be in a subset.
+ * A function given both intercepts on either. A function may instead be
+ * given a rate, in interceptions per second:
+ *
+ *	$GREAT_FAIL_RATE='malloc:5'	intercept about five calls a second
+ *
+ * so that the load of interceptions stays the same however often the function
+ * is called. Each such function has a token bucket, shared by every thread,
+ * which holds no more than accrue over 10ms (and at least one); the first
+ * call finding a token takes it. The bucket is refilled by the coarse clock
+ * (see great_clock_coarse()), and so rates above some hundreds a second are
+ * met in bursts. A scheduled function does not draw from the PRNG, and so
+ * leaves the decisions for other functions as they would be without it.
+ *
+ * For every function, injection may be held off and limited:
+ *
+ *	$GREAT_WARMUP='1000'	no interception for the first 1000 calls
+ *	$GREAT_WARMUP='250ms'	no interception for 250ms after startup
+ *	$GREAT_BUDGET='5'	at most five interceptions per function
+ *
+ * Calls during warm-up are counted, so that $GREAT_FAIL_AT counts from the
+ * first call regardless. Once a function has used its budget, every further
+ * call defaults without a draw, and is no longer counted.
+ *
+ * Counters are updated atomically, so a count is exact across threads;
+ * which thread makes the nth call is up to the scheduler. Calls made by the
+ * library itself (whilst logging, say) are neither counted nor intercepted,
+ * but only in the thread making them; see great_subset_disable(). Where
+ * $GREAT_TREE is set, budgets are shared with other processes; see tree.h.
+ *
+ * Allocations may be targeted by size, so that only the larger requests (which
+ * are the likelier to fail in practice) are considered at all:
+ *
+ *	$GREAT_SIZES='malloc:size>=1M'		requests of a megabyte or more
+ *	$GREAT_SIZES='realloc:growth>=2x'	requests at least doubling a block
+ *
+ * This is a list of name:predicate pairs as above, where each predicate is
+ * "size" or "growth", then one of <, <=, > or >= (only > or >= for growth),
+ * then a number. Sizes are in bytes, with an optional suffix of K, M or G;
+ * growth is the ratio of the size requested to the block's usable size, and
+ * ends in x, to within 1/256. A function given several predicates must
+ * satisfy all of them.
+ * They are tested by the wrapper (see GREAT_SCHEDULE_SIZE()) before the
+ * schedule, and calls which fail them are passed through as if outside of
+ * $GREAT_SUBSETS: they are neither counted nor logged.
+ *
+ * Where $GREAT_THREADS, $GREAT_CALLERS or $GREAT_SITES is set, calls from other
+ * threads, objects or call sites are neither counted nor intercepted; see
+ * threadname.h, callers.h and site.h.
+ *
+ * Decisions may be recorded with $GREAT_RECORD, and replayed in place of all
+ * of the above with $GREAT_REPLAY; see decision.h.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_SCHEDULE_H
+#define GREAT_SHARED_SCHEDULE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct great_random_state;
+
+/*
+ * The schedule for one function. Each API keeps a table of these by function
+ * ID. Consider the members private; a zeroed schedule is unscheduled.
+ */
+struct great_schedule {
+	unsigned long calls;	/* so far, whilst in a subset */
+	unsigned long injected;	/* so far */
+	unsigned long at;	/* $GREAT_FAIL_AT, or 0 */
+	unsigned long every;	/* $GREAT_FAIL_EVERY, or 0 */
+	unsigned long *tree;	/* shared injected count, or NULL; see tree.h */
+	bool exhausted;	/* the budget is used */
+	uint64_t interval;	/* ns per token for $GREAT_FAIL_RATE, or 0 */
+	uint64_t next;	/* the time from which the next token is due */
+	unsigned long id;	/* for recording; see decision.h */
+
+	/* $GREAT_SIZES */
+	size_t min;	/* inclusive */
+	size_t max;	/* exclusive, or 0 for no limit */
+	unsigned long growth;	/* in 256ths, or 0 for no limit */
+};
+
+/*
+ * Whether a request for size bytes to the function with the given schedule
+ * satisfies its $GREAT_SIZES predicates, where old is the usable size of the
+ * block being resized, or 0 for a new block. old is evaluated only for a
+ * function given a growth predicate.
+ */
+#define GREAT_SCHEDULE_SIZE(s, size, old) \
+	((size) >= (s)->min && ((s)->max == 0 || (size) < (s)->max) \
+	&& ((s)->growth == 0 \
+		|| (uint64_t) (size) * 256 >= (uint64_t) (old) * (s)->growth))
+
+/*
+ * Read the schedules for an API's count functions from the environment into
+ * table[], by subset path. This is to be called once per API, with subsets
+ * disabled, after great_random_init() and great_log_init().
+ */
+void
+great_schedule_init(struct great_schedule table[], const char *const path[],
+	size_t count);
+
+/*
+ * Count a call to the function with the given schedule from the call site
+ * caller, and return true if it is to be intercepted. The PRNG state is as for
+ * great_random_probability(), and is used only for functions without an exact
+ * schedule. caller may be NULL if it is not known.
+ */
+bool
+great_schedule(struct great_schedule *s, struct great_random_state *state,
+	const void *caller);
+
+#endif
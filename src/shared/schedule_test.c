@@ -0,0 +1,270 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Injection schedules. Given "budget", this expects $GREAT_BUDGET=5 and
+ * $GREAT_WARMUP=20, and perhaps $GREAT_TREE naming a control block yet to be
+ * created; otherwise none is to be set. Given "rate", several
+ * threads call a function given $GREAT_FAIL_RATE for a while, and each token
+ * is to be taken once. $GREAT_SIZES is set in every case, along with some
+ * malformed predicates, which are to be disregarded.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "schedule.h"
+#include "subset.h"
+#include "random.h"
+#include "log.h"
+#include "../clock.h"
+
+#define THREADS 4
+#define CALLS   20000
+
+#define RATE     1000	/* interceptions per second */
+#define DURATION 200000000	/* ns */
+#define SLACK    10000000	/* as for schedule.c */
+
+enum { AT, EVERY, NONE, COUNT };
+
+static const char *const path[COUNT] = {
+	"test:schedule:at",
+	"test:schedule:every",
+	"test:schedule:none"
+};
+
+static signed char memo[COUNT];
+static struct great_schedule table[COUNT];
+
+static uint64_t start;	/* great_clock_coarse(), for rated() */
+
+/*
+ * Call a function n times as a wrapper would, returning the interceptions.
+ * Each call logs, as the wrappers do, so that a thread inside the library
+ * overlaps other threads' calls.
+ */
+static unsigned long
+calls(int id, unsigned long n)
+{
+	unsigned long injected;
+	unsigned long i;
+
+	injected = 0;
+
+	for (i = 0; i < n; i++) {
+		if (!GREAT_SUBSET_MEMO(path[id], &memo[id])) {
+			continue;
+		}
+
+		if (great_schedule(&table[id], NULL, NULL)) {
+			great_log(GREAT_LOG_INTERCEPT, path[id], "intercepted");
+			injected++;
+		} else {
+			great_log(GREAT_LOG_DEFAULT, path[id], "defaulted");
+		}
+	}
+
+	return injected;
+}
+
+static void *
+thread(void *arg)
+{
+	unsigned long *injected = arg;
+
+	*injected = calls(EVERY, CALLS);
+
+	return NULL;
+}
+
+/*
+ * Call NONE, which is given a rate, until DURATION has passed.
+ */
+static void *
+rated(void *arg)
+{
+	unsigned long *injected = arg;
+
+	*injected = 0;
+
+	while (great_clock_coarse() - start < DURATION) {
+		*injected += calls(NONE, 100);
+	}
+
+	return NULL;
+}
+
+/*
+ * Run f from several threads at once, and return the interceptions.
+ */
+static unsigned long
+threads(void *(*f)(void *))
+{
+	pthread_t t[THREADS];
+	unsigned long injected[THREADS];
+	unsigned long total;
+	int i;
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&t[i], NULL, f, &injected[i])) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	total = 0;
+
+	for (i = 0; i < THREADS; i++) {
+		(void) pthread_join(t[i], NULL);
+		total += injected[i];
+	}
+
+	return total;
+}
+
+int
+main(int argc, char *argv[])
+{
+	bool budget, rate;
+	unsigned long injected;
+	uint64_t elapsed;
+
+	budget = argc == 2 && 0 == strcmp(argv[1], "budget");
+	rate   = argc == 2 && 0 == strcmp(argv[1], "rate");
+
+	setenv("GREAT_SUBSETS", "test:schedule", 1);
+	setenv("GREAT_FAIL_AT", "at:3", 1);
+	setenv("GREAT_FAIL_EVERY", "test:schedule:every:10", 1);
+	setenv("GREAT_PROBABILITY", "0", 1);
+	setenv("GREAT_SIZES", "at:size>=1K,at:size<4K "
+		"test:schedule:every:growth>=1.5x none:size>1M "
+		"none:size=3 none:growth<2x none:size<0 none:size>=1Q", 1);
+
+	if (rate) {
+		setenv("GREAT_FAIL_RATE", "none:1000", 1);
+	}
+
+	great_subset_disable();
+	great_log_init("schedule_test", NULL);
+	great_random_init(NULL);
+	great_subset_init();
+	great_schedule_init(table, path, COUNT);
+	great_subset_enable();
+
+	assert(table[AT].at == 3 && table[AT].every == 0);
+	assert(table[EVERY].every == 10 && table[EVERY].at == 0);
+	assert(table[NONE].at == 0 && table[NONE].every == 0);
+	assert(table[NONE].interval == (rate ? 1000000000 / RATE : 0));
+
+	/* Malformed predicates are disregarded */
+	assert(table[AT].min == 1024 && table[AT].max == 4096);
+	assert(table[EVERY].growth == 384);
+	assert(table[NONE].min == 1048577 && table[NONE].max == 0);
+	assert(table[NONE].growth == 0);
+
+	assert(!GREAT_SCHEDULE_SIZE(&table[AT], 1023, 0));
+	assert( GREAT_SCHEDULE_SIZE(&table[AT], 1024, 0));
+	assert( GREAT_SCHEDULE_SIZE(&table[AT], 4095, 0));
+	assert(!GREAT_SCHEDULE_SIZE(&table[AT], 4096, 0));
+
+	assert( GREAT_SCHEDULE_SIZE(&table[EVERY], 100, 0));
+	assert( GREAT_SCHEDULE_SIZE(&table[EVERY], 99, 66));
+	assert(!GREAT_SCHEDULE_SIZE(&table[EVERY], 99, 67));
+	assert( GREAT_SCHEDULE_SIZE(&table[EVERY], SIZE_MAX, 1));
+
+	assert(!GREAT_SCHEDULE_SIZE(&table[NONE], 1048576, 0));
+	assert( GREAT_SCHEDULE_SIZE(&table[NONE], 1048577, 0));
+
+	if (rate) {
+		start = great_clock_coarse();
+		injected = threads(rated);
+		elapsed = great_clock_coarse() - start;
+
+		/*
+		 * One token is due at the first call, and more accrue from
+		 * SLACK before it; each is taken by one thread only.
+		 */
+		assert(injected <= 1 + (elapsed + SLACK) * RATE / 1000000000);
+		assert(injected >= elapsed * RATE / 1000000000 / 4);
+		assert(injected == table[NONE].injected);
+	} else if (!budget) {
+		/* Only the third call */
+		assert(calls(AT, 2) == 0);
+		assert(calls(AT, 1) == 1);
+		assert(calls(AT, 100) == 0);
+
+		assert(calls(NONE, 1000) == 0);
+		assert(table[NONE].calls == 1000);
+
+		/* Exact across threads, however the calls interleave */
+		assert(threads(thread) == THREADS * CALLS / 10);
+		assert(table[EVERY].calls == THREADS * CALLS);
+	} else {
+		/* The warm-up is counted, and so is seen by $GREAT_FAIL_AT */
+		assert(calls(AT, 100) == 0);
+
+		/* Calls 30 to 70, then the budget is spent */
+		assert(calls(EVERY, 29) == 0);
+		assert(calls(EVERY, 41) == 5);
+		assert(table[EVERY].injected == 5);
+		assert(table[EVERY].exhausted);
+
+		/* Nothing further is counted */
+		assert(calls(EVERY, 1000) == 0);
+		assert(table[EVERY].calls == 70);
+
+		/* A shared budget stays spent */
+		if (getenv("GREAT_TREE") == NULL) {
+			table[EVERY].calls     = 0;
+			table[EVERY].injected  = 0;
+			table[EVERY].exhausted = false;
+			assert(threads(thread) == 5);
+		}
+	}
+
+	great_log_fini();
+
+	printf("schedule_test: %s passed\n",
+		budget ? "budget" : rate ? "rate" : "schedules");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Call site targeting.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "site.h"
+#include "context.h"
+#include "subset.h"
+#include "misc.h"
+#include "log.h"
+#include "../map.h"
+#include "../proc.h"
+
+#define DELIM " \t,;|"
+
+/* The most entries in $GREAT_SITES */
+#define SITES 64
+
+bool great_site_enabled;
+
+/*
+ * An entry from $GREAT_SITES. Either name is set, for a symbol or an object,
+ * or the entry is the range lo to hi (exclusive).
+ */
+static struct entry {
+	const char *name;
+	bool isobject;
+	bool hasoffset;
+	unsigned long offset;
+	uintptr_t lo;
+	uintptr_t hi;
+} sites[SITES];
+static size_t nsites;
+static bool symbols;	/* any entry is a symbol */
+static bool objects;	/* any entry is an object */
+
+static bool
+address(const char *s, char **ep, uintptr_t *u)
+{
+	unsigned long l;
+
+	if (strncmp(s, "0x", 2) != 0) {
+		return false;
+	}
+
+	errno = 0;
+	l = strtoul(s, ep, 16);
+	if (ERANGE == errno || *ep == s + 2) {
+		return false;
+	}
+
+	*u = (uintptr_t) l;
+
+	return true;
+}
+
+/*
+ * Parse an entry, which is terminated in place. Returns false if it is
+ * malformed.
+ */
+static bool
+parse(char *s, struct entry *e)
+{
+	char *ep;
+	char *plus;
+
+	assert(s);
+	assert(e);
+
+	memset(e, 0, sizeof *e);
+
+	if (address(s, &ep, &e->lo)) {
+		if (*ep == '\0') {
+			e->hi = e->lo + 1;
+			return true;
+		}
+
+		return *ep == '-' && address(ep + 1, &ep, &e->hi) && *ep == '\0'
+			&& e->hi > e->lo;
+	}
+
+	plus = strchr(s, '+');
+	if (plus) {
+		errno = 0;
+		e->offset = strtoul(plus + 1, &ep, 0);
+		if (ERANGE == errno || ep == plus + 1 || *ep != '\0') {
+			return false;
+		}
+
+		*plus = '\0';
+		e->hasoffset = true;
+	}
+
+	e->name = s;
+	e->isobject = strchr(s, '/') != NULL;
+
+	return *s != '\0';
+}
+
+void
+great_site_init(void)
+{
+	const char *s;
+	char *list;
+	char *p;
+
+	s = getenv("GREAT_SITES");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	/* Entries are terminated in place, and kept for the life of the process */
+	list = great_strdup(s);
+	if (!list) {
+		great_log(GREAT_LOG_ERROR, "GREAT_SITES",
+			"Unable to allocate; targeting disabled");
+		return;
+	}
+
+	p = list;
+	for (;;) {
+		char *q;
+
+		p += strspn(p, DELIM);
+		if (!*p) {
+			break;
+		}
+
+		q = p;
+		p += strcspn(p, DELIM);
+		if (*p) {
+			*p++ = '\0';
+		}
+
+		if (nsites == SITES) {
+			great_log(GREAT_LOG_ERROR, "GREAT_SITES",
+				"Too many sites; disregarding %s onwards", q);
+			break;
+		}
+
+		if (!parse(q, &sites[nsites])) {
+			great_log(GREAT_LOG_ERROR, "GREAT_SITES",
+				"Invalid site \"%s\"; disregarding", q);
+			continue;
+		}
+
+		if (sites[nsites].isobject) {
+			objects = true;
+		} else if (sites[nsites].name) {
+			symbols = true;
+		}
+
+		nsites++;
+	}
+
+	if (0 == nsites) {
+		return;
+	}
+
+	great_site_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_SITES",
+		"Targeting %lu call sites", (unsigned long) nsites);
+}
+
+/*
+ * Find whether any entry of the given kind matches name and offset.
+ */
+static bool
+named(bool isobject, const char *name, unsigned long offset)
+{
+	size_t i;
+
+	for (i = 0; i < nsites; i++) {
+		if (!sites[i].name || sites[i].isobject != isobject) {
+			continue;
+		}
+
+		if (0 != strcmp(sites[i].name, name)) {
+			continue;
+		}
+
+		if (!sites[i].hasoffset || sites[i].offset == offset) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Find whether pc is targeted, the slow way.
+ */
+static bool
+resolve(const void *pc)
+{
+	const char *object;
+	const char *symbol;
+	unsigned long offset;
+	bool match;
+	size_t i;
+
+	for (i = 0; i < nsites; i++) {
+		if (!sites[i].name && (uintptr_t) pc >= sites[i].lo
+		&& (uintptr_t) pc < sites[i].hi) {
+			return true;
+		}
+	}
+
+	if (!symbols && !objects) {
+		return false;
+	}
+
+	match = false;
+
+	/* dladdr() may call functions we wrap; let those default */
+	great_subset_disable();
+
+	if (symbols && great_symbol(pc, &object, &symbol, &offset) && symbol) {
+		match = named(false, symbol, offset);
+	}
+
+	if (!match && objects && great_object(pc, &object, &offset)) {
+		match = named(true, object, offset);
+	}
+
+	great_subset_enable();
+
+	return match;
+}
+
+/*
+ * Find the slot for pc in the cache, or the empty slot where it belongs. The
+ * cache is never full, so there is always an empty slot to be found.
+ */
+static struct great_site_slot *
+find(const struct great_site *cache, const void *pc)
+{
+	uint64_t h;
+	size_t i;
+
+	assert(cache->slot);
+
+	h = (uint64_t) (uintptr_t) pc * (uint64_t) 0x9e3779b97f4a7c15ULL;
+
+	for (i = (size_t) (h >> 32) & (cache->size - 1); ;
+		i = (i + 1) & (cache->size - 1)) {
+		if (cache->slot[i].pc == pc || !cache->slot[i].pc) {
+			return &cache->slot[i];
+		}
+	}
+}
+
+/*
+ * Map a cache of twice the size, or of GREAT_SITE_CACHE slots for the first,
+ * and move every site into it. Returns false if it could not be mapped.
+ */
+static bool
+grow(struct great_site *cache)
+{
+	struct great_site new;
+	size_t i;
+
+	new.size = cache->slot ? cache->size * 2 : GREAT_SITE_CACHE;
+	new.n    = cache->n;
+
+	new.slot = great_map(new.size * sizeof *new.slot);
+	if (!new.slot) {
+		return false;
+	}
+
+	for (i = 0; cache->slot && i < cache->size; i++) {
+		if (cache->slot[i].pc) {
+			*find(&new, cache->slot[i].pc) = cache->slot[i];
+		}
+	}
+
+	if (cache->slot) {
+		great_unmap(cache->slot, cache->size * sizeof *cache->slot);
+	}
+
+	*cache = new;
+
+	return true;
+}
+
+bool
+great_site(const void *pc)
+{
+	struct great_context *ctx;
+	struct great_site *cache;
+	struct great_site_slot *slot;
+	bool match;
+
+	if (!pc) {
+		return false;
+	}
+
+	ctx = great_context();
+	if (!ctx) {
+		return resolve(pc);
+	}
+
+	cache = &ctx->site;
+
+	if (cache->slot) {
+		slot = find(cache, pc);
+		if (slot->pc) {
+			return slot->match;
+		}
+	}
+
+	match = resolve(pc);
+
+	/* Kept no more than three quarters full */
+	if ((cache->n + 1) * 4 > cache->size * 3 && !grow(cache)) {
+		return match;
+	}
+
+	slot = find(cache, pc);
+	slot->pc    = pc;
+	slot->match = match;
+	cache->n++;
+
+	if (match) {
+		great_log(GREAT_LOG_INFO, "GREAT_SITES",
+			"Targeting call site 0x%lx",
+			(unsigned long) (uintptr_t) pc);
+	}
+
+	return match;
+}
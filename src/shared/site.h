@@ -0,0 +1,104 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Call site targeting.
+ *
+ * When $GREAT_SITES is set non-empty, only calls made from the call sites it
+ * lists are considered for interception; calls from anywhere else default, and
+ * are not counted by their schedules (see schedule.h). A call site is the
+ * address to which the wrapper returns. $GREAT_SITES is a list delimited by
+ * commas or spaces, of:
+ *
+ *	0x401000-0x402000	any call site in the given range (end exclusive)
+ *	0x4011d2		the call site at the given address
+ *	parse_header		any call site within the given symbol
+ *	parse_header+0x2c	the call site at the given offset into a symbol
+ *	/usr/bin/prog		any call site within the given object
+ *	/usr/bin/prog+0x11d2	the call site at the given offset into an object
+ *
+ * An entry containing a '/' names an object, by its path as logged. Offsets
+ * are as logged by the facilities which report call sites (for example,
+ * live.h), and may be given in decimal or hexadecimal.
+ *
+ * Symbols are found by dladdr(), which sees only dynamic symbols: functions
+ * exported from a shared object, or from a program linked with -rdynamic.
+ * Static functions, and any function of a program linked without -rdynamic,
+ * cannot be given by name; give them by object and offset instead, which is
+ * how call sites without a symbol are logged.
+ *
+ * Each call site is resolved by great_symbol() the first time it is seen by a
+ * thread, and the result is kept in a per-thread open-addressing cache, so that
+ * thereafter a call costs one hash probe. The cache starts at GREAT_SITE_CACHE
+ * slots, and is doubled whenever it is three quarters full; only should that
+ * fail is a site resolved again on its next call. A targeted site is logged
+ * when first resolved by each thread. Results are not revisited should an
+ * object be unloaded and another loaded at its address.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_SITE_H
+#define GREAT_SHARED_SITE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Initial slots per thread; a power of two */
+#define GREAT_SITE_CACHE 256
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private.
+ */
+struct great_site {
+	struct great_site_slot {
+		const void *pc;	/* NULL for an empty slot */
+		bool match;
+	} *slot;	/* mapped on first use, or NULL */
+	size_t size;	/* slots, a power of two */
+	size_t n;	/* slots in use */
+};
+
+extern bool great_site_enabled;
+
+/*
+ * Initialise from $GREAT_SITES. This must be called before use, and ought to
+ * be called with subsets disabled.
+ */
+void
+great_site_init(void);
+
+/*
+ * Return true if the call site pc is targeted by $GREAT_SITES.
+ */
+bool
+great_site(const void *pc);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Call site targeting. This sets $GREAT_SITES itself, from call sites within
+ * this program, which is not linked with -rdynamic, and so they are given by
+ * object and offset or by address. A call site in the C library is given by
+ * symbol.
+ *
+ * A range covering more sites than fit the cache initially checks that the
+ * cache grows, so that each site is resolved, and logged, once per thread.
+ * This sets $GREAT_LOG itself, to read back the sites logged.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "site.h"
+#include "context.h"
+#include "log.h"
+#include "../proc.h"
+
+#define LOGFILE "site_test.log"
+#define MANY    (4 * GREAT_SITE_CACHE)
+
+static const void *volatile seen;
+static volatile int calls;
+
+/*
+ * Note the address to which this returns; that is, a call site.
+ */
+static __attribute__((noinline)) void
+here(void)
+{
+	seen = __builtin_return_address(0);
+}
+
+/*
+ * Each makes a call after here(), so that here() is not a tail call, and each
+ * differs, so that none are merged.
+ */
+
+static __attribute__((noinline)) const void *
+targeted(void)
+{
+	here();
+	calls++;
+	return seen;
+}
+
+static __attribute__((noinline)) const void *
+untargeted(void)
+{
+	here();
+	calls += 2;
+	return seen;
+}
+
+static __attribute__((noinline)) const void *
+ranged(void)
+{
+	here();
+	calls += 3;
+	return seen;
+}
+
+static const void *site[4];
+
+/* Call sites, of which the first half are targeted */
+static char many[MANY];
+
+static void
+check(void)
+{
+	const char *p;
+	int i;
+
+	/* The second time round is from the cache */
+	for (i = 0; i < 2; i++) {
+		assert(great_site(site[0]));
+		assert(!great_site(site[1]));
+		assert(great_site(site[2]));
+		assert(great_site(site[3]));
+
+		p = site[3];
+		assert(!great_site(p + 1));
+		assert(!great_site(NULL));
+	}
+}
+
+static void *
+thread(void *arg)
+{
+	(void) arg;
+
+	check();
+
+	return NULL;
+}
+
+/*
+ * Look up every one of many[] twice, in a thread with a cache of its own.
+ */
+static void *
+lookup(void *arg)
+{
+	struct great_context *ctx;
+	size_t i, j, n;
+
+	(void) arg;
+
+	/* The context may be adopted, with sites already kept */
+	ctx = great_context();
+	assert(ctx);
+	n = ctx->site.n;
+
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < MANY; i++) {
+			assert(great_site(&many[i]) == (i < MANY / 2));
+		}
+	}
+
+	/* Every site is kept, each once */
+	assert(ctx->site.n == n + MANY);
+	assert(ctx->site.size > MANY);
+
+	return NULL;
+}
+
+/*
+ * Count the sites within many[] logged as targeted.
+ */
+static unsigned long
+logged(void)
+{
+	unsigned long n;
+	unsigned long u;
+	char line[256];
+	const char *s;
+	FILE *f;
+
+	f = fopen(LOGFILE, "r");
+	assert(f);
+
+	n = 0;
+	while (fgets(line, sizeof line, f)) {
+		s = strstr(line, " GREAT_SITES INFO: Targeting call site ");
+		if (!s) {
+			continue;
+		}
+
+		s += strlen(" GREAT_SITES INFO: Targeting call site ");
+		if (1 != sscanf(s, "0x%lx", &u)) {
+			continue;
+		}
+
+		if (u >= (uintptr_t) many && u < (uintptr_t) many + MANY) {
+			n++;
+		}
+	}
+
+	fclose(f);
+
+	return n;
+}
+
+int
+main(void)
+{
+	char sites[4096];
+	const char *object;
+	unsigned long offset;
+	pthread_t tid;
+	uintptr_t u;
+
+	(void) remove(LOGFILE);
+
+	if (-1 == setenv("GREAT_LOG", LOGFILE, 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("site_test", NULL);
+
+	site[0] = targeted();
+	site[1] = untargeted();
+	site[2] = ranged();
+
+	/* A call site one byte into getenv(), which the C library exports */
+	u = (uintptr_t) getenv + 1;
+	site[3] = (const void *) u;
+
+	if (!great_object(site[0], &object, &offset)) {
+		fprintf(stderr, "site_test: no object for a call site\n");
+		return EXIT_FAILURE;
+	}
+
+	sprintf(sites, "%s+0x%lx, 0x%lx-0x%lx getenv+1 0x%lx-0x%lx",
+		object, offset,
+		(unsigned long) (uintptr_t) site[2],
+		(unsigned long) (uintptr_t) site[2] + 1,
+		(unsigned long) (uintptr_t) many,
+		(unsigned long) (uintptr_t) many + MANY / 2);
+
+	if (-1 == setenv("GREAT_SITES", sites, 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_site_init();
+	assert(great_site_enabled);
+
+	check();
+
+	/* Each thread keeps a cache of its own */
+	if (0 != pthread_create(&tid, NULL, thread, NULL)
+	|| 0 != pthread_join(tid, NULL)) {
+		perror("pthread");
+		return EXIT_FAILURE;
+	}
+
+	if (0 != pthread_create(&tid, NULL, lookup, NULL)
+	|| 0 != pthread_join(tid, NULL)) {
+		perror("pthread");
+		return EXIT_FAILURE;
+	}
+
+	great_log_fini();
+
+	assert(logged() == MANY / 2);
+	(void) remove(LOGFILE);
+
+	printf("site_test: passed\n");
+
+	return EXIT_SUCCESS;
+}
@@ -66,8 +66,17 @@ static struct subset *subsets;
  * and great_subset_enable(). This provides a scope-like mechanism, where code
  * disabling subsets may be nested inside code which may or may not have already
  * disabled subsets for its own purposes.
+ *
+ * This is per thread, so that whilst one thread is inside the library (logging,
+ * say), calls made by other threads are still intercepted and counted.
+ */
+__thread unsigned int great_subsets_disabled;
+
+/*
+ * Set once subsets have been read from the environment, after which the
+ * result of matching a given name never changes.
  */
-unsigned int subsets_disabled;
+static bool initialised;
 
 static bool
 cisdelim(int c)
@@ -106,7 +115,6 @@ single(const char *rs)
 		great_re_error(e, buf, sizeof buf);
 		great_log(GREAT_LOG_ERROR, "GREAT_SUBSETS",
 			"%s; disregarding /%s/", buf, rs);
-		great_re_free(re);
 		return false;
 	}
 
@@ -143,6 +151,8 @@ great_subset_init(void)
 		restr = ".";
 	}
 
+	initialised = true;
+
 	/* a single regular expression */
 	if (!cisdelim(*restr)) {
 		return single(restr);
@@ -181,32 +191,70 @@ great_subset(const char *name)
 
 	assert(name);
 
-	if (subsets_disabled > 0) {
+	if (great_subsets_disabled > 0) {
 		return false;
 	}
 
 	/* TODO sanity check name */
 
+	/*
+	 * The system's regular expression implementation may itself call
+	 * functions which we wrap (malloc, for example), and may hold a lock on
+	 * the compiled expression whilst doing so. Matching is therefore made a
+	 * wrap-free region, so that such calls default rather than recurse.
+	 */
+	great_subset_disable();
+
 	for (subset = subsets; subset; subset = subset->next) {
-		if (!great_re_match(subset->re, name)) {
+		if (great_re_match(subset->re, name)) {
+			great_subset_enable();
 			return true;
 		}
 	}
 
+	great_subset_enable();
+
 	return false;
 }
 
+bool
+great_subset_memo(const char *name, signed char *memo)
+{
+	signed char m;
+	bool b;
+
+	assert(name);
+	assert(memo);
+
+	if (great_subsets_disabled > 0) {
+		return false;
+	}
+
+	m = __atomic_load_n(memo, __ATOMIC_RELAXED);
+	if (m != 0) {
+		return m > 0;
+	}
+
+	b = great_subset(name);
+
+	if (initialised) {
+		__atomic_store_n(memo, b ? 1 : -1, __ATOMIC_RELAXED);
+	}
+
+	return b;
+}
+
 void
 great_subset_disable(void)
 {
-	subsets_disabled++;
+	great_subsets_disabled++;
 
-	assert(subsets_disabled > 0);
+	assert(great_subsets_disabled > 0);
 }
 
 void
 great_subset_enable(void)
 {
-	subsets_disabled--;
+	great_subsets_disabled--;
 }
 
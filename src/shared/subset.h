@@ -59,9 +59,9 @@
  * enabling one also has the effect of enabling the other, and vice-versa. The
  * idiom for programatically expressing this co-dependence is:
  *
- *	if (!great_subset("stdlib:prng:rand")
- *	&& !great_subset("stdlib:prng:srand")) {
- *		return great_c99.rand();
+ *	if (!GREAT_C99_SUBSET(rand)
+ *	&& !GREAT_C99_SUBSET(srand)) {
+ *		return GREAT_C99(rand)();
  *	}
  *
  * This reads as "overriding rand() depends on both stdlib:prng:rand and
@@ -107,8 +107,33 @@ bool great_subset_init(void);
 bool great_subset(const char *name);
 
 /*
- * Temporarily disable all subsets. In conjunction with great_subset_enable(),
- * this is intended to provide a "wrap-free" region of code for internal use.
+ * As great_subset(), but remembering the result in *memo, so that the regular
+ * expressions are matched at most once per function. Each function is to have
+ * its own memo, initially 0. Results are only remembered once
+ * great_subset_init() has been called.
+ */
+bool great_subset_memo(const char *name, signed char *memo);
+
+/*
+ * As great_subset_memo(), but checking the memo in place first, so that once a
+ * function's result is known, the check costs just two loads. memo is
+ * evaluated more than once.
+ */
+#define GREAT_SUBSET_MEMO(name, memo) \
+	(great_subsets_disabled == 0 && __atomic_load_n((memo), __ATOMIC_RELAXED) \
+		? __atomic_load_n((memo), __ATOMIC_RELAXED) > 0 \
+		: great_subset_memo((name), (memo)))
+
+/*
+ * Non-zero if all subsets are disabled for the calling thread. Consider this
+ * private.
+ */
+extern __thread unsigned int great_subsets_disabled;
+
+/*
+ * Temporarily disable all subsets for the calling thread. In conjunction with
+ * great_subset_enable(), this is intended to provide a "wrap-free" region of
+ * code for internal use. Other threads are unaffected.
  */
 void great_subset_disable(void);
 
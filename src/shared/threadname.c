@@ -0,0 +1,147 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Thread name targeting.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "threadname.h"
+#include "context.h"
+#include "subset.h"
+#include "log.h"
+#include "../thread.h"
+#include "../re.h"
+
+/* Linux limits names to 16 characters, including the terminating null */
+#define NAMELEN 64
+
+bool great_threadname_enabled;
+
+static struct great_re *re;
+
+/*
+ * Read the calling thread's name into buf and match it. A thread whose name
+ * cannot be read is not targeted.
+ */
+static bool
+match(char buf[NAMELEN])
+{
+	bool m;
+
+	if (!great_thread_name(buf, NAMELEN)) {
+		return false;
+	}
+
+	great_subset_disable();
+	m = great_re_match(re, buf);
+	great_subset_enable();
+
+	return m;
+}
+
+void
+great_threadname_init(void)
+{
+	const char *s;
+	int e;
+
+	s = getenv("GREAT_THREADS");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	re = great_re_comp(s, &e);
+	if (!re) {
+		char buf[128];
+
+		great_re_error(e, buf, sizeof buf);
+		great_log(GREAT_LOG_ERROR, "GREAT_THREADS",
+			"%s; targeting disabled", buf);
+		return;
+	}
+
+	great_threadname_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_THREADS",
+		"Targeting threads named /%s/", s);
+}
+
+bool
+great_threadname(void)
+{
+	struct great_context *ctx;
+	char buf[NAMELEN];
+	int scope;
+
+	ctx = great_context();
+	if (!ctx) {
+		return match(buf);
+	}
+
+	scope = __atomic_load_n(&ctx->threadname.scope, __ATOMIC_RELAXED);
+	if (scope != 0) {
+		return scope > 0;
+	}
+
+	scope = match(buf) ? 1 : -1;
+	__atomic_store_n(&ctx->threadname.scope, scope, __ATOMIC_RELAXED);
+
+	if (scope > 0) {
+		great_log(GREAT_LOG_INFO, "GREAT_THREADS",
+			"Targeting thread \"%s\"", buf);
+	}
+
+	return scope > 0;
+}
+
+void
+great_threadname_rename(unsigned long id)
+{
+	struct great_context *ctx;
+
+	if (!great_threadname_enabled) {
+		return;
+	}
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		if (ctx->id != id || !__atomic_load_n(&ctx->owned, __ATOMIC_ACQUIRE)) {
+			continue;
+		}
+
+		__atomic_store_n(&ctx->threadname.scope, 0, __ATOMIC_RELAXED);
+	}
+}
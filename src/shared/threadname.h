@@ -0,0 +1,93 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Thread name targeting.
+ *
+ * When $GREAT_THREADS is set non-empty, it gives a regular expression which is
+ * matched against the name of the thread making each call. Calls from threads
+ * whose names do not match are neither counted nor intercepted; see
+ * schedule.h. Names are as given by pthread_setname_np(3), and so may serve as
+ * a tag for each thread's role; for example, to intercept only within a pool
+ * of workers named "io-0", "io-1" and so on:
+ *
+ *	$GREAT_THREADS='^io-[0-9]+$'
+ *
+ * A thread which has not been named has the name of the thread which created
+ * it (usually the program's name).
+ *
+ * Each thread's name is read once, on its first call, and the result of the
+ * match is kept in its context, so that thereafter a call from outside of the
+ * threads targeted costs one branch. The result is discarded when the thread
+ * is renamed by way of the wrapper for pthread_setname_np() (see
+ * api/gnu/wrap.h). Only the unified library has both that wrapper and the
+ * others in the one runtime, and so the per-API libraries do not notice
+ * threads renamed; nor are threads renamed by other means (for example, by
+ * prctl(2)) noticed.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_THREADNAME_H
+#define GREAT_SHARED_THREADNAME_H
+
+#include <stdbool.h>
+
+/*
+ * Per-thread state, kept in struct great_context. Consider this private; a
+ * zeroed state is yet to be matched.
+ */
+struct great_threadname {
+	int scope;	/* 0 if unknown, 1 if targeted, -1 if not */
+};
+
+extern bool great_threadname_enabled;
+
+/*
+ * Initialise from $GREAT_THREADS. This must be called before use, and ought to
+ * be called with subsets disabled.
+ */
+void
+great_threadname_init(void);
+
+/*
+ * Return true if the calling thread is targeted by $GREAT_THREADS.
+ */
+bool
+great_threadname(void);
+
+/*
+ * Note that the thread with the given great_thread_id() has been renamed, so
+ * that its name is read again on its next call.
+ */
+void
+great_threadname_rename(unsigned long id);
+
+#endif
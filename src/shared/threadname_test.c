@@ -0,0 +1,166 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Thread name targeting, from several threads at once.
+ *
+ * $Id$
+ */
+
+/* Required for pthread_setname_np() and setenv() */
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "threadname.h"
+#include "schedule.h"
+#include "subset.h"
+#include "random.h"
+#include "log.h"
+#include "../thread.h"
+
+#define THREADS 4
+#define CALLS   10000
+
+static const char *const path[] = { "test:threadname:f" };
+
+static signed char memo;
+static struct great_schedule table[1];
+
+struct worker {
+	pthread_t t;
+	char name[16];
+	unsigned long injected;
+};
+
+static unsigned long
+calls(unsigned long n)
+{
+	unsigned long injected;
+	unsigned long i;
+
+	injected = 0;
+
+	for (i = 0; i < n; i++) {
+		if (!GREAT_SUBSET_MEMO(path[0], &memo)) {
+			continue;
+		}
+
+		if (great_schedule(&table[0], NULL, NULL)) {
+			great_log(GREAT_LOG_INTERCEPT, path[0], "intercepted");
+			injected++;
+		} else {
+			great_log(GREAT_LOG_DEFAULT, path[0], "defaulted");
+		}
+	}
+
+	return injected;
+}
+
+static void *
+worker(void *arg)
+{
+	struct worker *w = arg;
+
+	if (0 != pthread_setname_np(pthread_self(), w->name)) {
+		perror("pthread_setname_np");
+		exit(EXIT_FAILURE);
+	}
+
+	w->injected = calls(CALLS);
+
+	return NULL;
+}
+
+int
+main(void)
+{
+	struct worker w[THREADS];
+	int i;
+
+	setenv("GREAT_SUBSETS", "test:threadname", 1);
+	setenv("GREAT_FAIL_EVERY", "test:threadname:f:1", 1);
+	setenv("GREAT_THREADS", "^worker-[0-2]$", 1);
+
+	great_subset_disable();
+	great_log_init("threadname_test", NULL);
+	great_random_init(NULL);
+	great_subset_init();
+	great_schedule_init(table, path, 1);
+	great_subset_enable();
+
+	assert(great_threadname_enabled);
+
+	/* The main thread is named for the program */
+	assert(!great_threadname());
+	assert(calls(100) == 0);
+	assert(table[0].calls == 0);
+
+	for (i = 0; i < THREADS; i++) {
+		sprintf(w[i].name, "worker-%d", i);
+		if (0 != pthread_create(&w[i].t, NULL, worker, &w[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		(void) pthread_join(w[i].t, NULL);
+	}
+
+	/* Every call from a worker targeted, whatever the others were doing */
+	for (i = 0; i < THREADS; i++) {
+		assert(w[i].injected == (i < 3 ? CALLS : 0));
+	}
+
+	assert(table[0].calls == 3 * CALLS);
+
+	/* A rename is noticed once it is noted */
+	if (0 != pthread_setname_np(pthread_self(), "worker-1")) {
+		perror("pthread_setname_np");
+		return EXIT_FAILURE;
+	}
+
+	assert(!great_threadname());
+	great_threadname_rename(great_thread_id());
+	assert(great_threadname());
+	assert(calls(10) == 10);
+
+	great_log_fini();
+
+	printf("threadname_test: passed\n");
+
+	return EXIT_SUCCESS;
+}
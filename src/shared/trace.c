@@ -0,0 +1,309 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation trace capture.
+ *
+ * Each thread encodes events into the buffer in its context without locking.
+ * A full buffer is written to the file as one chunk, under a lock so that
+ * chunks are not interleaved part-way.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "trace.h"
+#include "context.h"
+#include "out.h"
+#include "log.h"
+#include "../clock.h"
+#include "../io.h"
+#include "../proc.h"
+
+/* The most bytes an event may take: op, and four 64-bit varints */
+#define EVENT (1 + 4 * 10)
+
+bool great_trace_enabled;
+
+static int fd = -1;
+static int lock;
+static uint64_t start;
+
+static void
+spinlock(void)
+{
+	while (__atomic_test_and_set(&lock, __ATOMIC_ACQUIRE))
+		;
+}
+
+static void
+unlock(void)
+{
+	__atomic_clear(&lock, __ATOMIC_RELEASE);
+}
+
+static size_t
+varint(unsigned char *p, uint64_t u)
+{
+	size_t n;
+
+	for (n = 0; u >= 0x80; u >>= 7) {
+		p[n++] = (unsigned char) (u | 0x80);
+	}
+
+	p[n++] = (unsigned char) u;
+
+	return n;
+}
+
+static size_t
+zigzag(unsigned char *p, uintptr_t from, uintptr_t to)
+{
+	int64_t d;
+
+	d = (int64_t) (to - from);
+
+	return varint(p, ((uint64_t) d << 1) ^ (uint64_t) (d >> 63));
+}
+
+/*
+ * Write the buffered events as a chunk, and start the buffer afresh.
+ */
+static void
+flush(struct great_trace *tr)
+{
+	unsigned char head[20];
+	size_t n;
+
+	if (0 == tr->n) {
+		return;
+	}
+
+	n  = varint(head, tr->thread);
+	n += varint(head + n, tr->n);
+
+	spinlock();
+
+	if (fd != -1 && (!great_writefd(fd, head, n)
+	|| !great_writefd(fd, tr->buf, tr->n))) {
+		great_close(fd);
+		fd = -1;
+	}
+
+	unlock();
+
+	tr->n    = 0;
+	tr->time = 0;
+	tr->ptr  = 0;
+}
+
+/*
+ * Begin an event, returning the buffer to encode it into.
+ */
+static unsigned char *
+event(struct great_context *ctx, enum great_trace_op op, void *ptr)
+{
+	struct great_trace *tr = &ctx->trace;
+	unsigned char *p;
+	uint64_t now;
+
+	if (tr->thread != ctx->id || tr->n + EVENT > sizeof tr->buf) {
+		flush(tr);
+		tr->thread = ctx->id;
+	}
+
+	now = great_clock() - start;
+
+	p = tr->buf + tr->n;
+
+	*p++ = (unsigned char) op;
+	p += varint(p, now - tr->time);
+	p += zigzag(p, tr->ptr, (uintptr_t) ptr);
+
+	tr->time = now;
+	tr->ptr  = (uintptr_t) ptr;
+
+	return p;
+}
+
+static void
+end(struct great_context *ctx, const unsigned char *p)
+{
+	ctx->trace.n = (size_t) (p - ctx->trace.buf);
+}
+
+/*
+ * The lock is held across fork(), so that no chunk is part written when the
+ * child stops tracing. Events buffered before the fork are the parent's to
+ * write.
+ */
+static void
+prepare(void)
+{
+	spinlock();
+}
+
+static void
+parent(void)
+{
+	unlock();
+}
+
+static void
+child(void)
+{
+	struct great_context *ctx;
+
+	great_trace_enabled = false;
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		ctx->trace.n = 0;
+	}
+
+	if (fd != -1) {
+		great_close(fd);
+		fd = -1;
+	}
+
+	unlock();
+}
+
+void
+great_trace_init(void)
+{
+	const char *prefix;
+	char path[4096];
+
+	prefix = getenv("GREAT_ALLOC_TRACE");
+	if (!prefix || 0 == strlen(prefix)) {
+		return;
+	}
+
+	if (!great_out_name(path, sizeof path, prefix, great_pid(), 0, "trace")) {
+		great_log(GREAT_LOG_ERROR, "GREAT_ALLOC_TRACE",
+			"Path too long; tracing disabled");
+		return;
+	}
+
+	fd = great_open(path);
+	if (-1 == fd) {
+		great_log(GREAT_LOG_ERROR, "GREAT_ALLOC_TRACE",
+			"Unable to open %s; tracing disabled", path);
+		return;
+	}
+
+	if (!great_writefd(fd, GREAT_TRACE_MAGIC, strlen(GREAT_TRACE_MAGIC))) {
+		great_close(fd);
+		fd = -1;
+		return;
+	}
+
+	if (!great_atfork(prepare, parent, child)) {
+		great_log(GREAT_LOG_ERROR, "GREAT_ALLOC_TRACE",
+			"Unable to handle fork(); tracing disabled");
+		great_close(fd);
+		fd = -1;
+		return;
+	}
+
+	start = great_clock();
+	great_trace_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_ALLOC_TRACE", "Tracing to %s", path);
+}
+
+void
+great_trace_malloc(struct great_context *ctx, size_t size, void *p)
+{
+	unsigned char *q;
+
+	assert(ctx);
+
+	q = event(ctx, GREAT_TRACE_MALLOC, p);
+	q += varint(q, size);
+	end(ctx, q);
+}
+
+void
+great_trace_realloc(struct great_context *ctx, void *ptr, size_t size,
+	void *p)
+{
+	unsigned char *q;
+	uintptr_t prev;
+
+	assert(ctx);
+
+	prev = ctx->trace.ptr;
+
+	q = event(ctx, GREAT_TRACE_REALLOC, p);
+
+	/* event() may have begun a new chunk */
+	if (0 == ctx->trace.n) {
+		prev = 0;
+	}
+
+	q += zigzag(q, prev, (uintptr_t) ptr);
+	q += varint(q, size);
+	end(ctx, q);
+}
+
+void
+great_trace_free(struct great_context *ctx, void *ptr)
+{
+	assert(ctx);
+
+	end(ctx, event(ctx, GREAT_TRACE_FREE, ptr));
+}
+
+void
+great_trace_fini(void)
+{
+	struct great_context *ctx;
+
+	for (ctx = great_context_first(); ctx; ctx = ctx->next) {
+		flush(&ctx->trace);
+	}
+
+	spinlock();
+
+	if (fd != -1) {
+		great_close(fd);
+		fd = -1;
+	}
+
+	unlock();
+}
+
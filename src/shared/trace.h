@@ -0,0 +1,116 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation trace capture.
+ *
+ * When $GREAT_ALLOC_TRACE is set to a path prefix, every call to malloc(),
+ * realloc() and free() is written to a binary trace file named
+ * "prefix.pid.0.trace", for replay by tools/great-replay. Events are gathered
+ * in a per-thread buffer, and written out a buffer at a time.
+ *
+ * The file starts with GREAT_TRACE_MAGIC, and is followed by chunks, each of
+ * which holds consecutive events from one thread. All integers are unsigned
+ * LEB128 varints; those marked (z) are zigzag-encoded signed differences.
+ *
+ *	chunk:	thread, length in bytes of the events which follow, events
+ *	event:	op, time (ns since the previous event in the chunk), ptr (z),
+ *		[old (z), for realloc], [size, for malloc and realloc]
+ *
+ * The time for the first event in a chunk is from the start of tracing.
+ * Pointers are given as differences from the previous event's ptr in the chunk
+ * (the first from 0), as is old; they identify objects, and a null ptr is a
+ * failed call. Since
+ * chunks from different threads are interleaved, events are to be ordered by
+ * time.
+ *
+ * Calls made whilst a thread's context is being created are not traced.
+ * Tracing is not continued in children forked by the application, since
+ * their events would be interleaved with the parent's in the same file.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_TRACE_H
+#define GREAT_SHARED_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define GREAT_TRACE_MAGIC "GREATTRACE1\n"
+
+enum great_trace_op {
+	GREAT_TRACE_MALLOC  = 0,
+	GREAT_TRACE_FREE    = 1,
+	GREAT_TRACE_REALLOC = 2
+};
+
+#define GREAT_TRACE_BUFFER 16384
+
+struct great_context;
+
+/*
+ * Per-thread buffer, kept in struct great_context. Consider this private.
+ */
+struct great_trace {
+	unsigned long thread;	/* owner of the events buffered */
+	uint64_t time;	/* of the previous event buffered */
+	uintptr_t ptr;	/* of the previous event buffered */
+	size_t n;
+	unsigned char buf[GREAT_TRACE_BUFFER];
+};
+
+extern bool great_trace_enabled;
+
+/*
+ * Initialise from $GREAT_ALLOC_TRACE. This must be called before use.
+ */
+void
+great_trace_init(void);
+
+void
+great_trace_malloc(struct great_context *ctx, size_t size, void *p);
+
+void
+great_trace_realloc(struct great_context *ctx, void *ptr, size_t size,
+	void *p);
+
+void
+great_trace_free(struct great_context *ctx, void *ptr);
+
+/*
+ * Write out all buffered events and close the trace.
+ */
+void
+great_trace_fini(void);
+
+#endif
+
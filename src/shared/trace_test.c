@@ -0,0 +1,336 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation trace capture. This sets $GREAT_ALLOC_TRACE itself, and decodes
+ * the trace written.
+ *
+ * Several threads each make enough calls to fill their buffers a few times
+ * over, so that chunks from different threads are interleaved in the file.
+ * Every event is to be found in its thread's chunks, in the order made.
+ *
+ * $Id$
+ */
+
+/* Required for setenv() and pthread_barrier_wait() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "trace.h"
+#include "context.h"
+#include "out.h"
+#include "log.h"
+#include "../proc.h"
+
+#define PREFIX  "trace_test"
+#define THREADS 4
+#define CALLS   5000
+#define EVENTS  (3 * CALLS + 1)
+
+struct event {
+	enum great_trace_op op;
+	uintptr_t ptr;
+	uintptr_t old;
+	uint64_t size;
+};
+
+struct thread {
+	unsigned long id;
+	size_t n;	/* events made, and then events found */
+	uint64_t time;	/* of the last event found */
+	struct event e[EVENTS];
+};
+
+static struct thread threads[THREADS];
+static pthread_barrier_t barrier;
+
+static void
+made(struct thread *t, enum great_trace_op op, void *ptr, void *old,
+	size_t size)
+{
+	struct event *e;
+
+	assert(t->n < EVENTS);
+
+	e = &t->e[t->n++];
+	e->op   = op;
+	e->ptr  = (uintptr_t) ptr;
+	e->old  = (uintptr_t) old;
+	e->size = size;
+}
+
+/*
+ * Allocate, grow and free CALLS blocks, and make one failed call.
+ *
+ * Every thread waits for the others before exiting, so that no context is
+ * passed on to another thread part-way.
+ */
+static void *
+allocate(void *arg)
+{
+	struct great_context *ctx;
+	struct thread *t = arg;
+	size_t i;
+
+	ctx = great_context();
+	assert(ctx);
+
+	t->id = ctx->id;
+
+	for (i = 0; i < CALLS; i++) {
+		size_t size;
+		void *p, *q;
+
+		size = i % 100 + 1;
+
+		p = malloc(size);
+		assert(p);
+
+		great_trace_malloc(ctx, size, p);
+		made(t, GREAT_TRACE_MALLOC, p, NULL, size);
+
+		/* as for a realloc() which moves the block */
+		q = malloc(size * 2);
+		assert(q);
+
+		great_trace_realloc(ctx, p, size * 2, q);
+		made(t, GREAT_TRACE_REALLOC, q, p, size * 2);
+		free(p);
+
+		great_trace_free(ctx, q);
+		made(t, GREAT_TRACE_FREE, q, NULL, 0);
+		free(q);
+	}
+
+	great_trace_malloc(ctx, SIZE_MAX, NULL);
+	made(t, GREAT_TRACE_MALLOC, NULL, NULL, SIZE_MAX);
+
+	(void) pthread_barrier_wait(&barrier);
+
+	return NULL;
+}
+
+static bool
+varint(const unsigned char **p, const unsigned char *end, uint64_t *u)
+{
+	unsigned int shift;
+
+	*u = 0;
+
+	for (shift = 0; *p < end && shift < 64; shift += 7) {
+		unsigned char c = *(*p)++;
+
+		*u |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+zigzag(const unsigned char **p, const unsigned char *end, uintptr_t base,
+	uintptr_t *ptr)
+{
+	uint64_t u;
+	int64_t d;
+
+	if (!varint(p, end, &u)) {
+		return false;
+	}
+
+	d = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+	*ptr = base + (uintptr_t) d;
+
+	return true;
+}
+
+/*
+ * Check the events in one chunk against those made by its thread, returning
+ * the number of events.
+ */
+static size_t
+chunk(struct thread *t, const unsigned char *p, const unsigned char *end)
+{
+	uintptr_t prev;
+	uint64_t time;
+	size_t n;
+
+	prev = 0;
+	time = 0;
+
+	for (n = 0; p < end; n++) {
+		const struct event *e;
+		uintptr_t ptr, old;
+		uint64_t u;
+
+		assert(t->n < EVENTS);
+		e = &t->e[t->n++];
+
+		assert(*p == (unsigned char) e->op);
+		p++;
+
+		assert(varint(&p, end, &u));
+		time += u;
+		assert(time >= t->time);
+		t->time = time;
+
+		assert(zigzag(&p, end, prev, &ptr));
+		assert(ptr == e->ptr);
+
+		if (e->op == GREAT_TRACE_REALLOC) {
+			assert(zigzag(&p, end, prev, &old));
+			assert(old == e->old);
+		}
+
+		if (e->op != GREAT_TRACE_FREE) {
+			assert(varint(&p, end, &u));
+			assert(u == e->size);
+		}
+
+		prev = ptr;
+	}
+
+	return n;
+}
+
+int
+main(void)
+{
+	pthread_t tid[THREADS];
+	unsigned char *buf;
+	const unsigned char *p, *end;
+	unsigned long chunks;
+	char path[64];
+	size_t i, n;
+	FILE *f;
+
+	if (-1 == setenv("GREAT_ALLOC_TRACE", PREFIX, 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	great_log_init("trace_test", NULL);
+	great_context_init();
+	great_trace_init();
+	assert(great_trace_enabled);
+
+	if (0 != pthread_barrier_init(&barrier, NULL, THREADS)) {
+		perror("pthread_barrier_init");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, allocate, &threads[i])) {
+			perror("pthread_create");
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			return EXIT_FAILURE;
+		}
+	}
+
+	great_trace_fini();
+
+	assert(great_out_name(path, sizeof path, PREFIX, great_pid(), 0,
+		"trace"));
+
+	f = fopen(path, "rb");
+	assert(f);
+
+	buf = malloc(THREADS * EVENTS * 64);
+	assert(buf);
+
+	n = fread(buf, 1, THREADS * EVENTS * 64, f);
+	assert(feof(f) && !ferror(f));
+
+	fclose(f);
+	(void) remove(path);
+
+	assert(n > strlen(GREAT_TRACE_MAGIC));
+	assert(0 == memcmp(buf, GREAT_TRACE_MAGIC, strlen(GREAT_TRACE_MAGIC)));
+
+	for (i = 0; i < THREADS; i++) {
+		threads[i].n    = 0;
+		threads[i].time = 0;
+	}
+
+	chunks = 0;
+
+	p   = buf + strlen(GREAT_TRACE_MAGIC);
+	end = buf + n;
+
+	while (p < end) {
+		uint64_t thread, len;
+
+		assert(varint(&p, end, &thread) && varint(&p, end, &len));
+		assert(len > 0 && len <= (uint64_t) (end - p));
+
+		for (i = 0; i < THREADS; i++) {
+			if (threads[i].id == thread) {
+				break;
+			}
+		}
+
+		assert(i < THREADS);
+
+		assert(chunk(&threads[i], p, p + len) > 0);
+
+		p += len;
+		chunks++;
+	}
+
+	/* Every event was found */
+	for (i = 0; i < THREADS; i++) {
+		assert(threads[i].n == EVENTS);
+	}
+
+	assert(chunks > THREADS);
+
+	free(buf);
+
+	printf("trace_test: %lu events in %lu chunks\n",
+		(unsigned long) THREADS * EVENTS, chunks);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Budgets shared across a process tree.
+ *
+ * The control block (struct great_tree_block) is a fixed-size file, mapped
+ * shared by every process attached to it. It begins with a magic number, which
+ * the first process to attach writes into a newly-created (and so zeroed)
+ * file, then the count of interceptions made by the whole tree, and the count
+ * of processes which have intercepted. There follows an open-addressing table
+ * of GREAT_TREE_SLOTS slots, one per function, each holding the function's
+ * subset path and its count of interceptions. Every field is updated
+ * atomically, and nothing is ever locked.
+ *
+ * A function finds its slot by hashing its path and probing linearly. An empty
+ * slot is claimed by moving it from EMPTY to CLAIMING by compare-and-swap; the
+ * winner writes the path and then marks the slot READY. A process which finds a
+ * slot CLAIMING waits for it to become READY before comparing paths. A process
+ * killed mid-claim would leave the slot CLAIMING forever, and so the wait is
+ * bounded by GREAT_TREE_CLAIMWAIT; past that, the slot is treated as taken by
+ * some other path. (Should the claimant merely have been delayed that long, and
+ * be claiming the same path, the function's budget is split across two slots.)
+ *
+ * Slots are never released. Once every slot is taken, and for paths of
+ * GREAT_TREE_PATHLEN bytes or more, a function has no shared count: an error is
+ * logged, and that function's budget applies to each process separately, as
+ * if $GREAT_TREE were not set.
+ *
+ * The limits are checked in turn, each only once the previous allowed the
+ * call: first this process's membership under $GREAT_TREE_PROCESSES (taken on
+ * its first interception, and kept whether or not the call goes on to be made),
+ * then the function's own budget, then $GREAT_TREE_BUDGET. A call refused by
+ * the function's budget does not count towards $GREAT_TREE_BUDGET; a call
+ * refused by $GREAT_TREE_BUDGET gives back its count for the function, and once
+ * $GREAT_TREE_BUDGET is spent, functions' counts are left alone.
+ *
+ * $Id$
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "log.h"
+#include "../map.h"
+#include "../proc.h"
+#include "../clock.h"
+
+/* Identifies a control block of this layout */
+#define MAGIC 0x67726561746c7431UL
+
+#define SLOTS    GREAT_TREE_SLOTS
+#define PATHLEN  GREAT_TREE_PATHLEN
+#define EMPTY    GREAT_TREE_EMPTY
+#define CLAIMING GREAT_TREE_CLAIMING
+#define READY    GREAT_TREE_READY
+
+bool great_tree_enabled;
+
+static struct great_tree_block *block;
+static unsigned long treebudget;
+static unsigned long processes;
+
+/* Whether this process counts towards processes; 0 if yet to intercept */
+static int member;
+
+static unsigned long
+limit(const char *env)
+{
+	const char *s;
+	unsigned long l;
+	char *e;
+
+	s = getenv(env);
+	if (!s || 0 == strlen(s)) {
+		return 0;
+	}
+
+	errno = 0;
+	l = strtoul(s, &e, 10);
+	if (*s < '0' || *s > '9' || *e != '\0' || ERANGE == errno || l == 0) {
+		great_log(GREAT_LOG_ERROR, env,
+			"Invalid limit: \"%s\"; disregarding", s);
+		return 0;
+	}
+
+	return l;
+}
+
+/*
+ * A child forked has yet to intercept.
+ */
+static void
+child(void)
+{
+	member = 0;
+}
+
+void
+great_tree_init(void)
+{
+	unsigned long magic;
+	const char *s;
+
+	s = getenv("GREAT_TREE");
+	if (!s || 0 == strlen(s)) {
+		return;
+	}
+
+	block = great_map_file(s, sizeof *block);
+	if (!block) {
+		great_log(GREAT_LOG_ERROR, "GREAT_TREE",
+			"Unable to map %s; sharing disabled", s);
+		return;
+	}
+
+	/* A block newly created is all zeroes, which is ready to use */
+	magic = 0;
+	if (!__atomic_compare_exchange_n(&block->magic, &magic, MAGIC, false,
+		__ATOMIC_RELAXED, __ATOMIC_RELAXED) && magic != MAGIC) {
+		great_log(GREAT_LOG_ERROR, "GREAT_TREE",
+			"%s is not a control block; sharing disabled", s);
+		great_unmap(block, sizeof *block);
+		block = NULL;
+		return;
+	}
+
+	treebudget = limit("GREAT_TREE_BUDGET");
+	processes  = limit("GREAT_TREE_PROCESSES");
+
+	if (processes != 0 && !great_atfork(NULL, NULL, child)) {
+		great_log(GREAT_LOG_ERROR, "GREAT_TREE_PROCESSES",
+			"Unable to follow fork(); disregarding");
+		processes = 0;
+	}
+
+	great_tree_enabled = true;
+
+	great_log(GREAT_LOG_INFO, "GREAT_TREE",
+		"Sharing budgets by way of %s", s);
+
+	if (treebudget != 0) {
+		great_log(GREAT_LOG_INFO, "GREAT_TREE_BUDGET",
+			"At most %lu interceptions across the tree", treebudget);
+	}
+
+	if (processes != 0) {
+		great_log(GREAT_LOG_INFO, "GREAT_TREE_PROCESSES",
+			"At most %lu processes intercepting", processes);
+	}
+}
+
+unsigned long *
+great_tree_counter(const char *path)
+{
+	const unsigned char *p;
+	uint64_t start;
+	uint32_t h;
+	size_t i;
+	size_t n;
+	int state;
+
+	assert(path);
+
+	if (!great_tree_enabled || strlen(path) >= PATHLEN) {
+		return NULL;
+	}
+
+	/* FNV-1a */
+	h = 2166136261U;
+	for (p = (const unsigned char *) path; *p; p++) {
+		h = (h ^ *p) * 16777619U;
+	}
+
+	for (n = 0; n < SLOTS; n++) {
+		i = (h + n) & (SLOTS - 1);
+
+		state = EMPTY;
+		if (__atomic_compare_exchange_n(&block->slot[i].state, &state, CLAIMING,
+			false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+			strcpy(block->slot[i].path, path);
+			__atomic_store_n(&block->slot[i].state, READY, __ATOMIC_RELEASE);
+			return &block->slot[i].injected;
+		}
+
+		/* Another process is naming this slot; it does so promptly */
+		start = great_clock();
+		while (state == CLAIMING
+		&& great_clock() - start < GREAT_TREE_CLAIMWAIT) {
+			state = __atomic_load_n(&block->slot[i].state, __ATOMIC_ACQUIRE);
+		}
+
+		if (state == CLAIMING) {
+			great_log(GREAT_LOG_ERROR, "GREAT_TREE",
+				"Slot %lu left unnamed; passing over it",
+				(unsigned long) i);
+			continue;
+		}
+
+		if (0 == strcmp(block->slot[i].path, path)) {
+			return &block->slot[i].injected;
+		}
+	}
+
+	great_log(GREAT_LOG_ERROR, "GREAT_TREE",
+		"No room for %s; not shared", path);
+
+	return NULL;
+}
+
+bool
+great_tree_take(unsigned long *counter, unsigned long budget)
+{
+	unsigned long n;
+	int none;
+	int m;
+
+	assert(block);
+	assert(counter);
+
+	if (processes != 0) {
+		m = __atomic_load_n(&member, __ATOMIC_RELAXED);
+		if (m == 0) {
+			n = __atomic_add_fetch(&block->processes, 1, __ATOMIC_RELAXED);
+			m = n <= processes ? 1 : -1;
+
+			/* Another thread of this process may have decided first */
+			none = 0;
+			if (!__atomic_compare_exchange_n(&member, &none, m, false,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+				if (m > 0) {
+					__atomic_sub_fetch(&block->processes, 1, __ATOMIC_RELAXED);
+				}
+				m = __atomic_load_n(&member, __ATOMIC_RELAXED);
+			}
+		}
+
+		if (m < 0) {
+			return false;
+		}
+	}
+
+	if (treebudget != 0
+	&& __atomic_load_n(&block->injected, __ATOMIC_RELAXED) >= treebudget) {
+		return false;
+	}
+
+	n = __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+	if (budget != 0 && n > budget) {
+		return false;
+	}
+
+	if (treebudget != 0) {
+		n = __atomic_add_fetch(&block->injected, 1, __ATOMIC_RELAXED);
+		if (n > treebudget) {
+			/* The function's share is returned, for what remains of its budget */
+			__atomic_sub_fetch(counter, 1, __ATOMIC_RELAXED);
+			return false;
+		}
+	}
+
+	return true;
+}
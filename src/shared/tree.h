@@ -0,0 +1,122 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Budgets shared across a process tree.
+ *
+ * By default each process decides for itself; a supervisor which forks a
+ * dozen workers sees a dozen times the interceptions, and $GREAT_BUDGET
+ * applies to each process separately. When $GREAT_TREE is set non-empty, it
+ * names a file holding a control block shared by every process given the same
+ * path. The first process to find the file missing creates it; descendants
+ * inherit the mapping across fork(), and attach to it again after exec(),
+ * since they inherit the environment too. With a control block:
+ *
+ *	$GREAT_BUDGET='10'		at most ten interceptions per function,
+ *					across every process sharing the block
+ *	$GREAT_TREE_BUDGET='10'		at most ten interceptions in all
+ *	$GREAT_TREE_PROCESSES='1'	only the first process to intercept may
+ *					intercept
+ *
+ * A process counts towards $GREAT_TREE_PROCESSES for the rest of its life once
+ * it has intercepted, and children forked afterwards count afresh. Functions
+ * are counted by subset path, and so malloc() counts as one function whichever
+ * API wraps it, in whichever library.
+ *
+ * The block's counters are updated only once a call has been decided to be
+ * intercepted, and so sharing costs one atomic addition per interception (two
+ * with $GREAT_TREE_BUDGET). The file is not removed; to start afresh, remove
+ * it before starting the tree.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_SHARED_TREE_H
+#define GREAT_SHARED_TREE_H
+
+#include <stdbool.h>
+
+/* Functions per control block; a power of two */
+#define GREAT_TREE_SLOTS 256
+
+/* The longest subset path shared, including the terminating null */
+#define GREAT_TREE_PATHLEN 64
+
+/* The most time to wait for another process to name a slot, in nanoseconds */
+#define GREAT_TREE_CLAIMWAIT 10000000
+
+/*
+ * The control block, as mapped from the file named by $GREAT_TREE; see tree.c.
+ * Consider this private.
+ */
+enum great_tree_state {
+	GREAT_TREE_EMPTY,
+	GREAT_TREE_CLAIMING,
+	GREAT_TREE_READY
+};
+
+struct great_tree_block {
+	unsigned long magic;
+	unsigned long injected;	/* by all functions */
+	unsigned long processes;	/* which have intercepted */
+
+	struct {
+		int state;	/* enum great_tree_state */
+		char path[GREAT_TREE_PATHLEN];
+		unsigned long injected;
+	} slot[GREAT_TREE_SLOTS];
+};
+
+extern bool great_tree_enabled;
+
+/*
+ * Attach to the control block named by $GREAT_TREE. This must be called before
+ * use, and ought to be called with subsets disabled.
+ */
+void
+great_tree_init(void);
+
+/*
+ * Return the shared count of interceptions for the function with the given
+ * subset path, or NULL if there is no control block, no room in it, or the
+ * path is too long to share.
+ */
+unsigned long *
+great_tree_counter(const char *path);
+
+/*
+ * Count an interception about to be made by a function with the shared count
+ * counter, and return true if the function's budget (or 0 for no limit), the
+ * tree's budget and the tree's limit on processes all allow it.
+ */
+bool
+great_tree_take(unsigned long *counter, unsigned long budget);
+
+#endif
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Budgets shared across a process tree. This sets $GREAT_TREE and the limits
+ * itself, and forks a process for each member of the tree, each of which
+ * intercepts from several threads at once.
+ *
+ * $Id$
+ */
+
+/* Required for setenv(), fork() and so on */
+#define _POSIX_C_SOURCE 200112L
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "tree.h"
+#include "log.h"
+#include "../map.h"
+#include "../clock.h"
+
+#define BLOCK    "tree_test.blk"
+#define CHILDREN 4
+#define THREADS  4
+#define CALLS    1000
+#define BUDGET   100
+
+static const char *const path[2] = { "test:tree:a", "test:tree:b" };
+
+static unsigned long *counter[2];
+static unsigned long budget;
+static unsigned long taken;
+
+static void *
+takes(void *arg)
+{
+	unsigned long i;
+
+	(void) arg;
+
+	for (i = 0; i < CALLS; i++) {
+		if (great_tree_take(counter[i % 2], budget)) {
+			__atomic_add_fetch(&taken, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Attach to the block and intercept from each thread, returning the number of
+ * interceptions allowed.
+ */
+static unsigned long
+member(void)
+{
+	pthread_t tid[THREADS];
+	int i;
+
+	great_tree_init();
+	assert(great_tree_enabled);
+
+	for (i = 0; i < 2; i++) {
+		counter[i] = great_tree_counter(path[i]);
+		assert(counter[i]);
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_create(&tid[i], NULL, takes, NULL)) {
+			perror("pthread_create");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i = 0; i < THREADS; i++) {
+		if (0 != pthread_join(tid[i], NULL)) {
+			perror("pthread_join");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return taken;
+}
+
+/*
+ * Run n members of a tree at once with the given limits, and fill t[] with
+ * the interceptions each was allowed. The block is kept if fresh is false.
+ */
+static void
+tree(bool fresh, const char *treebudget, const char *processes,
+	unsigned long b, unsigned long t[], int n)
+{
+	int fd[2];
+	pid_t pid[CHILDREN];
+	int status;
+	int i;
+
+	assert(n <= CHILDREN);
+
+	if (fresh) {
+		(void) remove(BLOCK);
+	}
+
+	if (-1 == setenv("GREAT_TREE_BUDGET", treebudget, 1)
+	|| -1 == setenv("GREAT_TREE_PROCESSES", processes, 1)) {
+		perror("setenv");
+		exit(EXIT_FAILURE);
+	}
+
+	budget = b;
+
+	if (-1 == pipe(fd)) {
+		perror("pipe");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < n; i++) {
+		pid[i] = fork();
+		if (-1 == pid[i]) {
+			perror("fork");
+			exit(EXIT_FAILURE);
+		}
+
+		if (0 == pid[i]) {
+			unsigned long m;
+
+			m = member();
+			if (sizeof m != write(fd[1], &m, sizeof m)) {
+				_exit(EXIT_FAILURE);
+			}
+
+			_exit(EXIT_SUCCESS);
+		}
+	}
+
+	(void) close(fd[1]);
+
+	for (i = 0; i < n; i++) {
+		if (sizeof *t != read(fd[0], &t[i], sizeof *t)) {
+			fprintf(stderr, "tree_test: a member failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	(void) close(fd[0]);
+
+	for (i = 0; i < n; i++) {
+		if (-1 == waitpid(pid[i], &status, 0)
+		|| !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+			fprintf(stderr, "tree_test: a member failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static unsigned long
+sum(const unsigned long t[], int n)
+{
+	unsigned long total;
+	int i;
+
+	total = 0;
+	for (i = 0; i < n; i++) {
+		total += t[i];
+	}
+
+	return total;
+}
+
+/*
+ * Find the slot holding the given path, or return -1.
+ */
+static int
+find(const struct great_tree_block *b, const char *p)
+{
+	int i;
+
+	for (i = 0; i < GREAT_TREE_SLOTS; i++) {
+		if (b->slot[i].state == GREAT_TREE_READY
+		&& 0 == strcmp(b->slot[i].path, p)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int
+main(void)
+{
+	struct great_tree_block *b;
+	unsigned long t[CHILDREN];
+	uint64_t start;
+	int members;
+	int i, j;
+
+	great_log_init("tree_test", NULL);
+
+	if (-1 == setenv("GREAT_TREE", BLOCK, 1)) {
+		perror("setenv");
+		return EXIT_FAILURE;
+	}
+
+	/* Each function's budget is shared by every thread of every process */
+	tree(true, "", "", BUDGET, t, CHILDREN);
+	assert(sum(t, CHILDREN) == 2 * BUDGET);
+
+	/* As is the tree's budget, across functions */
+	tree(true, "50", "", 0, t, CHILDREN);
+	assert(sum(t, CHILDREN) == 50);
+
+	/* Only one process may intercept, and it may intercept every time */
+	tree(true, "", "1", 0, t, CHILDREN);
+	for (i = 0, members = 0; i < CHILDREN; i++) {
+		if (t[i] != 0) {
+			assert(t[i] == THREADS * CALLS);
+			members++;
+		}
+	}
+	assert(members == 1);
+
+	/*
+	 * A slot left claimed by a process which died mid-claim is passed over,
+	 * after a bounded wait, and the function's count goes in another slot.
+	 */
+	tree(true, "", "", 0, t, 1);
+
+	b = great_map_file(BLOCK, sizeof *b);
+	assert(b);
+
+	i = find(b, path[0]);
+	assert(i != -1);
+
+	memset(b->slot, 0, sizeof b->slot);
+	b->slot[i].state = GREAT_TREE_CLAIMING;
+
+	start = great_clock();
+	tree(false, "", "", BUDGET, t, 1);
+	assert(great_clock() - start >= GREAT_TREE_CLAIMWAIT);
+	assert(t[0] == 2 * BUDGET);
+
+	j = find(b, path[0]);
+	assert(j != -1 && j != i);
+	assert(b->slot[i].state == GREAT_TREE_CLAIMING);
+	assert(b->slot[j].injected >= BUDGET);
+
+	great_unmap(b, sizeof *b);
+	(void) remove(BLOCK);
+
+	printf("tree_test: passed\n");
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Thread interfaces.
+ *
+ * $Id$
+ */
+
+#ifndef GREAT_PORT_THREAD_H
+#define GREAT_PORT_THREAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Return an identifier for the calling thread. This is intended for display
+ * only; it need not be unique across the lifetime of the process.
+ */
+unsigned long
+great_thread_id(void);
+
+/*
+ * Write the calling thread's name to buf, limited to length len (including
+ * the terminating null).
+ *
+ * Returns false on error, or if threads are not named on this system.
+ */
+bool
+great_thread_name(char *buf, size_t len);
+
+/*
+ * Arrange for f(p) to be called when the calling thread exits. Only one such
+ * function may be registered per thread; subsequent calls replace p.
+ *
+ * Returns false on error.
+ */
+bool
+great_thread_atexit(void (*f)(void *p), void *p);
+
+#endif
+
@@ -33,15 +33,23 @@
  *
  * $Id$
  *
- * Our approach here is to populate our own list of function pointers
- * during initialisation. These may then be referenced by our own functions.
+ * Our approach here is to keep our own list of function pointers, which may
+ * then be referenced by our own functions.
  *
  * These lists are maintained in each API's implementation - see <api>/wrap.h.
- * They are populated during each API's _init() routine. If they fail to
- * locate the symbols required from the underlying libraries, they are expected
- * to abort().
+ * Each pointer starts out null, and is resolved by name on its first use by
+ * way of GREAT_WRAP_REAL(), so that a process pays only for the functions it
+ * actually calls. If the symbol required cannot be located from the underlying
+ * libraries, we abort().
  *
  * Only the functions overloaded are expected to be wrapped.
+ *
+ * Where GREAT_WRAP_STATIC is defined, the wrappers are instead compiled for
+ * link-time interposition by ld --wrap (see mk/static.mk). Each wrapper is then
+ * named __wrap_f, and calls the real function by way of __real_f, which the
+ * linker binds directly; there is no list to resolve, and no use of dlsym().
+ * Since _init is reserved to the program itself in a static link, setup and
+ * teardown are made constructors and destructors instead.
  */
 
 #ifndef GREAT_SHARED_WRAP_H
@@ -55,5 +63,91 @@
 void (*
 great_wrap_resolve(const char *functionname))(void);
 
+/*
+ * The address to which the calling wrapper returns, as its call site, or NULL
+ * where this cannot be had. This is only meaningful in the wrapper itself, and
+ * only until the wrapper calls anything which may itself be wrapped; a wrapper
+ * which needs its caller after that must keep it first. That includes the
+ * wrapper's subset test, whose memo is filled on first use by matching
+ * $GREAT_SUBSETS, which may allocate; wrappers therefore keep their caller on
+ * entry.
+ *
+ * The unified library's exports call each wrapper by way of a table (see
+ * api/unified/wrap.c), and so the wrapper's own return address would be the
+ * export's, unless the compiler happened to make a tail call. Each export
+ * instead sets great_wrap_caller to its own return address, for the thread
+ * calling it, and that is given here.
+ */
+#ifdef __GNUC__
+#define GREAT_WRAP_RETURN() __builtin_return_address(0)
+#else
+#define GREAT_WRAP_RETURN() NULL
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+extern __thread const void *great_wrap_caller;
+#define GREAT_WRAP_CALLER() great_wrap_caller
+#else
+#define GREAT_WRAP_CALLER() GREAT_WRAP_RETURN()
+#endif
+
+/*
+ * The library is built with hidden visibility (see mk/cc/gcc.mk), so that its
+ * internal calls bind directly. GREAT_WRAP_VISIBLE marks a definition which
+ * is to be exported nonetheless, and GREAT_WRAP_EXPORT marks the definition of
+ * a wrapper, which is exported except from the unified library (where the
+ * wrappers are reached by way of its own exports instead).
+ */
+#ifdef __GNUC__
+#define GREAT_WRAP_VISIBLE __attribute__((visibility("default")))
+#else
+#define GREAT_WRAP_VISIBLE
+#endif
+
+#ifdef GREAT_WRAP_UNIFIED
+#define GREAT_WRAP_EXPORT
+#else
+#define GREAT_WRAP_EXPORT GREAT_WRAP_VISIBLE
+#endif
+
+#ifdef GREAT_WRAP_STATIC
+
+#define GREAT_WRAP_NAME(f) __wrap_##f
+#define GREAT_WRAP_REAL(list, f) __real_##f
+
+#define GREAT_WRAP_INIT(api) __attribute__((constructor)) great_##api##_init
+#define GREAT_WRAP_FINI(api) __attribute__((destructor)) great_##api##_fini
+
+#else
+
+/*
+ * The name under which the wrapper for f is exported.
+ */
+#define GREAT_WRAP_NAME(f) f
+
+/*
+ * The names of an API's setup and teardown functions.
+ */
+#define GREAT_WRAP_INIT(api) _init
+#define GREAT_WRAP_FINI(api) _fini
+
+/*
+ * Give the real function for member f of an API's list of function pointers,
+ * resolving it by the member's name if this has not yet been done. The member
+ * must be named for the function it points to.
+ *
+ * Resolution is safe for concurrent use without locking: threads racing to
+ * resolve the same function each find the same address, and the pointer is
+ * published atomically, so every thread sees either null or the final value.
+ */
+#define GREAT_WRAP_REAL(list, f) \
+	(__atomic_load_n(&(list).f, __ATOMIC_ACQUIRE) \
+		? (list).f \
+		: (__atomic_store_n(&(list).f, \
+			(__typeof__((list).f)) great_wrap_resolve(#f), \
+			__ATOMIC_RELEASE), (list).f))
+
+#endif
+
 #endif
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ *
+ * Allocate blocks until malloc() fails, as it ought to at the limit given by
+ * $GREAT_MEM_LIMIT, which is to be given again in bytes as the argument.
+ * Exits non-zero unless the limit was met to within SLACK bytes.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#define BLOCK 1000
+#define SLACK 16384
+
+int main(int argc, char *argv[]) {
+	unsigned long limit, total;
+	void *p;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: memlimit_test <limit>\n");
+		return 2;
+	}
+
+	limit = strtoul(argv[1], NULL, 10);
+
+	total = 0;
+	while(total <= limit + SLACK) {
+		p = malloc(BLOCK);
+		if(!p) {
+			break;
+		}
+
+		total += BLOCK;
+	}
+
+	if(total > limit || total + SLACK < limit) {
+		fprintf(stderr, "memlimit_test: %lu bytes for a limit of %lu\n",
+			total, limit);
+		return 1;
+	}
+
+	printf("memlimit_test: %lu bytes for a limit of %lu\n", total, limit);
+
+	return 0;
+}
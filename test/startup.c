@@ -0,0 +1,308 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ *
+ * Measure the latency added to process startup by preloading each of the
+ * wrapper libraries given. A trivial program (this one, given -t) is spawned
+ * repeatedly, without any library preloaded and then with each library in
+ * turn, under each of several configurations:
+ *
+ *	empty	$GREAT_SUBSETS empty, so that nothing is intercepted
+ *	many	$GREAT_SUBSETS listing many patterns, none of which match
+ *	logfile	$GREAT_SUBSETS empty, logging appended to a file
+ *
+ * The configurations other than logfile log to /dev/null. So that the
+ * libraries are compared doing the same work, each library is first run once
+ * per configuration logging to a file, which must show every pattern
+ * registered and no errors; otherwise startup gives up. For each library
+ * and configuration, the mean time per process is given in microseconds,
+ * taking the best of several rounds, followed by the time added over the same
+ * configuration without a library:
+ *
+ *	../api/c99/libgreat_c99.so empty 512.3 +85.1
+ *
+ * Execute along the lines of:
+ * ./startup -n 2000 ../api/c99/libgreat_c99.so ../api/unified/libgreat.so
+ */
+
+/* Required for clock_gettime() and posix_spawn() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define LOGFILE "startup.log"
+#define CHECKFILE "startup.check"
+#define ROUNDS 5
+
+/* The number of patterns for the "many" configuration */
+#define PATTERNS 64
+
+/* Environment strings; these are not const for the sake of posix_spawn() */
+static char trivial[] = "-t";
+static char empty[]   = "GREAT_SUBSETS=";
+static char many[sizeof empty + PATTERNS * sizeof "/^stdio:nomatch00$"];
+static char devnull[] = "GREAT_LOG=/dev/null";
+static char logfile[] = "GREAT_LOG=" LOGFILE;
+static char checkfile[] = "GREAT_LOG=" CHECKFILE;
+
+static const struct {
+	const char *name;
+	char *subsets;
+	char *log;
+	int patterns;
+} configs[] = {
+	{ "empty",   empty, devnull, 0        },
+	{ "many",    many,  devnull, PATTERNS },
+	{ "logfile", empty, logfile, 0        }
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	if (-1 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * Spawn self -t with the given environment n times, and return the mean time
+ * per process in microseconds.
+ */
+static double
+run(char *self, char *envp[], long n)
+{
+	char *argv[3];
+	long i;
+	double t;
+
+	argv[0] = self;
+	argv[1] = trivial;
+	argv[2] = NULL;
+
+	t = now();
+
+	for (i = 0; i < n; i++) {
+		pid_t pid;
+		int status;
+
+		if (0 != posix_spawn(&pid, self, NULL, NULL, argv, envp)) {
+			perror(self);
+			exit(EXIT_FAILURE);
+		}
+
+		if (-1 == waitpid(pid, &status, 0)) {
+			perror("waitpid");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+			fprintf(stderr, "%s: child failed\n", self);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return (now() - t) / n / 1e3;
+}
+
+/*
+ * Spawn self -t once with the given environment, logging to CHECKFILE, and
+ * exit unless the log shows exactly the given number of patterns registered
+ * and no errors.
+ */
+static void
+check(char *self, char *envp[], const char *library, const char *config,
+	int patterns)
+{
+	char line[4096];
+	char *log;
+	FILE *f;
+	int registered;
+	int errors;
+
+	(void) remove(CHECKFILE);
+
+	log = envp[1];
+	envp[1] = checkfile;
+	(void) run(self, envp, 1);
+	envp[1] = log;
+
+	f = fopen(CHECKFILE, "r");
+	if (!f) {
+		perror(CHECKFILE);
+		exit(EXIT_FAILURE);
+	}
+
+	registered = 0;
+	errors = 0;
+
+	while (fgets(line, sizeof line, f)) {
+		if (strstr(line, " GREAT_SUBSETS INFO: Registered subset: ")) {
+			registered++;
+		}
+
+		if (strstr(line, " ERROR: ")) {
+			fprintf(stderr, "%s %s: %s", library, config, line);
+			errors++;
+		}
+	}
+
+	fclose(f);
+	(void) remove(CHECKFILE);
+
+	if (registered != patterns || errors > 0) {
+		fprintf(stderr, "%s %s: %d of %d patterns registered, %d errors\n",
+			library, config, registered, patterns, errors);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: startup [-n runs] library...\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char preload[4096];
+	char *envp[4];
+	char *self;
+	long n;
+	double *best;
+	size_t i;
+	int round;
+	int a;
+	int p;
+
+	/* The trivial program being timed */
+	if (argc == 2 && 0 == strcmp(argv[1], trivial)) {
+		return EXIT_SUCCESS;
+	}
+
+	self = argv[0];
+	if (!strchr(self, '/')) {
+		usage();
+	}
+
+	n = 2000;
+	a = 1;
+	if (argc > 2 && 0 == strcmp(argv[1], "-n")) {
+		n = strtol(argv[2], NULL, 10);
+		a = 3;
+	}
+
+	if (a >= argc || n <= 0) {
+		usage();
+	}
+
+	strcpy(many, empty);
+	for (p = 0; p < PATTERNS; p++) {
+		sprintf(many + strlen(many), "/^stdio:nomatch%02d$", p);
+	}
+	strcat(many, "/");
+
+	best = malloc(argc * sizeof *best);
+	if (!best) {
+		perror("malloc");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < sizeof configs / sizeof *configs; i++) {
+		envp[0] = configs[i].subsets;
+		envp[1] = configs[i].log;
+		envp[3] = NULL;
+
+		for (p = a; p < argc; p++) {
+			if (strlen(argv[p]) + sizeof "LD_PRELOAD=" > sizeof preload) {
+				fprintf(stderr, "%s: path too long\n", argv[p]);
+				return EXIT_FAILURE;
+			}
+
+			sprintf(preload, "LD_PRELOAD=%s", argv[p]);
+			envp[2] = preload;
+
+			check(self, envp, argv[p], configs[i].name, configs[i].patterns);
+		}
+
+		/*
+		 * Each round runs every library, so that drift in the machine's
+		 * state affects them alike. The best round is taken. Slot 0 of
+		 * best[] is for the run without a library.
+		 */
+		for (round = 0; round < ROUNDS; round++) {
+			for (p = a - 1; p < argc; p++) {
+				double t;
+
+				if (p == a - 1) {
+					envp[2] = NULL;
+				} else {
+					sprintf(preload, "LD_PRELOAD=%s", argv[p]);
+					envp[2] = preload;
+				}
+
+				t = run(self, envp, (n + ROUNDS - 1) / ROUNDS);
+				if (round == 0 || t < best[p - (a - 1)]) {
+					best[p - (a - 1)] = t;
+				}
+			}
+		}
+
+		printf("none %s %.1f\n", configs[i].name, best[0]);
+
+		for (p = a; p < argc; p++) {
+			printf("%s %s %.1f %+.1f\n", argv[p], configs[i].name,
+				best[p - (a - 1)], best[p - (a - 1)] - best[0]);
+		}
+
+		fflush(stdout);
+	}
+
+	free(best);
+
+	(void) remove(LOGFILE);
+
+	return EXIT_SUCCESS;
+}
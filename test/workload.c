@@ -0,0 +1,198 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * $Id$
+ *
+ * A representative workload for the wrappers, used to train profile-guided
+ * optimisation and to measure the cost per call (see mk/pgo.mk). Each group
+ * of calls is timed, and the best of several rounds is given in nanoseconds
+ * per call, one group per line:
+ *
+ *	malloc 21.3
+ *
+ * Comparing a run with a wrapper library preloaded against one without gives
+ * the overhead added by the wrappers. Calls which fail are tolerated, so that
+ * this may also be run with interception enabled.
+ */
+
+/* Required for clock_gettime() */
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <time.h>
+
+#define ROUNDS 5
+
+/* Results are kept here, so that the calls are not optimised away */
+static void *volatile sink;
+static volatile int isink;
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	if (-1 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* One malloc(), one realloc() and one free() per iteration */
+static void
+work_malloc(long n)
+{
+	long i;
+	void *p;
+	void *q;
+
+	for (i = 0; i < n; i++) {
+		p = malloc(16 + (i & 255) * 16);
+		sink = p;
+
+		q = realloc(p, 32 + (i & 255) * 32);
+		if (q) {
+			p = q;
+		}
+		sink = p;
+
+		free(p);
+	}
+}
+
+/*
+ * The functions are called by name in parentheses, in order to avoid macro
+ * equivalents defined in the system's <ctype.h> header.
+ */
+static void
+work_ctype(long n)
+{
+	long i;
+	int c;
+	int r;
+
+	r = 0;
+	for (i = 0; i < n; i++) {
+		c = (int) (i & 127);
+
+		r += (isalnum)(c);
+		r += (isalpha)(c);
+		r += (isdigit)(c);
+		r += (isspace)(c);
+	}
+
+	isink = r;
+}
+
+static void
+work_rand(long n)
+{
+	long i;
+	int r;
+
+	srand(1);
+
+	r = 0;
+	for (i = 0; i < n; i++) {
+		r ^= rand();
+	}
+
+	isink = r;
+}
+
+static void
+work_fopen(long n)
+{
+	long i;
+	FILE *f;
+
+	for (i = 0; i < n; i++) {
+		f = fopen("/dev/null", "r");
+		if (f) {
+			fclose(f);
+		}
+	}
+}
+
+static const struct group {
+	const char *name;
+	void (*work)(long n);
+	long scale;	/* iterations per n */
+	long calls;	/* calls per iteration */
+} groups[] = {
+	{ "malloc", work_malloc, 100, 3 },
+	{ "ctype",  work_ctype,  400, 4 },
+	{ "rand",   work_rand,   400, 1 },
+	{ "fopen",  work_fopen,  1,   1 }
+};
+
+int
+main(int argc, char *argv[])
+{
+	long n;
+	size_t i;
+	int round;
+	double t;
+	double best;
+
+	n = 10000;
+	if (argc > 1) {
+		n = strtol(argv[1], NULL, 10);
+	}
+
+	if (argc > 2 || n <= 0) {
+		fprintf(stderr, "usage: workload [iterations]\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < sizeof groups / sizeof *groups; i++) {
+		best = 0;
+
+		for (round = 0; round < ROUNDS; round++) {
+			t = now();
+			groups[i].work(n * groups[i].scale);
+			t = now() - t;
+
+			if (round == 0 || t < best) {
+				best = t;
+			}
+		}
+
+		printf("%s %.1f\n", groups[i].name,
+			best / (n * groups[i].scale * groups[i].calls));
+	}
+
+	return EXIT_SUCCESS;
+}
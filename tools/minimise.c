@@ -0,0 +1,737 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Failure schedule minimisation.
+ *
+ * The command is run once under $GREAT_RECORD (see src/shared/decision.h),
+ * with the environment as given, and is expected to fail: that is, to exit
+ * with a non-zero status, or to be killed by a signal. It is then run again
+ * and again under $GREAT_REPLAY, each time with a subset of the recorded
+ * interceptions, narrowing them by delta debugging (Zeller's ddmin) to a set
+ * from which no one interception may be removed whilst the command still
+ * fails the same way. Runs of each step are made in parallel; where several
+ * reproduce the failure, the first in order is taken, so that the result does
+ * not depend on which finishes first.
+ *
+ * The library to inject with is given by -p, rather than by $LD_PRELOAD, so
+ * that this program's own calls are left alone.
+ *
+ * The interceptions remaining are listed, and written as a recording which
+ * may be given to $GREAT_REPLAY in turn.
+ *
+ * $Id$
+ */
+
+/* Required for mkdtemp(), setenv(), kill() and sysconf() */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "../src/shared/decision.h"
+
+struct injection {
+	unsigned long thread;
+	uint64_t decision;	/* the thread's nth */
+	unsigned long id;	/* function */
+	size_t value;	/* index into values[] */
+	size_t values;
+};
+
+static const char *name;
+
+static unsigned char header[GREAT_DECISION_HEADER];
+static const char *function[GREAT_DECISION_HEADER / 2];	/* paths, by ID */
+static size_t functions;
+
+static struct injection *inj;
+static size_t ninj;
+static uint64_t *values;
+static size_t nvalues;
+
+static char **command;
+static const char *preload;
+static char dir[] = "/tmp/great-minimise.XXXXXX";
+static unsigned long jobs;
+static unsigned int timeout;
+static int signature;	/* wait status of the failure */
+static unsigned long runs;
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", name, msg);
+	exit(EXIT_FAILURE);
+}
+
+static void *
+grow(void *p, size_t *size, size_t n, size_t elem)
+{
+	if (n < *size) {
+		return p;
+	}
+
+	*size = *size ? *size * 2 : 1024;
+	p = realloc(p, *size * elem);
+	if (!p) {
+		die("out of memory");
+	}
+
+	return p;
+}
+
+static int
+varint(const unsigned char **p, const unsigned char *end, uint64_t *u)
+{
+	unsigned int shift;
+
+	*u = 0;
+
+	for (shift = 0; *p < end && shift < 64; shift += 7) {
+		unsigned char c = *(*p)++;
+
+		*u |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static size_t
+putvarint(unsigned char *p, uint64_t u)
+{
+	size_t n;
+
+	for (n = 0; u >= 0x80; u >>= 7) {
+		p[n++] = (unsigned char) (u | 0x80);
+	}
+
+	p[n++] = (unsigned char) u;
+
+	return n;
+}
+
+static unsigned char *
+slurp(const char *path, size_t *len)
+{
+	FILE *f;
+	unsigned char *buf;
+	size_t n, size;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	buf  = NULL;
+	size = 0;
+	n    = 0;
+
+	for (;;) {
+		size_t r;
+
+		buf = grow(buf, &size, n, 1);
+
+		r = fread(buf + n, 1, size - n, f);
+		if (0 == r) {
+			break;
+		}
+
+		n += r;
+	}
+
+	if (ferror(f)) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	fclose(f);
+
+	*len = n;
+	return buf;
+}
+
+/*
+ * Read the interceptions from a recording, ordered by thread and then by
+ * decision, each with the values drawn once it was intercepted.
+ */
+static void
+decode(const unsigned char *buf, size_t len)
+{
+	const unsigned char *p;
+	const unsigned char *nl;
+	unsigned long threads, t;
+	size_t injsize, valsize;
+	uint64_t end, o;
+
+	if (len < GREAT_DECISION_HEADER
+	|| 0 != memcmp(buf, GREAT_DECISION_MAGIC, strlen(GREAT_DECISION_MAGIC))) {
+		die("not a recording");
+	}
+
+	memcpy(header, buf, sizeof header);
+
+	p = header + strlen(GREAT_DECISION_MAGIC);
+	while (*p != '\0' && functions < sizeof function / sizeof *function) {
+		nl = memchr(p, '\n', (size_t) (header + GREAT_DECISION_END - p));
+		if (!nl) {
+			break;
+		}
+
+		header[nl - header] = '\0';
+		function[functions++] = (const char *) p;
+		p = nl + 1;
+	}
+
+	memcpy(&end, buf + GREAT_DECISION_END, sizeof end);
+	if (end > len) {
+		end = len;
+	}
+
+	threads = 0;
+	for (o = GREAT_DECISION_HEADER; o + GREAT_DECISION_CHUNK <= end;
+		o += GREAT_DECISION_CHUNK) {
+		struct great_decision_chunk c;
+
+		memcpy(&c, buf + o, sizeof c);
+		if (c.thread > threads) {
+			threads = c.thread;
+		}
+	}
+
+	injsize = 0;
+	valsize = 0;
+
+	/* A thread's chunks are in the order they were begun */
+	for (t = 1; t <= threads; t++) {
+		uint64_t last = 0;
+
+		for (o = GREAT_DECISION_HEADER; o + GREAT_DECISION_CHUNK <= end;
+			o += GREAT_DECISION_CHUNK) {
+			const unsigned char *q, *e;
+			struct great_decision_chunk c;
+			uint64_t tag, arg;
+
+			memcpy(&c, buf + o, sizeof c);
+			if (c.thread != t) {
+				continue;
+			}
+
+			q = buf + o + sizeof c;
+			e = q + (c.used <= GREAT_DECISION_ROOM ? c.used : GREAT_DECISION_ROOM);
+
+			while (q < e) {
+				if (!varint(&q, e, &tag) || !varint(&q, e, &arg)) {
+					die("malformed event");
+				}
+
+				if (tag == 1) {
+					if (0 == ninj || inj[ninj - 1].thread != t) {
+						die("value without an interception");
+					}
+
+					values = grow(values, &valsize, nvalues, sizeof *values);
+					values[nvalues++] = arg;
+					inj[ninj - 1].values++;
+					continue;
+				}
+
+				inj = grow(inj, &injsize, ninj, sizeof *inj);
+				last += tag / 2;
+				inj[ninj].thread   = t;
+				inj[ninj].decision = last;
+				inj[ninj].id       = (unsigned long) arg;
+				inj[ninj].value    = nvalues;
+				inj[ninj].values   = 0;
+				ninj++;
+			}
+		}
+	}
+}
+
+/*
+ * Write a recording of just the given interceptions, which are in the order
+ * given by decode().
+ */
+static void
+encode(const char *path, const size_t *set, size_t n)
+{
+	static unsigned char *buf;
+	static size_t size;
+	unsigned char ev[GREAT_DECISION_EVENT];
+	unsigned long thread;
+	uint64_t len, cur, last;
+	size_t i, k, m;
+	FILE *f;
+
+	while (size < GREAT_DECISION_HEADER) {
+		buf = grow(buf, &size, size, 1);
+	}
+
+	/* Restore the newlines taken by decode() */
+	memcpy(buf, header, GREAT_DECISION_HEADER);
+	for (i = 0; i < functions; i++) {
+		buf[(const unsigned char *) function[i] - header
+			+ strlen(function[i])] = '\n';
+	}
+
+	len    = GREAT_DECISION_HEADER;
+	cur    = 0;
+	last   = 0;
+	thread = 0;
+
+	for (i = 0; i < n; i++) {
+		const struct injection *j = &inj[set[i]];
+
+		if (j->thread != thread) {
+			thread = j->thread;
+			cur    = 0;
+			last   = 0;
+		}
+
+		for (k = 0; k <= j->values; k++) {
+			struct great_decision_chunk c;
+
+			if (k == 0) {
+				m  = putvarint(ev, 2 * (j->decision - last));
+				m += putvarint(ev + m, j->id);
+			} else {
+				m  = putvarint(ev, 1);
+				m += putvarint(ev + m, values[j->value + k - 1]);
+			}
+
+			if (cur != 0) {
+				memcpy(&c, buf + cur, sizeof c);
+			}
+
+			if (cur == 0 || c.used + m > GREAT_DECISION_ROOM) {
+				while (len + GREAT_DECISION_CHUNK > size) {
+					buf = grow(buf, &size, size, 1);
+				}
+
+				if (cur != 0) {
+					c.next = len;
+					memcpy(buf + cur, &c, sizeof c);
+				}
+
+				cur = len;
+				len += GREAT_DECISION_CHUNK;
+
+				memset(buf + cur, 0, GREAT_DECISION_CHUNK);
+				c.thread = (uint32_t) thread;
+				c.used   = 0;
+				c.next   = 0;
+			}
+
+			memcpy(buf + cur + sizeof c + c.used, ev, m);
+			c.used += (uint32_t) m;
+			memcpy(buf + cur, &c, sizeof c);
+		}
+
+		last = j->decision;
+	}
+
+	memcpy(buf + GREAT_DECISION_END, &len, sizeof len);
+
+	f = fopen(path, "wb");
+	if (!f || 1 != fwrite(buf, (size_t) len, 1, f) || 0 != fclose(f)) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/*
+ * Start the command with the given environment variable set to path, and
+ * with $GREAT_RECORD and $GREAT_REPLAY otherwise unset.
+ */
+static pid_t
+run(const char *env, const char *path)
+{
+	pid_t pid;
+	int fd;
+
+	runs++;
+
+	pid = fork();
+	if (-1 == pid) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pid != 0) {
+		return pid;
+	}
+
+	unsetenv("GREAT_RECORD");
+	unsetenv("GREAT_REPLAY");
+
+	if (-1 == setenv(env, path, 1)
+	|| (preload && -1 == setenv("LD_PRELOAD", preload, 1))) {
+		_exit(127);
+	}
+
+	fd = open("/dev/null", O_RDWR);
+	if (-1 != fd) {
+		(void) dup2(fd, STDIN_FILENO);
+		(void) dup2(fd, STDOUT_FILENO);
+		(void) dup2(fd, STDERR_FILENO);
+		(void) close(fd);
+	}
+
+	/* The alarm survives exec(), and kills the command unless it is caught */
+	if (timeout > 0) {
+		(void) alarm(timeout);
+	}
+
+	execvp(command[0], command);
+	_exit(127);
+}
+
+static int
+reap(pid_t pid)
+{
+	int status;
+
+	while (-1 == waitpid(pid, &status, 0)) {
+		if (errno != EINTR) {
+			perror("waitpid");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return status;
+}
+
+static int
+failed(int status)
+{
+	return WIFSIGNALED(status)
+		|| (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+}
+
+static int
+same(int status)
+{
+	if (WIFSIGNALED(signature)) {
+		return WIFSIGNALED(status) && WTERMSIG(status) == WTERMSIG(signature);
+	}
+
+	return WIFEXITED(status) && WEXITSTATUS(status) == WEXITSTATUS(signature);
+}
+
+/*
+ * Take the kth of g parts of set[0..n), or everything else, into out[].
+ */
+static size_t
+part(const size_t *set, size_t n, size_t g, size_t k, int complement,
+	size_t *out)
+{
+	size_t lo, hi, i, m;
+
+	lo = k * n / g;
+	hi = (k + 1) * n / g;
+
+	m = 0;
+	for (i = 0; i < n; i++) {
+		if ((i >= lo && i < hi) != complement) {
+			out[m++] = set[i];
+		}
+	}
+
+	return m;
+}
+
+/*
+ * Run each of the g parts of set[] (or each complement), up to jobs at once.
+ * Returns the first part with which the command fails as it did, or g if
+ * none does. Runs which can no longer matter are killed.
+ */
+static size_t
+step(const size_t *set, size_t n, size_t g, int complement, size_t *out)
+{
+	enum { PENDING, RUNNING, PASSED, FAILED } *state;
+	char path[sizeof dir + 32];
+	pid_t *pid, p;
+	size_t launched, running, i, k, m;
+	int status;
+
+	state = calloc(g, sizeof *state);
+	pid   = calloc(g, sizeof *pid);
+	if (!state || !pid) {
+		die("out of memory");
+	}
+
+	launched = 0;
+	running  = 0;
+
+	for (;;) {
+		/* The first part to fail, once all before it have passed */
+		for (k = 0; k < g; k++) {
+			if (state[k] != PASSED) {
+				break;
+			}
+		}
+
+		if (k == g || state[k] == FAILED) {
+			break;
+		}
+
+		while (running < jobs && launched < g) {
+			m = part(set, n, g, launched, complement, out);
+			sprintf(path, "%s/%lu", dir, (unsigned long) launched);
+			encode(path, out, m);
+
+			pid[launched]   = run("GREAT_REPLAY", path);
+			state[launched] = RUNNING;
+			launched++;
+			running++;
+		}
+
+		p = wait(&status);
+		if (-1 == p) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			perror("wait");
+			exit(EXIT_FAILURE);
+		}
+
+		for (i = 0; i < launched; i++) {
+			if (pid[i] == p && state[i] == RUNNING) {
+				state[i] = same(status) ? FAILED : PASSED;
+				running--;
+				sprintf(path, "%s/%lu", dir, (unsigned long) i);
+				(void) unlink(path);
+			}
+		}
+	}
+
+	for (i = 0; i < launched; i++) {
+		if (state[i] == RUNNING) {
+			(void) kill(pid[i], SIGKILL);
+			(void) reap(pid[i]);
+			sprintf(path, "%s/%lu", dir, (unsigned long) i);
+			(void) unlink(path);
+		}
+	}
+
+	free(state);
+	free(pid);
+
+	return k;
+}
+
+/*
+ * Narrow set[0..n) to a 1-minimal set with which the command still fails.
+ * Returns the size of the set, which is left in set[].
+ */
+static size_t
+ddmin(size_t *set, size_t n)
+{
+	size_t *out;
+	size_t g, k;
+
+	out = malloc((n ? n : 1) * sizeof *out);
+	if (!out) {
+		die("out of memory");
+	}
+
+	g = 2;
+
+	while (n >= 2) {
+		fprintf(stderr, "%s: %lu interceptions, %lu runs so far\n", name,
+			(unsigned long) n, runs);
+
+		k = step(set, n, g, 0, out);
+		if (k < g) {
+			n = part(set, n, g, k, 0, out);
+			memcpy(set, out, n * sizeof *set);
+			g = 2;
+			continue;
+		}
+
+		/* For two parts, each complement is the other part */
+		if (g > 2) {
+			k = step(set, n, g, 1, out);
+			if (k < g) {
+				n = part(set, n, g, k, 1, out);
+				memcpy(set, out, n * sizeof *set);
+				g = g - 1 > 2 ? g - 1 : 2;
+				continue;
+			}
+		}
+
+		if (g >= n) {
+			break;
+		}
+
+		g = 2 * g < n ? 2 * g : n;
+	}
+
+	free(out);
+
+	return n;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "usage: %s [-j jobs] [-t seconds] [-o recording] [-p library] "
+		"[--] command [argument ...]\n", name);
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[])
+{
+	const char *output;
+	char path[sizeof dir + 32];
+	unsigned char *buf;
+	size_t *set;
+	size_t len, n, i;
+	long l;
+	int c;
+
+	name   = argv[0];
+	output = "great-minimise.rec";
+
+	l = sysconf(_SC_NPROCESSORS_ONLN);
+	jobs    = l > 0 ? (unsigned long) l : 1;
+	timeout = 0;
+
+	while (-1 != (c = getopt(argc, argv, "j:t:o:p:"))) {
+		switch (c) {
+		case 'j':
+			jobs = strtoul(optarg, NULL, 10);
+			if (jobs == 0) {
+				usage();
+			}
+			break;
+
+		case 't':
+			timeout = (unsigned int) strtoul(optarg, NULL, 10);
+			break;
+
+		case 'o':
+			output = optarg;
+			break;
+
+		case 'p':
+			preload = optarg;
+			break;
+
+		default:
+			usage();
+		}
+	}
+
+	if (optind >= argc) {
+		usage();
+	}
+
+	command = argv + optind;
+
+	if (!mkdtemp(dir)) {
+		perror(dir);
+		return EXIT_FAILURE;
+	}
+
+	sprintf(path, "%s/recording", dir);
+
+	signature = reap(run("GREAT_RECORD", path));
+	if (!failed(signature)) {
+		(void) unlink(path);
+		(void) rmdir(dir);
+		die("the command did not fail");
+	}
+
+	buf = slurp(path, &len);
+	decode(buf, len);
+	free(buf);
+	(void) unlink(path);
+
+	set = malloc((ninj ? ninj : 1) * sizeof *set);
+	if (!set) {
+		die("out of memory");
+	}
+
+	for (i = 0; i < ninj; i++) {
+		set[i] = i;
+	}
+
+	/* Replay may fail otherwise than the recording did; take the replay's */
+	encode(path, set, ninj);
+	signature = reap(run("GREAT_REPLAY", path));
+	(void) unlink(path);
+	if (!failed(signature)) {
+		(void) rmdir(dir);
+		die("the failure does not replay");
+	}
+
+	encode(path, set, 0);
+	c = reap(run("GREAT_REPLAY", path));
+	(void) unlink(path);
+	if (same(c)) {
+		(void) rmdir(dir);
+		die("the command fails without any interception");
+	}
+
+	n = ddmin(set, ninj);
+
+	(void) rmdir(dir);
+
+	encode(output, set, n);
+
+	for (i = 0; i < n; i++) {
+		const struct injection *j = &inj[set[i]];
+
+		printf("%s: thread %lu, decision %llu\n",
+			j->id < functions ? function[j->id] : "?",
+			j->thread, (unsigned long long) j->decision);
+	}
+
+	fprintf(stderr, "%s: %lu of %lu interceptions in %lu runs; written to %s\n",
+		name, (unsigned long) n, (unsigned long) ninj, runs, output);
+
+	return EXIT_SUCCESS;
+}
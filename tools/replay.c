@@ -0,0 +1,565 @@
+/*
+ * Copyright 2008 Katherine Flavel. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ *  * Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ *  * Neither the name of the author nor the names of its contributors may be
+ *    used to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Allocation trace replay.
+ *
+ * Events are read from a trace written under $GREAT_ALLOC_TRACE, ordered by
+ * time, and replayed from a single thread against whichever malloc() this
+ * program is linked with (or has preloaded). Replay is timed, and the peak
+ * resident set size is reported.
+ *
+ * Before replay, traced addresses are translated to dense object numbers, so
+ * that the timed loop does no more than index an array. One byte per page of
+ * each block is written, so that the resident set reflects what the traced
+ * program would have touched at least.
+ *
+ * $Id$
+ */
+
+/* Required for clock_gettime() and getrusage() */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../src/shared/trace.h"
+
+#define PAGE 4096
+
+struct event {
+	uint64_t time;
+	size_t seq;	/* for a stable sort */
+	uintptr_t ptr;
+	uintptr_t old;
+	size_t size;
+
+	/* assigned by number() */
+	size_t obj;
+	size_t oldobj;
+
+	unsigned char op;	/* enum great_trace_op */
+	unsigned char skip;
+};
+
+/* Open-addressing map of traced addresses to object numbers */
+struct map {
+	size_t mask;
+	size_t count;
+	uintptr_t *key;	/* 0 for unused */
+	size_t *value;
+};
+
+static const char *name;
+
+static void
+die(const char *msg)
+{
+	fprintf(stderr, "%s: %s\n", name, msg);
+	exit(EXIT_FAILURE);
+}
+
+static int
+varint(const unsigned char **p, const unsigned char *end, uint64_t *u)
+{
+	unsigned int shift;
+
+	*u = 0;
+
+	for (shift = 0; *p < end && shift < 64; shift += 7) {
+		unsigned char c = *(*p)++;
+
+		*u |= (uint64_t) (c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+zigzag(const unsigned char **p, const unsigned char *end, uintptr_t base,
+	uintptr_t *ptr)
+{
+	uint64_t u;
+	int64_t d;
+
+	if (!varint(p, end, &u)) {
+		return 0;
+	}
+
+	d = (int64_t) (u >> 1) ^ -(int64_t) (u & 1);
+	*ptr = base + (uintptr_t) d;
+
+	return 1;
+}
+
+static unsigned char *
+slurp(const char *path, size_t *len)
+{
+	FILE *f;
+	unsigned char *buf;
+	size_t n, size;
+
+	f = fopen(path, "rb");
+	if (!f) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	buf  = NULL;
+	size = 0;
+	n    = 0;
+
+	for (;;) {
+		size_t r;
+
+		if (n == size) {
+			size = size ? size * 2 : 1 << 20;
+			buf = realloc(buf, size);
+			if (!buf) {
+				die("out of memory");
+			}
+		}
+
+		r = fread(buf + n, 1, size - n, f);
+		if (0 == r) {
+			break;
+		}
+
+		n += r;
+	}
+
+	if (ferror(f)) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	fclose(f);
+
+	*len = n;
+	return buf;
+}
+
+static struct event *
+decode(const unsigned char *p, const unsigned char *end, size_t *count)
+{
+	struct event *ev;
+	size_t n, size;
+
+	if ((size_t) (end - p) < strlen(GREAT_TRACE_MAGIC)
+	|| 0 != memcmp(p, GREAT_TRACE_MAGIC, strlen(GREAT_TRACE_MAGIC))) {
+		die("not a trace");
+	}
+
+	p += strlen(GREAT_TRACE_MAGIC);
+
+	ev   = NULL;
+	n    = 0;
+	size = 0;
+
+	while (p < end) {
+		const unsigned char *chunk;
+		uint64_t thread, len, time;
+		uintptr_t prev;
+
+		if (!varint(&p, end, &thread) || !varint(&p, end, &len)
+		|| len > (uint64_t) (end - p)) {
+			fprintf(stderr, "%s: truncated chunk; disregarding the rest\n", name);
+			break;
+		}
+
+		chunk = p + len;
+		time  = 0;
+		prev  = 0;
+
+		while (p < chunk) {
+			struct event *e;
+			uint64_t u;
+
+			if (n == size) {
+				size = size ? size * 2 : 1 << 16;
+				ev = realloc(ev, size * sizeof *ev);
+				if (!ev) {
+					die("out of memory");
+				}
+			}
+
+			e = &ev[n];
+			memset(e, 0, sizeof *e);
+
+			e->op = *p++;
+
+			if (!varint(&p, chunk, &u) || !zigzag(&p, chunk, prev, &e->ptr)) {
+				die("malformed event");
+			}
+
+			time += u;
+			e->time = time;
+			e->seq  = n;
+
+			switch (e->op) {
+			case GREAT_TRACE_REALLOC:
+				if (!zigzag(&p, chunk, prev, &e->old)) {
+					die("malformed event");
+				}
+				/* FALLTHROUGH */
+
+			case GREAT_TRACE_MALLOC:
+				if (!varint(&p, chunk, &u)) {
+					die("malformed event");
+				}
+				e->size = (size_t) u;
+				break;
+
+			case GREAT_TRACE_FREE:
+				break;
+
+			default:
+				die("unrecognised event");
+			}
+
+			prev = e->ptr;
+			n++;
+		}
+
+		p = chunk;
+	}
+
+	*count = n;
+	return ev;
+}
+
+static int
+bytime(const void *a, const void *b)
+{
+	const struct event *x = a, *y = b;
+
+	if (x->time != y->time) {
+		return x->time < y->time ? -1 : 1;
+	}
+
+	return x->seq < y->seq ? -1 : x->seq > y->seq;
+}
+
+static size_t
+slot(const struct map *m, uintptr_t key)
+{
+	uint64_t h;
+	size_t i;
+
+	h = (uint64_t) key * (uint64_t) 0x9e3779b97f4a7c15ULL;
+
+	for (i = (size_t) (h >> 20) & m->mask; m->key[i] && m->key[i] != key;
+		i = (i + 1) & m->mask)
+		;
+
+	return i;
+}
+
+static void
+grow(struct map *m)
+{
+	struct map new;
+	size_t i;
+
+	new.mask  = m->mask ? m->mask * 2 + 1 : 65535;
+	new.count = m->count;
+	new.key   = calloc(new.mask + 1, sizeof *new.key);
+	new.value = calloc(new.mask + 1, sizeof *new.value);
+	if (!new.key || !new.value) {
+		die("out of memory");
+	}
+
+	for (i = 0; m->key && i <= m->mask; i++) {
+		size_t j;
+
+		if (!m->key[i]) {
+			continue;
+		}
+
+		j = slot(&new, m->key[i]);
+		new.key[j]   = m->key[i];
+		new.value[j] = m->value[i];
+	}
+
+	free(m->key);
+	free(m->value);
+	*m = new;
+}
+
+static void
+put(struct map *m, uintptr_t key, size_t value)
+{
+	size_t i;
+
+	if ((m->count + 1) * 2 > m->mask + 1) {
+		grow(m);
+	}
+
+	i = slot(m, key);
+	if (!m->key[i]) {
+		m->count++;
+	}
+
+	m->key[i]   = key;
+	m->value[i] = value;
+}
+
+static int
+take(struct map *m, uintptr_t key, size_t *value)
+{
+	size_t i, j;
+
+	if (!m->key) {
+		return 0;
+	}
+
+	i = slot(m, key);
+	if (!m->key[i]) {
+		return 0;
+	}
+
+	*value = m->value[i];
+	m->key[i] = 0;
+	m->count--;
+
+	/* reinsert the rest of the cluster */
+	for (j = (i + 1) & m->mask; m->key[j]; j = (j + 1) & m->mask) {
+		uintptr_t k = m->key[j];
+		size_t v = m->value[j];
+
+		m->key[j] = 0;
+		i = slot(m, k);
+		m->key[i]   = k;
+		m->value[i] = v;
+	}
+
+	return 1;
+}
+
+/*
+ * Translate traced addresses to object numbers, in time order. Events which
+ * failed when traced, or which refer to objects not seen allocated, are
+ * skipped. Returns the number of objects.
+ */
+static size_t
+number(struct event *ev, size_t n)
+{
+	struct map m;
+	size_t i, objs;
+
+	memset(&m, 0, sizeof m);
+	objs = 0;
+
+	for (i = 0; i < n; i++) {
+		struct event *e = &ev[i];
+
+		switch (e->op) {
+		case GREAT_TRACE_MALLOC:
+			if (!e->ptr) {
+				e->skip = 1;
+				break;
+			}
+
+			e->obj = objs++;
+			put(&m, e->ptr, e->obj);
+			break;
+
+		case GREAT_TRACE_FREE:
+			if (!take(&m, e->ptr, &e->obj)) {
+				e->skip = 1;
+			}
+			break;
+
+		case GREAT_TRACE_REALLOC:
+			/* a failed realloc() leaves the old object as it was */
+			if (!e->ptr && e->size > 0) {
+				e->skip = 1;
+				break;
+			}
+
+			if (e->old && !take(&m, e->old, &e->oldobj)) {
+				e->skip = 1;
+				break;
+			}
+
+			/* realloc(NULL, n) is malloc(n); oldobj is unused */
+			if (!e->old) {
+				e->op = GREAT_TRACE_MALLOC;
+			}
+
+			/* realloc(p, 0) which returned NULL freed p */
+			if (!e->ptr) {
+				e->op  = GREAT_TRACE_FREE;
+				e->obj = e->oldobj;
+				break;
+			}
+
+			e->obj = objs++;
+			put(&m, e->ptr, e->obj);
+			break;
+
+		default:
+			e->skip = 1;
+			break;
+		}
+	}
+
+	free(m.key);
+	free(m.value);
+
+	return objs;
+}
+
+static void
+touch(char *p, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i += PAGE) {
+		p[i] = 1;
+	}
+}
+
+static double
+seconds(void)
+{
+	struct timespec ts;
+
+	if (-1 == clock_gettime(CLOCK_MONOTONIC, &ts)) {
+		perror("clock_gettime");
+		exit(EXIT_FAILURE);
+	}
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned char *buf;
+	struct event *ev;
+	struct rusage before, after;
+	char **obj;
+	size_t len, n, objs, i, replayed;
+	double t0, t1;
+
+	name = argv[0];
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s <trace>\n", name);
+		return EXIT_FAILURE;
+	}
+
+	buf = slurp(argv[1], &len);
+	ev  = decode(buf, buf + len, &n);
+	free(buf);
+
+	qsort(ev, n, sizeof *ev, bytime);
+	objs = number(ev, n);
+
+	obj = calloc(objs ? objs : 1, sizeof *obj);
+	if (!obj) {
+		die("out of memory");
+	}
+
+	/* the trace itself takes space, which is reported apart */
+	if (-1 == getrusage(RUSAGE_SELF, &before)) {
+		perror("getrusage");
+		return EXIT_FAILURE;
+	}
+
+	replayed = 0;
+	t0 = seconds();
+
+	for (i = 0; i < n; i++) {
+		const struct event *e = &ev[i];
+
+		if (e->skip) {
+			continue;
+		}
+
+		switch (e->op) {
+		case GREAT_TRACE_MALLOC:
+			obj[e->obj] = malloc(e->size);
+			if (obj[e->obj]) {
+				touch(obj[e->obj], e->size);
+			}
+			break;
+
+		case GREAT_TRACE_FREE:
+			free(obj[e->obj]);
+			obj[e->obj] = NULL;
+			break;
+
+		case GREAT_TRACE_REALLOC:
+			obj[e->obj] = realloc(obj[e->oldobj], e->size);
+			obj[e->oldobj] = NULL;
+			if (obj[e->obj]) {
+				touch(obj[e->obj], e->size);
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		replayed++;
+	}
+
+	t1 = seconds();
+
+	if (-1 == getrusage(RUSAGE_SELF, &after)) {
+		perror("getrusage");
+		return EXIT_FAILURE;
+	}
+
+	printf("events: %lu read, %lu replayed, %lu objects\n",
+		(unsigned long) n, (unsigned long) replayed, (unsigned long) objs);
+	printf("time: %.6f s\n", t1 - t0);
+
+	if (t1 > t0 && replayed > 0) {
+		printf("throughput: %.0f ops/s, %.1f ns/op\n",
+			replayed / (t1 - t0), (t1 - t0) * 1e9 / replayed);
+	}
+
+	printf("peak RSS: %ld KiB, of which %ld KiB before replay\n",
+		after.ru_maxrss, before.ru_maxrss);
+
+	return EXIT_SUCCESS;
+}
+